@@ -6,11 +6,16 @@
 #include "ethsnarks.hpp"
 #include "../Utils/Data.h"
 
+#include <functional>
+
 using namespace ethsnarks;
 
 namespace Loopring
 {
 
+// Signs the message of a block with the key of the operator
+typedef std::function<Signature(const FieldT &message)> BlockSigner;
+
 class Circuit : public GadgetT
 {
   public:
@@ -21,14 +26,35 @@ class Circuit : public GadgetT
     virtual ~Circuit(){};
     virtual void generateConstraints(unsigned int blockSize) = 0;
     virtual bool generateWitness(const json &input) = 0;
+    // Generates the witness of a block that is already in memory (e.g. built
+    // with buildBlock)
+    virtual bool generateWitness(const Block &block) = 0;
+    // Generates the witness of a block that is mostly the same as the previous
+    // block, only the parts that changed are regenerated
+    virtual bool generateWitnessIncremental(const json &input)
+    {
+        return generateWitness(input);
+    }
     virtual unsigned int getBlockType() = 0;
     virtual unsigned int getBlockSize() = 0;
+    virtual unsigned int getNumSignatureVerifiers() = 0;
     virtual void printInfo() = 0;
 
     libsnark::protoboard<FieldT> &getPb()
     {
         return pb;
     }
+
+    // Blocks that are not signed by the operator yet (e.g. generated blocks)
+    // are signed by the signer once the message of the block is known. The
+    // signature of the block is used when no signer is set.
+    void setBlockSigner(const BlockSigner &_blockSigner)
+    {
+        blockSigner = _blockSigner;
+    }
+
+  protected:
+    BlockSigner blockSigner;
 };
 
 } // namespace Loopring
@@ -7,6 +7,10 @@
 #include "../Utils/Constants.h"
 #include "../Utils/Data.h"
 #include "../Utils/Utils.h"
+#include "../Utils/BlockValidator.h"
+#include "../Utils/MerkleChecker.h"
+#include "../Utils/SignatureChecker.h"
+#include "../Utils/Trace.h"
 #include "../Gadgets/MatchingGadgets.h"
 #include "../Gadgets/AccountGadgets.h"
 #include "../Gadgets/StorageGadgets.h"
@@ -173,9 +177,10 @@ class TransactionGadget : public GadgetT
     RequireNotZeroGadget validateAccountA;
     RequireNotZeroGadget validateAccountB;
 
-    // Check signatures
-    SignatureVerifier signatureVerifierA;
-    SignatureVerifier signatureVerifierB;
+    // Check signatures (not used when the signatures are verified by verifiers
+    // shared by all transactions)
+    std::unique_ptr<SignatureVerifier> signatureVerifierA;
+    std::unique_ptr<SignatureVerifier> signatureVerifierB;
 
     // Update UserA
     UpdateStorageGadget updateStorage_A;
@@ -210,6 +215,7 @@ class TransactionGadget : public GadgetT
       const VariableArrayT &operatorAccountID,
       const VariableT &protocolBalancesRoot,
       const VariableT &numConditionalTransactionsBefore,
+      bool sharedSignatures,
       const std::string &prefix)
         : GadgetT(pb, prefix),
 
@@ -265,21 +271,25 @@ class TransactionGadget : public GadgetT
 
           // Check signatures
           signatureVerifierA(
-            pb,
-            params,
-            state.constants,
-            jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_A), tx.getOutput(TXV_PUBKEY_Y_A)),
-            tx.getOutput(TXV_HASH_A),
-            tx.getOutput(TXV_SIGNATURE_REQUIRED_A),
-            FMT(prefix, ".signatureVerifierA")),
+            sharedSignatures ? nullptr
+                             : new SignatureVerifier(
+                                 pb,
+                                 params,
+                                 state.constants,
+                                 jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_A), tx.getOutput(TXV_PUBKEY_Y_A)),
+                                 tx.getOutput(TXV_HASH_A),
+                                 tx.getOutput(TXV_SIGNATURE_REQUIRED_A),
+                                 FMT(prefix, ".signatureVerifierA"))),
           signatureVerifierB(
-            pb,
-            params,
-            state.constants,
-            jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_B), tx.getOutput(TXV_PUBKEY_Y_B)),
-            tx.getOutput(TXV_HASH_B),
-            tx.getOutput(TXV_SIGNATURE_REQUIRED_B),
-            FMT(prefix, ".signatureVerifierB")),
+            sharedSignatures ? nullptr
+                             : new SignatureVerifier(
+                                 pb,
+                                 params,
+                                 state.constants,
+                                 jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_B), tx.getOutput(TXV_PUBKEY_Y_B)),
+                                 tx.getOutput(TXV_HASH_B),
+                                 tx.getOutput(TXV_SIGNATURE_REQUIRED_B),
+                                 FMT(prefix, ".signatureVerifierB"))),
 
           // Update UserA
           updateStorage_A(
@@ -418,6 +428,14 @@ class TransactionGadget : public GadgetT
     }
 
     void generate_r1cs_witness(const UniversalTransaction &uTx)
+    {
+        generate_r1cs_witness_transaction(uTx);
+        generate_r1cs_witness_updates(uTx);
+    }
+
+    // Processes the transaction itself, afterwards the data that needs to be
+    // signed is known
+    void generate_r1cs_witness_transaction(const UniversalTransaction &uTx)
     {
         type.generate_r1cs_witness(pb, uTx.type);
         selector.generate_r1cs_witness();
@@ -454,31 +472,41 @@ class TransactionGadget : public GadgetT
         accountB.generate_r1cs_witness();
         validateAccountA.generate_r1cs_witness();
         validateAccountB.generate_r1cs_witness();
+    }
 
+    // Verifies the signatures and updates the Merkle trees
+    void generate_r1cs_witness_updates(
+      const UniversalTransaction &uTx,
+      MerkleHashMemo *memo = nullptr,
+      FixedBaseMulMemo *signatureMemo = nullptr)
+    {
         // Check signatures
-        signatureVerifierA.generate_r1cs_witness(uTx.witness.signatureA);
-        signatureVerifierB.generate_r1cs_witness(uTx.witness.signatureB);
+        if (signatureVerifierA)
+        {
+            signatureVerifierA->generate_r1cs_witness(uTx.witness.signatureA, signatureMemo);
+            signatureVerifierB->generate_r1cs_witness(uTx.witness.signatureB, signatureMemo);
+        }
 
         // Update UserA
-        updateStorage_A.generate_r1cs_witness(uTx.witness.storageUpdate_A);
-        updateBalanceS_A.generate_r1cs_witness(uTx.witness.balanceUpdateS_A);
-        updateBalanceB_A.generate_r1cs_witness(uTx.witness.balanceUpdateB_A);
-        updateAccount_A.generate_r1cs_witness(uTx.witness.accountUpdate_A);
+        updateStorage_A.generate_r1cs_witness(uTx.witness.storageUpdate_A, memo);
+        updateBalanceS_A.generate_r1cs_witness(uTx.witness.balanceUpdateS_A, memo);
+        updateBalanceB_A.generate_r1cs_witness(uTx.witness.balanceUpdateB_A, memo);
+        updateAccount_A.generate_r1cs_witness(uTx.witness.accountUpdate_A, memo);
 
         // Update UserB
-        updateStorage_B.generate_r1cs_witness(uTx.witness.storageUpdate_B);
-        updateBalanceS_B.generate_r1cs_witness(uTx.witness.balanceUpdateS_B);
-        updateBalanceB_B.generate_r1cs_witness(uTx.witness.balanceUpdateB_B);
-        updateAccount_B.generate_r1cs_witness(uTx.witness.accountUpdate_B);
+        updateStorage_B.generate_r1cs_witness(uTx.witness.storageUpdate_B, memo);
+        updateBalanceS_B.generate_r1cs_witness(uTx.witness.balanceUpdateS_B, memo);
+        updateBalanceB_B.generate_r1cs_witness(uTx.witness.balanceUpdateB_B, memo);
+        updateAccount_B.generate_r1cs_witness(uTx.witness.accountUpdate_B, memo);
 
         // Update Operator
-        updateBalanceB_O.generate_r1cs_witness(uTx.witness.balanceUpdateB_O);
-        updateBalanceA_O.generate_r1cs_witness(uTx.witness.balanceUpdateA_O);
-        updateAccount_O.generate_r1cs_witness(uTx.witness.accountUpdate_O);
+        updateBalanceB_O.generate_r1cs_witness(uTx.witness.balanceUpdateB_O, memo);
+        updateBalanceA_O.generate_r1cs_witness(uTx.witness.balanceUpdateA_O, memo);
+        updateAccount_O.generate_r1cs_witness(uTx.witness.accountUpdate_O, memo);
 
         // Update Protocol pool
-        updateBalanceB_P.generate_r1cs_witness(uTx.witness.balanceUpdateB_P);
-        updateBalanceA_P.generate_r1cs_witness(uTx.witness.balanceUpdateA_P);
+        updateBalanceB_P.generate_r1cs_witness(uTx.witness.balanceUpdateB_P, memo);
+        updateBalanceA_P.generate_r1cs_witness(uTx.witness.balanceUpdateA_P, memo);
     }
 
     void generate_r1cs_constraints()
@@ -505,8 +533,11 @@ class TransactionGadget : public GadgetT
         validateAccountB.generate_r1cs_constraints();
 
         // Check signatures
-        signatureVerifierA.generate_r1cs_constraints();
-        signatureVerifierB.generate_r1cs_constraints();
+        if (signatureVerifierA)
+        {
+            signatureVerifierA->generate_r1cs_constraints();
+            signatureVerifierB->generate_r1cs_constraints();
+        }
 
         // Update UserA
         updateStorage_A.generate_r1cs_constraints();
@@ -535,6 +566,40 @@ class TransactionGadget : public GadgetT
         return flatten({reverse(type.bits), tx.getPublicData()});
     }
 
+    SignatureCheck getSignatureA(const UniversalTransaction &uTx) const
+    {
+        return {
+          jubjub::EdwardsPoint(pb.val(tx.getOutput(TXV_PUBKEY_X_A)), pb.val(tx.getOutput(TXV_PUBKEY_Y_A))),
+          pb.val(tx.getOutput(TXV_HASH_A)),
+          uTx.witness.signatureA,
+          pb.val(tx.getOutput(TXV_SIGNATURE_REQUIRED_A)) == FieldT::one()};
+    }
+
+    SignatureCheck getSignatureB(const UniversalTransaction &uTx) const
+    {
+        return {
+          jubjub::EdwardsPoint(pb.val(tx.getOutput(TXV_PUBKEY_X_B)), pb.val(tx.getOutput(TXV_PUBKEY_Y_B))),
+          pb.val(tx.getOutput(TXV_HASH_B)),
+          uTx.witness.signatureB,
+          pb.val(tx.getOutput(TXV_SIGNATURE_REQUIRED_B)) == FieldT::one()};
+    }
+
+    SignatureRequest getSignatureRequestA() const
+    {
+        return {
+          jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_A), tx.getOutput(TXV_PUBKEY_Y_A)),
+          tx.getOutput(TXV_HASH_A),
+          tx.getOutput(TXV_SIGNATURE_REQUIRED_A)};
+    }
+
+    SignatureRequest getSignatureRequestB() const
+    {
+        return {
+          jubjub::VariablePointT(tx.getOutput(TXV_PUBKEY_X_B), tx.getOutput(TXV_PUBKEY_Y_B)),
+          tx.getOutput(TXV_HASH_B),
+          tx.getOutput(TXV_SIGNATURE_REQUIRED_B)};
+    }
+
     const VariableT &getNewAccountsRoot() const
     {
         return updateAccount_O.result();
@@ -546,6 +611,101 @@ class TransactionGadget : public GadgetT
     }
 };
 
+template <typename T> static bool isSameRoots(const T &x, const T &y)
+{
+    return x.rootBefore == y.rootBefore && x.rootAfter == y.rootAfter && x.proof.data.size() == y.proof.data.size();
+}
+
+static bool isSameUpdate(const StorageUpdate &x, const StorageUpdate &y)
+{
+    return isSameRoots(x, y) && x.storageID == y.storageID;
+}
+
+static bool isSameUpdate(const BalanceUpdate &x, const BalanceUpdate &y)
+{
+    return isSameRoots(x, y) && x.tokenID == y.tokenID;
+}
+
+static bool isSameUpdate(const AccountUpdate &x, const AccountUpdate &y)
+{
+    return isSameRoots(x, y) && x.accountID == y.accountID;
+}
+
+static bool isSameSignature(const Signature &x, const Signature &y)
+{
+    return x.R.x == y.R.x && x.R.y == y.R.y && x.s == y.s;
+}
+
+// Noop transactions with the same incoming state have exactly the same witness.
+// Only the roots (and ids) are compared, the leaves and proofs are implied by
+// them because all Merkle proofs are checked before the witness is generated.
+static bool isSameNoop(const UniversalTransaction &a, const UniversalTransaction &b)
+{
+    const FieldT noop = FieldT(int(TransactionType::Noop));
+    if (a.type != noop || b.type != noop)
+    {
+        return false;
+    }
+    const Witness &wa = a.witness;
+    const Witness &wb = b.witness;
+    return isSameUpdate(wa.storageUpdate_A, wb.storageUpdate_A) &&
+           isSameUpdate(wa.balanceUpdateS_A, wb.balanceUpdateS_A) &&
+           isSameUpdate(wa.balanceUpdateB_A, wb.balanceUpdateB_A) &&
+           isSameUpdate(wa.accountUpdate_A, wb.accountUpdate_A) &&
+           isSameUpdate(wa.storageUpdate_B, wb.storageUpdate_B) &&
+           isSameUpdate(wa.balanceUpdateS_B, wb.balanceUpdateS_B) &&
+           isSameUpdate(wa.balanceUpdateB_B, wb.balanceUpdateB_B) &&
+           isSameUpdate(wa.accountUpdate_B, wb.accountUpdate_B) &&
+           isSameUpdate(wa.balanceUpdateB_O, wb.balanceUpdateB_O) &&
+           isSameUpdate(wa.balanceUpdateA_O, wb.balanceUpdateA_O) &&
+           isSameUpdate(wa.accountUpdate_O, wb.accountUpdate_O) &&
+           isSameUpdate(wa.balanceUpdateB_P, wb.balanceUpdateB_P) &&
+           isSameUpdate(wa.balanceUpdateA_P, wb.balanceUpdateA_P) &&
+           isSameSignature(wa.signatureA, wb.signatureA) && isSameSignature(wa.signatureB, wb.signatureB) &&
+           wa.numConditionalTransactionsAfter == wb.numConditionalTransactionsAfter;
+}
+
+// Checks if transaction i starts from the same state in both blocks
+static bool isSameIncomingState(const Block &a, const Block &b, unsigned int i)
+{
+    if (i == 0)
+    {
+        return a.merkleRootBefore == b.merkleRootBefore &&
+               a.accountUpdate_P.before.balancesRoot == b.accountUpdate_P.before.balancesRoot;
+    }
+    const Witness &wa = a.transactions[i - 1].witness;
+    const Witness &wb = b.transactions[i - 1].witness;
+    return wa.accountUpdate_O.rootAfter == wb.accountUpdate_O.rootAfter &&
+           wa.balanceUpdateA_P.rootAfter == wb.balanceUpdateA_P.rootAfter &&
+           wa.numConditionalTransactionsAfter == wb.numConditionalTransactionsAfter;
+}
+
+// Returns for each transaction of the new block if its witness needs to be
+// generated when the witness of the previous block is still on the protoboard.
+// A transaction can be reused when its input is the same, it starts from the
+// same state and the block data shared by all transactions is the same.
+static std::vector<bool> getChangedTransactions(
+  const Block &previousBlock,
+  const json &previousTransactions,
+  const Block &block,
+  const json &transactions)
+{
+    std::vector<bool> changed(block.transactions.size(), true);
+    if (previousBlock.transactions.size() != block.transactions.size() ||
+        previousBlock.exchange != block.exchange || previousBlock.timestamp != block.timestamp ||
+        previousBlock.protocolTakerFeeBips != block.protocolTakerFeeBips ||
+        previousBlock.protocolMakerFeeBips != block.protocolMakerFeeBips ||
+        previousBlock.operatorAccountID != block.operatorAccountID)
+    {
+        return changed;
+    }
+    for (unsigned int i = 0; i < block.transactions.size(); i++)
+    {
+        changed[i] = transactions[i] != previousTransactions[i] || !isSameIncomingState(previousBlock, block, i);
+    }
+    return changed;
+}
+
 class UniversalCircuit : public Circuit
 {
   public:
@@ -577,6 +737,22 @@ class UniversalCircuit : public Circuit
     // Transactions
     unsigned int numTransactions;
     std::vector<TransactionGadget> transactions;
+    // The number of signature verifiers shared by all transactions, or 0 if
+    // each transaction has its own two signature verifiers
+    const unsigned int numSignatureVerifiers;
+    std::unique_ptr<SharedSignatureVerifiers> sharedSignatureVerifiers;
+    // The range of variable indices [first, last) allocated by each transaction
+    std::vector<std::pair<size_t, size_t>> transactionVariables;
+    // Merkle tree nodes already hashed in the current block
+    MerkleHashMemo merkleHashMemo;
+    // B*s already calculated in the current block
+    FixedBaseMulMemo fixedBaseMulMemo;
+
+    // The last block for which the witness was generated incrementally, the
+    // witness of its transactions is still on the protoboard. Only kept for
+    // generateWitnessIncremental.
+    std::unique_ptr<Block> lastBlock;
+    json lastTransactions;
 
     // Update Protocol pool
     std::unique_ptr<UpdateAccountGadget> updateAccount_P;
@@ -586,7 +762,8 @@ class UniversalCircuit : public Circuit
 
     UniversalCircuit( //
       ProtoboardT &pb,
-      const std::string &prefix)
+      const std::string &prefix,
+      unsigned int _numSignatureVerifiers = 0)
         : Circuit(pb, prefix),
 
           publicData(pb, FMT(prefix, ".publicData")),
@@ -617,7 +794,9 @@ class UniversalCircuit : public Circuit
             accountBefore_O.publicKey,
             hash.result(),
             constants._1,
-            FMT(prefix, ".signatureVerifier"))
+            FMT(prefix, ".signatureVerifier")),
+
+          numSignatureVerifiers(_numSignatureVerifiers)
     {
     }
 
@@ -643,7 +822,9 @@ class UniversalCircuit : public Circuit
         transactions.reserve(numTransactions);
         for (size_t j = 0; j < numTransactions; j++)
         {
-            std::cout << "------------------- tx: " << j << std::endl;
+            TRACE_SCOPE_INDEX("createTransaction", j);
+            LOG_DEBUG("------------------- tx: " << j);
+            const size_t firstVariable = pb.num_variables() + 1;
             const VariableT txAccountsRoot =
               (j == 0) ? merkleRootBefore.packed : transactions.back().getNewAccountsRoot();
             const VariableT &txProtocolBalancesRoot =
@@ -660,8 +841,29 @@ class UniversalCircuit : public Circuit
               operatorAccountID.bits,
               txProtocolBalancesRoot,
               (j == 0) ? constants._0 : transactions.back().tx.getOutput(TXV_NUM_CONDITIONAL_TXS),
+              numSignatureVerifiers > 0,
               std::string("tx_") + std::to_string(j));
             transactions.back().generate_r1cs_constraints();
+            transactionVariables.emplace_back(firstVariable, pb.num_variables() + 1);
+        }
+
+        // Shared signature verifiers
+        if (numSignatureVerifiers > 0)
+        {
+            std::vector<SignatureRequest> signatureRequests;
+            for (const TransactionGadget &transaction : transactions)
+            {
+                signatureRequests.push_back(transaction.getSignatureRequestA());
+                signatureRequests.push_back(transaction.getSignatureRequestB());
+            }
+            sharedSignatureVerifiers.reset(new SharedSignatureVerifiers(
+              pb,
+              params,
+              constants,
+              signatureRequests,
+              numSignatureVerifiers,
+              FMT(annotation_prefix, ".sharedSignatureVerifiers")));
+            sharedSignatureVerifiers->generate_r1cs_constraints();
         }
 
         // Update Protocol pool
@@ -734,14 +936,52 @@ class UniversalCircuit : public Circuit
         requireEqual(pb, updateAccount_O->result(), merkleRootAfter.packed, "newMerkleRoot");
     }
 
-    bool generateWitness(const Block &block)
+    bool generateWitness(const Block &block) override
+    {
+        // The block is not kept, the next block cannot be generated incrementally
+        forgetLastBlock();
+        return generateWitness(block, std::vector<bool>(block.transactions.size(), true));
+    }
+
+    // Only generates the witness of the transactions that need to be
+    // regenerated, the witness of all other transactions needs to be on the
+    // protoboard already. The witness of the block itself is always generated.
+    bool generateWitness(const Block &block, const std::vector<bool> &regenerate)
     {
+        TRACE_SCOPE("generateWitness");
         if (block.transactions.size() != numTransactions)
         {
-            std::cout << "Invalid number of transactions: " << block.transactions.size() << std::endl;
+            LOG_ERROR("Invalid number of transactions: " << block.transactions.size());
             return false;
         }
 
+        // Reject invalid blocks before doing any work on the protoboard
+        BlockValidationFailure failure;
+        bool valid;
+        {
+            TRACE_SCOPE("validateBlock");
+            valid = validateBlock(block, &failure);
+        }
+        if (!valid)
+        {
+            LOG_ERROR("Invalid transaction " << failure.txIndex << ": " << failure.message);
+            return false;
+        }
+        MerkleFailure merkleFailure;
+        {
+            TRACE_SCOPE("checkMerkleProofs");
+            valid = checkMerkleProofs(block, &merkleFailure);
+        }
+        if (!valid)
+        {
+            LOG_ERROR(
+              "Invalid Merkle proof in transaction " << merkleFailure.txIndex << " (" << merkleFailure.tree
+                                                     << "): " << merkleFailure.message);
+            return false;
+        }
+
+        merkleHashMemo.clear();
+        fixedBaseMulMemo.clear();
         constants.generate_r1cs_witness();
 
         // State
@@ -769,6 +1009,37 @@ class UniversalCircuit : public Circuit
             pb.val(transactions[i].tx.getOutput(TXV_NUM_CONDITIONAL_TXS)) =
               block.transactions[i].witness.numConditionalTransactionsAfter;
         }
+        // Blocks are padded with noops which all have the same witness as long as
+        // the state they operate on is the same. Only generate the witness for the
+        // first one and copy it into all later ones.
+        std::vector<int> templates(block.transactions.size(), -1);
+        int lastNoop = -1;
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            if (!regenerate[i])
+            {
+                continue;
+            }
+            if (lastNoop >= 0 && isSameNoop(block.transactions[lastNoop], block.transactions[i]))
+            {
+                templates[i] = lastNoop;
+            }
+            else if (block.transactions[i].type == FieldT(int(TransactionType::Noop)))
+            {
+                lastNoop = i;
+            }
+        }
+        // Decompress all new public keys at once, every transaction decompresses
+        // the public key of its account update (a dummy one for most of them)
+        std::vector<FieldT> publicKeys;
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            if (regenerate[i] && templates[i] < 0)
+            {
+                publicKeys.push_back(block.transactions[i].accountUpdate.publicKeyY);
+            }
+        }
+        PublicKeyDecompressionCache::getInstance().prefetch(params, publicKeys);
 #ifdef MULTICORE
 #pragma omp parallel for
 #endif
@@ -776,31 +1047,212 @@ class UniversalCircuit : public Circuit
         {
             // std::cout << "--------------- tx: " << i << " ( " <<
             // block.transactions[i].type << " ) " << std::endl;
-            transactions[i].generate_r1cs_witness(block.transactions[i]);
+            if (regenerate[i] && templates[i] < 0)
+            {
+                TRACE_SCOPE_INDEX("transaction", i);
+                // The inverses only used in constraints are all computed at
+                // the end of the transaction
+                DeferredInversions inversions(pb);
+                transactions[i].generate_r1cs_witness_transaction(block.transactions[i]);
+            }
         }
 
-        // Update Protocol pool
-        updateAccount_P->generate_r1cs_witness(block.accountUpdate_P);
+        // Verify all signatures natively before doing the expensive work of
+        // generating the witness for the signature verifiers. Only the
+        // transactions that are generated are checked: the noops copied from a
+        // template have the same signatures as the template, and the
+        // transactions that are not regenerated (incremental witness) have the
+        // same input and state as in the last block, which is only kept when
+        // all its signatures passed. The operator signature is checked once the
+        // public input is known.
+        std::vector<SignatureCheck> signatures;
+        std::vector<unsigned int> signatureTransactions;
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            if (regenerate[i] && templates[i] < 0)
+            {
+                signatures.push_back(transactions[i].getSignatureA(block.transactions[i]));
+                signatures.push_back(transactions[i].getSignatureB(block.transactions[i]));
+                signatureTransactions.insert(signatureTransactions.end(), 2, i);
+            }
+        }
+        size_t invalidSignature;
+        {
+            TRACE_SCOPE("checkSignatures");
+            valid = checkSignatures(signatures, params, &invalidSignature);
+        }
+        if (!valid)
+        {
+            LOG_ERROR(
+              "Invalid signature " << ((invalidSignature % 2 == 0) ? "A" : "B") << " in transaction "
+                                   << signatureTransactions[invalidSignature]);
+            return false;
+        }
 
-        // Update Operator
-        updateAccount_O->generate_r1cs_witness(block.accountUpdate_O);
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            if (regenerate[i] && templates[i] < 0)
+            {
+                TRACE_SCOPE_INDEX("updates", i);
+                transactions[i].generate_r1cs_witness_updates(
+                  block.transactions[i], &merkleHashMemo, &fixedBaseMulMemo);
+            }
+        }
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+        for (unsigned int i = 0; i < block.transactions.size(); i++)
+        {
+            if (regenerate[i] && templates[i] >= 0)
+            {
+                TRACE_SCOPE_INDEX("copyTransaction", i);
+                copyTransactionWitness(templates[i], i);
+            }
+        }
+
+        // Shared signature verifiers
+        if (sharedSignatureVerifiers)
+        {
+            TRACE_SCOPE("sharedSignatureVerifiers");
+            std::vector<Signature> transactionSignatures;
+            for (const UniversalTransaction &transaction : block.transactions)
+            {
+                transactionSignatures.push_back(transaction.witness.signatureA);
+                transactionSignatures.push_back(transaction.witness.signatureB);
+            }
+            if (!sharedSignatureVerifiers->generate_r1cs_witness(transactionSignatures, &fixedBaseMulMemo))
+            {
+                return false;
+            }
+        }
 
         // Num conditional transactions
         numConditionalTransactions->generate_r1cs_witness_from_packed();
 
         // Public data
-        publicData.generate_r1cs_witness();
+        // The public input is calculated natively so the long serial witness of
+        // the sha256 hasher can be generated in parallel with the rest of the
+        // block.
+        {
+            TRACE_SCOPE("publicInput");
+            publicData.generate_r1cs_witness_publicInput();
+        }
 
-        // Signature
-        hash.generate_r1cs_witness();
-        signatureVerifier.generate_r1cs_witness(block.signature);
+        // The operator signs the public input together with its nonce
+        const FieldT blockMessage =
+          PoseidonNative<Poseidon_2>::hash({pb.val(publicData.publicInput), pb.val(accountBefore_O.nonce)});
+        const Signature blockSignature = blockSigner ? blockSigner(blockMessage) : block.signature;
+        {
+            TRACE_SCOPE("checkOperatorSignature");
+            const SignatureCheck check = {
+              jubjub::EdwardsPoint(pb.val(accountBefore_O.publicKey.x), pb.val(accountBefore_O.publicKey.y)),
+              blockMessage,
+              blockSignature,
+              true};
+            valid = checkSignatures({check}, params);
+        }
+        if (!valid)
+        {
+            LOG_ERROR("Invalid operator signature");
+            return false;
+        }
+#ifdef MULTICORE
+#pragma omp parallel sections
+#endif
+        {
+#ifdef MULTICORE
+#pragma omp section
+#endif
+            {
+                TRACE_SCOPE("publicData");
+                publicData.generate_r1cs_witness_hash();
+            }
+#ifdef MULTICORE
+#pragma omp section
+#endif
+            {
+                // Update Protocol pool
+                {
+                    TRACE_SCOPE("updateAccount_P");
+                    updateAccount_P->generate_r1cs_witness(block.accountUpdate_P, &merkleHashMemo);
+                }
+
+                // Update Operator
+                {
+                    TRACE_SCOPE("updateAccount_O");
+                    updateAccount_O->generate_r1cs_witness(block.accountUpdate_O, &merkleHashMemo);
+                }
+
+                // Signature
+                {
+                    TRACE_SCOPE("hash");
+                    hash.generate_r1cs_witness();
+                }
+                {
+                    TRACE_SCOPE("signatureVerifier");
+                    signatureVerifier.generate_r1cs_witness(blockSignature, &fixedBaseMulMemo);
+                }
+            }
+        }
 
         return true;
     }
 
+    // All transactions are created in exactly the same way, so the variables of
+    // a transaction are at the same offset in each transaction's range.
+    void copyTransactionWitness(unsigned int from, unsigned int to)
+    {
+        const size_t fromStart = transactionVariables[from].first;
+        const size_t toStart = transactionVariables[to].first;
+        const size_t numVariables = transactionVariables[from].second - fromStart;
+        assert(transactionVariables[to].second - toStart == numVariables);
+        copyWitness(pb, fromStart, toStart, numVariables);
+    }
+
     bool generateWitness(const json &input) override
     {
-        return generateWitness(input.get<Block>());
+        std::unique_ptr<Block> block;
+        {
+            TRACE_SCOPE("parseBlock");
+            block.reset(new Block(input.get<Block>()));
+        }
+        return generateWitness(*block);
+    }
+
+    // Keeps the block so the witness of the next block can also be generated
+    // incrementally
+    bool generateWitnessIncremental(const json &input) override
+    {
+        std::unique_ptr<Block> block;
+        {
+            TRACE_SCOPE("parseBlock");
+            block.reset(new Block(input.get<Block>()));
+        }
+        const std::vector<bool> regenerate =
+          lastBlock ? getChangedTransactions(*lastBlock, lastTransactions, *block, input["transactions"])
+                    : std::vector<bool>(block->transactions.size(), true);
+        LOG_INFO(
+          "Regenerating " << std::count(regenerate.begin(), regenerate.end(), true) << "/" << regenerate.size()
+                          << " transactions");
+
+        // A failure can leave the protoboard in any state
+        forgetLastBlock();
+        if (!generateWitness(*block, regenerate))
+        {
+            return false;
+        }
+        lastBlock = std::move(block);
+        lastTransactions = input["transactions"];
+        return true;
+    }
+
+    void forgetLastBlock()
+    {
+        lastBlock.reset();
+        lastTransactions = json();
     }
 
     unsigned int getBlockType() override
@@ -813,10 +1265,14 @@ class UniversalCircuit : public Circuit
         return numTransactions;
     }
 
+    unsigned int getNumSignatureVerifiers() override
+    {
+        return numSignatureVerifiers;
+    }
+
     void printInfo() override
     {
-        std::cout << pb.num_constraints() << " constraints (" << (pb.num_constraints() / numTransactions) << "/tx)"
-                  << std::endl;
+        LOG_INFO(pb.num_constraints() << " constraints (" << (pb.num_constraints() / numTransactions) << "/tx)");
     }
 };
 
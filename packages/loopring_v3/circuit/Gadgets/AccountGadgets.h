@@ -5,6 +5,7 @@
 
 #include "../Utils/Constants.h"
 #include "../Utils/Data.h"
+#include "../Utils/Log.h"
 
 #include "MerkleTree.h"
 
@@ -30,12 +31,12 @@ struct AccountState
 
 static void printAccount(const ProtoboardT &pb, const AccountState &state)
 {
-    std::cout << "- owner: " << pb.val(state.owner) << std::endl;
-    std::cout << "- publicKeyX: " << pb.val(state.publicKeyX) << std::endl;
-    std::cout << "- publicKeyY: " << pb.val(state.publicKeyY) << std::endl;
-    std::cout << "- nonce: " << pb.val(state.nonce) << std::endl;
-    std::cout << "- feeBipsAMM: " << pb.val(state.feeBipsAMM) << std::endl;
-    std::cout << "- balancesRoot: " << pb.val(state.balancesRoot) << std::endl;
+    LOG_ERROR("- owner: " << pb.val(state.owner));
+    LOG_ERROR("- publicKeyX: " << pb.val(state.publicKeyX));
+    LOG_ERROR("- publicKeyY: " << pb.val(state.publicKeyY));
+    LOG_ERROR("- nonce: " << pb.val(state.nonce));
+    LOG_ERROR("- feeBipsAMM: " << pb.val(state.feeBipsAMM));
+    LOG_ERROR("- balancesRoot: " << pb.val(state.balancesRoot));
 }
 
 class AccountGadget : public GadgetT
@@ -136,22 +137,22 @@ class UpdateAccountGadget : public GadgetT
     {
     }
 
-    void generate_r1cs_witness(const AccountUpdate &update)
+    void generate_r1cs_witness(const AccountUpdate &update, MerkleHashMemo *memo = nullptr)
     {
         leafBefore.generate_r1cs_witness();
         leafAfter.generate_r1cs_witness();
 
         proof.fill_with_field_elements(pb, update.proof.data);
-        proofVerifierBefore.generate_r1cs_witness();
-        rootCalculatorAfter.generate_r1cs_witness();
+        proofVerifierBefore.generate_r1cs_witness(memo);
+        rootCalculatorAfter.generate_r1cs_witness(memo);
 
         // ASSERT(pb.val(proofVerifierBefore.m_expected_root) == update.rootBefore,
         // annotation_prefix);
         if (pb.val(rootCalculatorAfter.result()) != update.rootAfter)
         {
-            std::cout << "Before:" << std::endl;
+            LOG_ERROR("Before:");
             printAccount(pb, valuesBefore);
-            std::cout << "After:" << std::endl;
+            LOG_ERROR("After:");
             printAccount(pb, valuesAfter);
             ASSERT(pb.val(rootCalculatorAfter.result()) == update.rootAfter, annotation_prefix);
         }
@@ -181,9 +182,9 @@ struct BalanceState
 
 static void printBalance(const ProtoboardT &pb, const BalanceState &state)
 {
-    std::cout << "- balance: " << pb.val(state.balance) << std::endl;
-    std::cout << "- weightAMM: " << pb.val(state.weightAMM) << std::endl;
-    std::cout << "- storageRoot: " << pb.val(state.storageRoot) << std::endl;
+    LOG_ERROR("- balance: " << pb.val(state.balance));
+    LOG_ERROR("- weightAMM: " << pb.val(state.weightAMM));
+    LOG_ERROR("- storageRoot: " << pb.val(state.storageRoot));
 }
 
 class BalanceGadget : public GadgetT
@@ -265,22 +266,22 @@ class UpdateBalanceGadget : public GadgetT
     {
     }
 
-    void generate_r1cs_witness(const BalanceUpdate &update)
+    void generate_r1cs_witness(const BalanceUpdate &update, MerkleHashMemo *memo = nullptr)
     {
         leafBefore.generate_r1cs_witness();
         leafAfter.generate_r1cs_witness();
 
         proof.fill_with_field_elements(pb, update.proof.data);
-        proofVerifierBefore.generate_r1cs_witness();
-        rootCalculatorAfter.generate_r1cs_witness();
+        proofVerifierBefore.generate_r1cs_witness(memo);
+        rootCalculatorAfter.generate_r1cs_witness(memo);
 
         // ASSERT(pb.val(proofVerifierBefore.m_expected_root) == update.rootBefore,
         // annotation_prefix);
         if (pb.val(rootCalculatorAfter.result()) != update.rootAfter)
         {
-            std::cout << "Before:" << std::endl;
+            LOG_ERROR("Before:");
             printBalance(pb, valuesBefore);
-            std::cout << "After:" << std::endl;
+            LOG_ERROR("After:");
             printBalance(pb, valuesAfter);
             ASSERT(pb.val(rootCalculatorAfter.result()) == update.rootAfter, annotation_prefix);
         }
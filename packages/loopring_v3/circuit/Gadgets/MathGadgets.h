@@ -5,6 +5,8 @@
 
 #include "../Utils/Constants.h"
 #include "../Utils/Data.h"
+#include "../Utils/Log.h"
+#include "../Utils/SHA256.h"
 
 #include "ethsnarks.hpp"
 #include "utils.hpp"
@@ -13,6 +15,10 @@
 #include "gadgets/subadd.hpp"
 #include "gadgets/poseidon.hpp"
 
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
 using namespace ethsnarks;
 using namespace jubjub;
 
@@ -44,6 +50,159 @@ static void requireEqual( //
       FMT(annotation_prefix, ".requireEqual"));
 }
 
+// Copies the witness of a gadget into another gadget created in exactly the
+// same way, which allocated the variables at the same offsets
+static void copyWitness(ProtoboardT &pb, size_t fromStart, size_t toStart, size_t numVariables)
+{
+    for (size_t i = 0; i < numVariables; i++)
+    {
+        pb.val(VariableT(toStart + i)) = pb.val(VariableT(fromStart + i));
+    }
+}
+
+// Hash of a field element for unordered containers
+struct FieldTHash
+{
+    size_t operator()(const FieldT &value) const
+    {
+        return value.mont_repr.data[0];
+    }
+};
+
+// Inverts all non-zero values with a single field inversion (Montgomery's
+// trick), zero values are left as is
+static void batchInverse(std::vector<FieldT> &values)
+{
+    std::vector<FieldT> products;
+    products.reserve(values.size());
+    FieldT product = FieldT::one();
+    for (const FieldT &value : values)
+    {
+        products.push_back(product);
+        if (!value.is_zero())
+        {
+            product *= value;
+        }
+    }
+    FieldT inverse = product.inverse();
+    for (size_t i = values.size(); i-- > 0;)
+    {
+        if (!values[i].is_zero())
+        {
+            const FieldT value = values[i];
+            values[i] = inverse * products[i];
+            inverse *= value;
+        }
+    }
+}
+
+// Defers the inversions of witness values that no other witness value depends
+// on (like the inverse proving that a value is non-zero) while it is active on
+// the current thread. All deferred inversions are resolved together with a
+// single field inversion when it goes out of scope.
+class DeferredInversions
+{
+  public:
+    DeferredInversions(ProtoboardT &_pb) : pb(_pb), previous(current())
+    {
+        current() = this;
+    }
+
+    ~DeferredInversions()
+    {
+        resolve();
+        current() = previous;
+    }
+
+    // pb.val(variable) = 1/value, deferred when possible.
+    // The inverse of 0 is set to 0 when deferred.
+    static void setInverse(ProtoboardT &pb, const VariableT &variable, const FieldT &value)
+    {
+        DeferredInversions *inversions = current();
+        if (inversions && &inversions->pb == &pb)
+        {
+            inversions->variables.push_back(variable);
+            inversions->values.push_back(value);
+        }
+        else
+        {
+            pb.val(variable) = value.inverse();
+        }
+    }
+
+    void resolve()
+    {
+        batchInverse(values);
+        for (size_t i = 0; i < variables.size(); i++)
+        {
+            pb.val(variables[i]) = values[i];
+        }
+        variables.clear();
+        values.clear();
+    }
+
+  private:
+    ProtoboardT &pb;
+    DeferredInversions *previous;
+    std::vector<VariableT> variables;
+    std::vector<FieldT> values;
+
+    static DeferredInversions *&current()
+    {
+        static thread_local DeferredInversions *inversions = nullptr;
+        return inversions;
+    }
+};
+
+// Memo of the gadgets whose witness was already generated for some inputs
+// while generating the witness of a block. Gadgets of the same kind that get
+// the same inputs can copy the witness instead of recomputing it.
+template <unsigned N> class WitnessMemo
+{
+  public:
+    using Key = std::array<FieldT, N>;
+
+    // Returns the first variable of a gadget that already has the witness for
+    // these inputs, or 0 if there is none
+    size_t find(const Key &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = gadgets.find(key);
+        return (it != gadgets.end()) ? it->second : 0;
+    }
+
+    // The witness of the gadget starting at firstVariable needs to be
+    // complete
+    void add(const Key &key, size_t firstVariable)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        gadgets.emplace(key, firstVariable);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        gadgets.clear();
+    }
+
+  private:
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            size_t h = 0;
+            for (const FieldT &value : key)
+            {
+                h = h * 31 + FieldTHash()(value);
+            }
+            return h;
+        }
+    };
+
+    std::mutex mutex;
+    std::unordered_map<Key, size_t, KeyHash> gadgets;
+};
+
 // Constants stored in a VariableT for ease of use
 class Constants : public GadgetT
 {
@@ -677,7 +836,7 @@ class AndGadget : public GadgetT
         // need
         if (inputs.size() > 3)
         {
-            std::cout << "[AndGadget] unexpected input length " << inputs.size() << std::endl;
+            LOG_ERROR("[AndGadget] unexpected input length " << inputs.size());
         }
         pb.add_r1cs_constraint(ConstraintT(inputs[0], inputs[1], results[0]), FMT(annotation_prefix, ".A && B"));
         for (unsigned int i = 2; i < inputs.size(); i++)
@@ -731,7 +890,7 @@ class OrGadget : public GadgetT
     {
         if (inputs.size() > 3)
         {
-            std::cout << "[OrGadget] unexpected input length " << inputs.size() << std::endl;
+            LOG_ERROR("[OrGadget] unexpected input length " << inputs.size());
         }
 
         pb.add_r1cs_constraint(
@@ -979,7 +1138,7 @@ class RequireNotZeroGadget : public GadgetT
 
     void generate_r1cs_witness()
     {
-        pb.val(A_inv) = pb.val(A).inverse();
+        DeferredInversions::setInverse(pb, A_inv, pb.val(A));
     }
 
     void generate_r1cs_constraints()
@@ -1640,17 +1799,56 @@ class PublicDataGadget : public GadgetT
     }
 
     void generate_r1cs_witness()
+    {
+        generate_r1cs_witness_publicInput();
+        generate_r1cs_witness_hash();
+    }
+
+    // Calculates the public input with a native hash of the public data, the
+    // witness of the hasher can be generated afterwards in parallel with any
+    // work that only depends on the public input.
+    void generate_r1cs_witness_publicInput()
+    {
+        const std::vector<FieldT> bits = publicDataBits.get_bits(pb);
+        std::vector<uint8_t> data(bits.size() / 8, 0);
+        for (size_t i = 0; i < bits.size(); i++)
+        {
+            if (bits[i] == FieldT::one())
+            {
+                data[i / 8] |= uint8_t(0x80 >> (i % 8));
+            }
+        }
+        const SHA256Digest digest = sha256(data);
+
+        // The first NUM_BITS_FIELD_CAPACITY bits of the hash, big-endian
+        FieldT value = FieldT::zero();
+        for (unsigned int i = 0; i < NUM_BITS_FIELD_CAPACITY; i++)
+        {
+            value = value + value;
+            if ((digest[i / 8] >> (7 - i % 8)) & 1)
+            {
+                value += FieldT::one();
+            }
+        }
+        pb.val(publicInput) = value;
+    }
+
+    void generate_r1cs_witness_hash()
     {
         // Calculate the hash
         hasher->generate_r1cs_witness();
 
         // Calculate the expected public input
         calculatedHash->generate_r1cs_witness_from_bits();
-        pb.val(publicInput) = pb.val(calculatedHash->packed);
+        ASSERT(pb.val(calculatedHash->packed) == pb.val(publicInput), annotation_prefix);
 
-        printBits("[ZKS]publicData: 0x", publicDataBits.get_bits(pb), false);
-        printBits("[ZKS]publicDataHash: 0x", hasher->result().bits.get_bits(pb));
-        print(pb, "[ZKS]publicInput", calculatedHash->packed);
+        // Dumping the public data is expensive, only do it when debugging
+        if (LOG_ENABLED(LogLevel::Debug))
+        {
+            printBits("[ZKS]publicData: 0x", publicDataBits.get_bits(pb), false);
+            printBits("[ZKS]publicDataHash: 0x", hasher->result().bits.get_bits(pb));
+            print(pb, "[ZKS]publicInput", calculatedHash->packed);
+        }
     }
 
     void generate_r1cs_constraints()
@@ -10,6 +10,13 @@
 namespace Loopring
 {
 
+// Memo of the Merkle tree nodes hashed while generating the witness of a block,
+// keyed by the children of the node. Updates in the same block often share
+// nodes (the operator and the protocol pool are updated in every transaction,
+// and the path after an update is the path before the next update of the same
+// leaf).
+using MerkleHashMemo = WitnessMemo<4>;
+
 class merkle_path_selector_4 : public GadgetT
 {
   public:
@@ -100,6 +107,8 @@ template <typename HashT> class merkle_path_compute_4 : public GadgetT
   public:
     std::vector<merkle_path_selector_4> m_selectors;
     std::vector<HashT> m_hashers;
+    // The range of variable indices [first, last) allocated by each hasher
+    std::vector<std::pair<size_t, size_t>> m_hasherVariables;
 
     // in_address_bits: {0..2}[in_depth*2]
     // in_leaf: The hashed leaf data
@@ -118,6 +127,7 @@ template <typename HashT> class merkle_path_compute_4 : public GadgetT
 
         m_selectors.reserve(in_depth);
         m_hashers.reserve(in_depth);
+        m_hasherVariables.reserve(in_depth);
         for (size_t i = 0; i < in_depth; i++)
         {
             m_selectors.push_back(merkle_path_selector_4(
@@ -128,8 +138,10 @@ template <typename HashT> class merkle_path_compute_4 : public GadgetT
               in_address_bits[i * 2 + 1],
               FMT(this->annotation_prefix, ".selector[%zu]", i)));
 
+            const size_t firstVariable = in_pb.num_variables() + 1;
             m_hashers.emplace_back(
               in_pb, var_array(m_selectors[i].getChildren()), FMT(this->annotation_prefix, ".hasher[%zu]", i));
+            m_hasherVariables.emplace_back(firstVariable, in_pb.num_variables() + 1);
         }
     }
 
@@ -148,12 +160,34 @@ template <typename HashT> class merkle_path_compute_4 : public GadgetT
         }
     }
 
-    void generate_r1cs_witness()
+    void generate_r1cs_witness(MerkleHashMemo *memo = nullptr)
     {
         for (size_t i = 0; i < m_hashers.size(); i++)
         {
             m_selectors[i].generate_r1cs_witness();
-            m_hashers[i].generate_r1cs_witness();
+            if (!memo)
+            {
+                m_hashers[i].generate_r1cs_witness();
+                continue;
+            }
+
+            const std::vector<VariableT> children = m_selectors[i].getChildren();
+            MerkleHashMemo::Key values;
+            for (size_t j = 0; j < values.size(); j++)
+            {
+                values[j] = this->pb.val(children[j]);
+            }
+            const size_t fromStart = memo->find(values);
+            if (fromStart != 0)
+            {
+                const size_t toStart = m_hasherVariables[i].first;
+                copyWitness(this->pb, fromStart, toStart, m_hasherVariables[i].second - toStart);
+            }
+            else
+            {
+                m_hashers[i].generate_r1cs_witness();
+                memo->add(values, m_hasherVariables[i].first);
+            }
         }
     }
 };
@@ -4,6 +4,8 @@
 #define _SIGNATUREGADGETS_H_
 
 #include "../Utils/Constants.h"
+#include "../Utils/Data.h"
+#include "../Utils/Jubjub.h"
 
 #include "ethsnarks.hpp"
 #include "utils.hpp"
@@ -12,12 +14,122 @@
 #include "gadgets/subadd.hpp"
 #include "gadgets/poseidon.hpp"
 
+#include <libsnark/common/data_structures/integer_permutation.hpp>
+#include <libsnark/common/routing_algorithms/as_waksman_routing_algorithm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
 using namespace ethsnarks;
 using namespace jubjub;
 
 namespace Loopring
 {
 
+// The expensive part of decompressing a public key from y:
+// irhs = 1/(d*y^2 - a) and rootX = sqrt((y^2 - 1) * irhs)
+struct PublicKeyDecompression
+{
+    FieldT irhs;
+    FieldT rootX;
+};
+
+// Cache of the public key decompressions for the whole process, keyed by y.
+// The same account keys (and the dummy key used by all other transaction
+// types) are decompressed in transaction after transaction.
+class PublicKeyDecompressionCache
+{
+  public:
+    static PublicKeyDecompressionCache &getInstance()
+    {
+        static PublicKeyDecompressionCache instance;
+        return instance;
+    }
+
+    PublicKeyDecompression get(const Params &params, const FieldT &y)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = decompressions.find(y);
+            if (it != decompressions.end())
+            {
+                return it->second;
+            }
+        }
+        PublicKeyDecompression decompression;
+        decompression.irhs = getRhs(params, y).inverse();
+        decompression.rootX = ((y.squared() - FieldT::one()) * decompression.irhs).sqrt();
+        add(y, decompression);
+        return decompression;
+    }
+
+    // Decompresses all keys that are not in the cache yet using a single
+    // inversion
+    void prefetch(const Params &params, const std::vector<FieldT> &ys)
+    {
+        std::vector<FieldT> missing;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unordered_set<FieldT, FieldTHash> unique;
+            for (const FieldT &y : ys)
+            {
+                if (decompressions.count(y) == 0 && unique.insert(y).second)
+                {
+                    missing.push_back(y);
+                }
+            }
+        }
+
+        std::vector<FieldT> irhs(missing.size());
+        for (size_t i = 0; i < missing.size(); i++)
+        {
+            irhs[i] = getRhs(params, missing[i]);
+        }
+        batchInverse(irhs);
+
+        std::vector<PublicKeyDecompression> results(missing.size());
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+        for (size_t i = 0; i < missing.size(); i++)
+        {
+            results[i].irhs = irhs[i];
+            results[i].rootX = ((missing[i].squared() - FieldT::one()) * irhs[i]).sqrt();
+        }
+        for (size_t i = 0; i < missing.size(); i++)
+        {
+            add(missing[i], results[i]);
+        }
+    }
+
+  private:
+    // Keeps the memory bounded for long running provers
+    static const size_t maxSize = 1 << 20;
+
+    std::mutex mutex;
+    std::unordered_map<FieldT, PublicKeyDecompression, FieldTHash> decompressions;
+
+    static FieldT getRhs(const Params &params, const FieldT &y)
+    {
+        return params.d * y.squared() - params.a;
+    }
+
+    void add(const FieldT &y, const PublicKeyDecompression &decompression)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (decompressions.size() >= maxSize)
+        {
+            decompressions.clear();
+        }
+        decompressions.emplace(y, decompression);
+    }
+};
+
 // Compresses the public key to 32 bytes. The public key is compressed and then fully decompressed to verify
 // that the decompression can be done successfully in a deterministic way. Because the code depends on a square root
 // it would be possible for different implementations to give inconsistent results if not correctly implemented
@@ -110,12 +222,13 @@ class CompressPublicKey : public GadgetT
     void generate_r1cs_witness()
     {
         // Reconstruct sqrt(xx)
+        const PublicKeyDecompression decompression = PublicKeyDecompressionCache::getInstance().get(params, pb.val(y));
         pb.val(yy) = pb.val(y).squared();
         pb.val(lhs) = pb.val(yy) - 1;
         pb.val(rhs) = params.d * pb.val(yy) - params.a;
-        pb.val(irhs) = pb.val(rhs).inverse();
+        pb.val(irhs) = decompression.irhs;
         pb.val(xx) = pb.val(lhs) * pb.val(irhs);
-        pb.val(rootX) = pb.val(xx).sqrt();
+        pb.val(rootX) = decompression.rootX;
 
         // Reconstruct x
         negRootX.generate_r1cs_witness();
@@ -226,11 +339,271 @@ class EdDSA_HashRAM_Poseidon_gadget : public GadgetT
     }
 };
 
+// Lookup tables of the windows of a fixed base point B. Window i covers the
+// scalar bits 2*i and 2*i+1 and holds j*(4^i)*B for j in [0, 4) (in affine
+// coordinates).
+struct FixedBaseWindow
+{
+    std::array<FieldT, 4> x;
+    std::array<FieldT, 4> y;
+};
+
+// The window tables of the fixed base points for the whole process. The tables
+// only depend on the base point, so they are calculated once instead of for
+// every multiplication gadget in the circuit.
+class FixedBaseWindowTables
+{
+  public:
+    using Windows = std::vector<FixedBaseWindow>;
+
+    static FixedBaseWindowTables &getInstance()
+    {
+        static FixedBaseWindowTables instance;
+        return instance;
+    }
+
+    std::shared_ptr<const Windows> get(const Params &params, const EdwardsPoint &base, size_t numWindows)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Table &table : tables)
+        {
+            if (table.x == base.x && table.y == base.y && table.windows->size() == numWindows)
+            {
+                return table.windows;
+            }
+        }
+        tables.push_back({base.x, base.y, create(params, base, numWindows)});
+        return tables.back().windows;
+    }
+
+  private:
+    struct Table
+    {
+        FieldT x;
+        FieldT y;
+        std::shared_ptr<const Windows> windows;
+    };
+
+    std::mutex mutex;
+    // Only a couple of base points are ever used
+    std::vector<Table> tables;
+
+    static std::shared_ptr<const Windows> create(const Params &params, const EdwardsPoint &base, size_t numWindows)
+    {
+        std::vector<ExtendedPoint> points;
+        points.reserve(numWindows * 3);
+        ExtendedPoint start(base);
+        for (size_t i = 0; i < numWindows; i++)
+        {
+            points.push_back(start);
+            points.push_back(start.dbl(params));
+            points.push_back(points.back().add(start, params));
+            start = points[points.size() - 2].dbl(params);
+        }
+
+        std::vector<FieldT> invZ(points.size());
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            invZ[i] = points[i].Z;
+        }
+        batchInverse(invZ);
+
+        auto windows = std::make_shared<Windows>(numWindows);
+        for (size_t i = 0; i < numWindows; i++)
+        {
+            FixedBaseWindow &window = (*windows)[i];
+            window.x[0] = FieldT::zero();
+            window.y[0] = FieldT::one();
+            for (size_t j = 1; j < 4; j++)
+            {
+                const size_t k = i * 3 + (j - 1);
+                window.x[j] = points[k].X * invZ[k];
+                window.y[j] = points[k].Y * invZ[k];
+            }
+        }
+        return windows;
+    }
+};
+
+// Fixed base scalar multiplication: result = B*s, with s given as bits (LSB
+// first). The point of each 2-bit window is selected from the shared window
+// table with linear combinations of the bits, and the windows are summed with
+// a chain of twisted Edwards additions (complete on Baby Jubjub, so the
+// identity in the tables needs no special case).
+//
+// The witness is calculated natively: the sums are accumulated in extended
+// coordinates and converted to affine with a single inversion, instead of two
+// inversions for every addition.
+class FixedBaseMulGadget : public GadgetT
+{
+  public:
+    const Params params;
+    const std::shared_ptr<const FixedBaseWindowTables::Windows> windows;
+    const VariableArrayT scalar;
+
+    // bit[2*i] * bit[2*i+1]
+    VariableArrayT bitProducts;
+
+    // sum[i] = sum[i-1] + window[i], sum[0] = window[0]
+    // beta = x1*y2, gamma = y1*x2, delta = (y1 - a*x1)*(x2 + y2), tau = beta*gamma
+    VariableArrayT beta;
+    VariableArrayT gamma;
+    VariableArrayT delta;
+    VariableArrayT tau;
+    VariableArrayT sumX;
+    VariableArrayT sumY;
+
+    FixedBaseMulGadget(
+      ProtoboardT &pb,
+      const Params &_params,
+      const EdwardsPoint &base,
+      const VariableArrayT &_scalar,
+      const std::string &prefix)
+        : GadgetT(pb, prefix),
+
+          params(_params),
+          windows(FixedBaseWindowTables::getInstance().get(_params, base, _scalar.size() / 2)),
+          scalar(_scalar),
+
+          bitProducts(make_var_array(pb, _scalar.size() / 2, FMT(prefix, ".bitProducts"))),
+          beta(make_var_array(pb, _scalar.size() / 2 - 1, FMT(prefix, ".beta"))),
+          gamma(make_var_array(pb, _scalar.size() / 2 - 1, FMT(prefix, ".gamma"))),
+          delta(make_var_array(pb, _scalar.size() / 2 - 1, FMT(prefix, ".delta"))),
+          tau(make_var_array(pb, _scalar.size() / 2 - 1, FMT(prefix, ".tau"))),
+          sumX(make_var_array(pb, _scalar.size() / 2 - 1, FMT(prefix, ".sumX"))),
+          sumY(make_var_array(pb, _scalar.size() / 2 - 1, FMT(prefix, ".sumY")))
+    {
+        assert(_scalar.size() % 2 == 0 && _scalar.size() >= 4);
+    }
+
+    void generate_r1cs_witness()
+    {
+        const size_t numWindows = windows->size();
+
+        // Look up the windows and sum them up without any inversions
+        std::vector<FieldT> windowX(numWindows);
+        std::vector<FieldT> windowY(numWindows);
+        std::vector<ExtendedPoint> sums(numWindows);
+        for (size_t i = 0; i < numWindows; i++)
+        {
+            const FieldT &b0 = pb.val(scalar[i * 2]);
+            const FieldT &b1 = pb.val(scalar[i * 2 + 1]);
+            pb.val(bitProducts[i]) = b0 * b1;
+
+            const size_t index = (b0 == FieldT::one() ? 1 : 0) + (b1 == FieldT::one() ? 2 : 0);
+            windowX[i] = (*windows)[i].x[index];
+            windowY[i] = (*windows)[i].y[index];
+            const ExtendedPoint window(windowX[i], windowY[i]);
+            sums[i] = (i == 0) ? window : sums[i - 1].add(window, params);
+        }
+
+        std::vector<FieldT> invZ(numWindows);
+        for (size_t i = 0; i < numWindows; i++)
+        {
+            invZ[i] = sums[i].Z;
+        }
+        batchInverse(invZ);
+
+        FieldT x1 = windowX[0];
+        FieldT y1 = windowY[0];
+        for (size_t i = 1; i < numWindows; i++)
+        {
+            const FieldT &x2 = windowX[i];
+            const FieldT &y2 = windowY[i];
+            pb.val(beta[i - 1]) = x1 * y2;
+            pb.val(gamma[i - 1]) = y1 * x2;
+            pb.val(delta[i - 1]) = (y1 - params.a * x1) * (x2 + y2);
+            pb.val(tau[i - 1]) = pb.val(beta[i - 1]) * pb.val(gamma[i - 1]);
+
+            x1 = sums[i].X * invZ[i];
+            y1 = sums[i].Y * invZ[i];
+            pb.val(sumX[i - 1]) = x1;
+            pb.val(sumY[i - 1]) = y1;
+        }
+    }
+
+    void generate_r1cs_constraints()
+    {
+        const size_t numWindows = windows->size();
+        for (size_t i = 0; i < numWindows; i++)
+        {
+            pb.add_r1cs_constraint(
+              ConstraintT(scalar[i * 2], scalar[i * 2 + 1], bitProducts[i]), FMT(annotation_prefix, ".bitProduct"));
+        }
+
+        LinearCombination x1 = getWindowX(0);
+        LinearCombination y1 = getWindowY(0);
+        for (size_t i = 1; i < numWindows; i++)
+        {
+            const LinearCombination x2 = getWindowX(i);
+            const LinearCombination y2 = getWindowY(i);
+            const size_t j = i - 1;
+            pb.add_r1cs_constraint(ConstraintT(x1, y2, beta[j]), FMT(annotation_prefix, ".beta"));
+            pb.add_r1cs_constraint(ConstraintT(y1, x2, gamma[j]), FMT(annotation_prefix, ".gamma"));
+            pb.add_r1cs_constraint(
+              ConstraintT(y1 - params.a * x1, x2 + y2, delta[j]), FMT(annotation_prefix, ".delta"));
+            pb.add_r1cs_constraint(ConstraintT(beta[j], gamma[j], tau[j]), FMT(annotation_prefix, ".tau"));
+            // x3 = (beta + gamma) / (1 + d*tau)
+            pb.add_r1cs_constraint(
+              ConstraintT(FieldT::one() + params.d * tau[j], sumX[j], beta[j] + gamma[j]),
+              FMT(annotation_prefix, ".sumX"));
+            // y3 = (delta + a*beta - gamma) / (1 - d*tau)
+            pb.add_r1cs_constraint(
+              ConstraintT(FieldT::one() - params.d * tau[j], sumY[j], delta[j] + params.a * beta[j] - gamma[j]),
+              FMT(annotation_prefix, ".sumY"));
+            x1 = sumX[j];
+            y1 = sumY[j];
+        }
+    }
+
+    const VariableT &result_x() const
+    {
+        return sumX.back();
+    }
+
+    const VariableT &result_y() const
+    {
+        return sumY.back();
+    }
+
+  private:
+    using LinearCombination = libsnark::linear_combination<FieldT>;
+
+    // c[0] + b0*(c[1] - c[0]) + b1*(c[2] - c[0]) + b0*b1*(c[3] - c[2] - c[1] + c[0])
+    LinearCombination getWindowValue(size_t i, const std::array<FieldT, 4> &c) const
+    {
+        LinearCombination lc;
+        lc.add_term(libsnark::variable<FieldT>(0), c[0]);
+        lc.add_term(scalar[i * 2], c[1] - c[0]);
+        lc.add_term(scalar[i * 2 + 1], c[2] - c[0]);
+        lc.add_term(bitProducts[i], c[3] - c[2] - c[1] + c[0]);
+        return lc;
+    }
+
+    LinearCombination getWindowX(size_t i) const
+    {
+        return getWindowValue(i, (*windows)[i].x);
+    }
+
+    LinearCombination getWindowY(size_t i) const
+    {
+        return getWindowValue(i, (*windows)[i].y);
+    }
+};
+
+// Memo of the B*s witnesses of a block, keyed by s. All signatures use the
+// same base point and every signature that isn't needed has s == 0, so most
+// of them can simply be copied.
+using FixedBaseMulMemo = WitnessMemo<1>;
+
 class EdDSA_Poseidon : public GadgetT
 {
   public:
+    const VariableArrayT m_s;
     PointValidator m_validator_R;             // IsValid(R)
-    fixed_base_mul m_lhs;                     // lhs = B*s
+    const size_t m_lhs_begin;                 // The range of variable indices [begin, end) of lhs
+    FixedBaseMulGadget m_lhs;                 // lhs = B*s
+    const size_t m_lhs_end;
     EdDSA_HashRAM_Poseidon_gadget m_hash_RAM; // hash_RAM = H(R,A,M)
     ScalarMult m_At;                          // A*hash_RAM
     PointAdder m_rhs;                         // rhs = R + (A*hash_RAM)
@@ -249,11 +622,15 @@ class EdDSA_Poseidon : public GadgetT
       const VariableT &in_msg,     // m
       const std::string &annotation_prefix)
         : GadgetT(in_pb, annotation_prefix),
+          m_s(in_s),
+
           // IsValid(R)
           m_validator_R(in_pb, in_params, in_R.x, in_R.y, FMT(this->annotation_prefix, ".validator_R")),
 
           // lhs = ScalarMult(B, s)
-          m_lhs(in_pb, in_params, in_base.x, in_base.y, in_s, FMT(this->annotation_prefix, ".lhs")),
+          m_lhs_begin(in_pb.num_variables() + 1),
+          m_lhs(in_pb, in_params, in_base, in_s, FMT(this->annotation_prefix, ".lhs")),
+          m_lhs_end(in_pb.num_variables() + 1),
 
           // hash_RAM = H(R, A, M)
           m_hash_RAM(in_pb, in_params, in_R, in_A, in_msg, FMT(this->annotation_prefix, ".hash_RAM")),
@@ -299,10 +676,11 @@ class EdDSA_Poseidon : public GadgetT
         valid.generate_r1cs_constraints();
     }
 
-    void generate_r1cs_witness()
+    // All verifiers sharing the memo need to use the same base point
+    void generate_r1cs_witness(FixedBaseMulMemo *memo = nullptr)
     {
         m_validator_R.generate_r1cs_witness();
-        m_lhs.generate_r1cs_witness();
+        generate_r1cs_witness_lhs(memo);
         m_hash_RAM.generate_r1cs_witness();
         m_At.generate_r1cs_witness();
         m_rhs.generate_r1cs_witness();
@@ -313,6 +691,27 @@ class EdDSA_Poseidon : public GadgetT
         valid.generate_r1cs_witness();
     }
 
+    void generate_r1cs_witness_lhs(FixedBaseMulMemo *memo)
+    {
+        if (!memo)
+        {
+            m_lhs.generate_r1cs_witness();
+            return;
+        }
+
+        const FixedBaseMulMemo::Key s = {m_s.get_field_element_from_bits(pb)};
+        const size_t fromStart = memo->find(s);
+        if (fromStart != 0)
+        {
+            copyWitness(pb, fromStart, m_lhs_begin, m_lhs_end - m_lhs_begin);
+        }
+        else
+        {
+            m_lhs.generate_r1cs_witness();
+            memo->add(s, m_lhs_begin);
+        }
+    }
+
     const VariableT &result() const
     {
         return valid.result();
@@ -359,12 +758,12 @@ class SignatureVerifier : public GadgetT
     {
     }
 
-    void generate_r1cs_witness(Signature sig)
+    void generate_r1cs_witness(Signature sig, FixedBaseMulMemo *memo = nullptr)
     {
         pb.val(sig_R.x) = sig.R.x;
         pb.val(sig_R.y) = sig.R.y;
         sig_s.fill_with_bits_of_field_element(pb, sig.s);
-        signatureVerifier.generate_r1cs_witness();
+        signatureVerifier.generate_r1cs_witness(memo);
         valid.generate_r1cs_witness();
     }
 
@@ -385,6 +784,220 @@ class SignatureVerifier : public GadgetT
     }
 };
 
+// A signature that needs to be verified when required is 1
+struct SignatureRequest
+{
+    jubjub::VariablePointT publicKey;
+    VariableT message;
+    VariableT required;
+};
+
+// The values of a signature request that are routed to the verifiers
+static const unsigned int SIGNATURE_PACKET_PUBKEY_X = 0;
+static const unsigned int SIGNATURE_PACKET_PUBKEY_Y = 1;
+static const unsigned int SIGNATURE_PACKET_MESSAGE = 2;
+static const unsigned int SIGNATURE_PACKET_REQUIRED = 3;
+static const unsigned int SIGNATURE_PACKET_SIZE = 4;
+
+// Verifies all required signatures of the requests with a limited number of
+// signature verifiers. The requests are permuted by an AS-Waksman network, the
+// first outputs of the network go to the verifiers. A verifier only requires a
+// valid signature when its request is required, the outputs that don't go to a
+// verifier can't be required. The network has O(N log N) switches for N
+// requests, independent of the number of verifiers. Every setting of the
+// switches is a permutation, so each request ends up at exactly one output.
+class SharedSignatureVerifiers : public GadgetT
+{
+  public:
+    const std::vector<SignatureRequest> requests;
+    const libsnark::as_waksman_topology topology;
+
+    // packets[c][p] is the p-th packet going into column c of the network,
+    // packets.back() are the outputs
+    std::vector<std::vector<VariableArrayT>> packets;
+    // The switch of column c with top packet p, 1 if the packets are crossed
+    std::vector<std::map<size_t, VariableT>> switches;
+    std::vector<jubjub::VariablePointT> publicKeys;
+    std::vector<std::unique_ptr<SignatureVerifier>> verifiers;
+
+    SharedSignatureVerifiers(
+      ProtoboardT &pb,
+      const jubjub::Params &params,
+      const Constants &constants,
+      const std::vector<SignatureRequest> &_requests,
+      unsigned int numVerifiers,
+      const std::string &prefix)
+        : GadgetT(pb, prefix), requests(_requests), topology(libsnark::generate_as_waksman_topology(_requests.size()))
+    {
+        packets.resize(topology.size() + 1);
+        for (const SignatureRequest &request : requests)
+        {
+            VariableArrayT packet;
+            packet.push_back(request.publicKey.x);
+            packet.push_back(request.publicKey.y);
+            packet.push_back(request.message);
+            packet.push_back(request.required);
+            packets[0].push_back(packet);
+        }
+        switches.resize(topology.size());
+        for (size_t c = 0; c < topology.size(); c++)
+        {
+            packets[c + 1].resize(requests.size());
+            for (size_t p = 0; p < requests.size(); p++)
+            {
+                const size_t straight = topology[c][p].first;
+                const size_t cross = topology[c][p].second;
+                if (straight == cross)
+                {
+                    packets[c + 1][straight] = packets[c][p];
+                    continue;
+                }
+                // Packets p and p + 1 share the switch
+                switches[c].emplace(p, make_variable(pb, FMT(prefix, ".switch[%zu][%zu]", c, p)));
+                packets[c + 1][straight] =
+                  make_var_array(pb, SIGNATURE_PACKET_SIZE, FMT(prefix, ".packet[%zu][%zu]", c + 1, straight));
+                packets[c + 1][cross] =
+                  make_var_array(pb, SIGNATURE_PACKET_SIZE, FMT(prefix, ".packet[%zu][%zu]", c + 1, cross));
+                p++;
+            }
+        }
+
+        // More verifiers than requests are never used. The verifiers keep
+        // references to the inputs.
+        const std::vector<VariableArrayT> &outputs = packets.back();
+        const size_t n = std::min<size_t>(numVerifiers, requests.size());
+        publicKeys.reserve(n);
+        verifiers.reserve(n);
+        for (size_t k = 0; k < n; k++)
+        {
+            publicKeys.emplace_back(outputs[k][SIGNATURE_PACKET_PUBKEY_X], outputs[k][SIGNATURE_PACKET_PUBKEY_Y]);
+            verifiers.emplace_back(new SignatureVerifier(
+              pb,
+              params,
+              constants,
+              publicKeys[k],
+              outputs[k][SIGNATURE_PACKET_MESSAGE],
+              outputs[k][SIGNATURE_PACKET_REQUIRED],
+              FMT(prefix, ".verifier[%zu]", k)));
+        }
+    }
+
+    // signatures[j] is the signature of request j. The required requests are
+    // routed to the verifiers in order. Returns false if more signatures are
+    // required than there are verifiers.
+    bool generate_r1cs_witness(const std::vector<Signature> &signatures, FixedBaseMulMemo *memo = nullptr)
+    {
+        size_t numRequired = 0;
+        for (const SignatureRequest &request : requests)
+        {
+            numRequired += (pb.val(request.required) == FieldT::one()) ? 1 : 0;
+        }
+        if (numRequired > verifiers.size())
+        {
+            LOG_ERROR("More than " << verifiers.size() << " signatures required");
+            return false;
+        }
+
+        libsnark::integer_permutation destinations(requests.size());
+        size_t nextRequired = 0;
+        size_t nextOther = numRequired;
+        for (size_t j = 0; j < requests.size(); j++)
+        {
+            const bool required = (pb.val(requests[j].required) == FieldT::one());
+            destinations.set(j, required ? nextRequired++ : nextOther++);
+        }
+        generate_r1cs_witness(signatures, destinations, memo);
+        return true;
+    }
+
+    // Routes request j to output destinations.get(j)
+    void generate_r1cs_witness(
+      const std::vector<Signature> &signatures,
+      const libsnark::integer_permutation &destinations,
+      FixedBaseMulMemo *memo = nullptr)
+    {
+        libsnark::as_waksman_routing routing = libsnark::get_as_waksman_routing(destinations);
+        for (size_t c = 0; c < topology.size(); c++)
+        {
+            for (const auto &it : switches[c])
+            {
+                const size_t p = it.first;
+                const bool crossed = routing[c][p];
+                pb.val(it.second) = crossed ? FieldT::one() : FieldT::zero();
+                const VariableArrayT &straight = packets[c + 1][topology[c][p].first];
+                const VariableArrayT &cross = packets[c + 1][topology[c][p].second];
+                for (unsigned int i = 0; i < SIGNATURE_PACKET_SIZE; i++)
+                {
+                    const FieldT top = pb.val(packets[c][p][i]);
+                    const FieldT bottom = pb.val(packets[c][p + 1][i]);
+                    pb.val(straight[i]) = crossed ? bottom : top;
+                    pb.val(cross[i]) = crossed ? top : bottom;
+                }
+            }
+        }
+
+        // Only the verifiers of required requests get the real signature
+        const Signature dummy = dummySignature.get<Signature>();
+        std::vector<Signature> verifierSignatures(verifiers.size(), dummy);
+        for (size_t j = 0; j < requests.size(); j++)
+        {
+            const size_t k = destinations.get(j);
+            if (k < verifiers.size() && pb.val(requests[j].required) == FieldT::one())
+            {
+                verifierSignatures[k] = signatures[j];
+            }
+        }
+
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+        for (unsigned int k = 0; k < verifiers.size(); k++)
+        {
+            verifiers[k]->generate_r1cs_witness(verifierSignatures[k], memo);
+        }
+    }
+
+    void generate_r1cs_constraints()
+    {
+        for (size_t c = 0; c < topology.size(); c++)
+        {
+            for (const auto &it : switches[c])
+            {
+                const size_t p = it.first;
+                const VariableT &crossed = it.second;
+                const VariableArrayT &straight = packets[c + 1][topology[c][p].first];
+                const VariableArrayT &cross = packets[c + 1][topology[c][p].second];
+                libsnark::generate_boolean_r1cs_constraint<ethsnarks::FieldT>(
+                  pb, crossed, FMT(annotation_prefix, ".switch[%zu][%zu].bitness", c, p));
+                for (unsigned int i = 0; i < SIGNATURE_PACKET_SIZE; i++)
+                {
+                    const VariableT &top = packets[c][p][i];
+                    const VariableT &bottom = packets[c][p + 1][i];
+                    pb.add_r1cs_constraint(
+                      ConstraintT(crossed, bottom - top, straight[i] - top),
+                      FMT(annotation_prefix, ".switch[%zu][%zu].straight[%u]", c, p, i));
+                    pb.add_r1cs_constraint(
+                      ConstraintT(crossed, top - bottom, cross[i] - bottom),
+                      FMT(annotation_prefix, ".switch[%zu][%zu].cross[%u]", c, p, i));
+                }
+            }
+        }
+
+        // A required request needs to be routed to a verifier
+        const std::vector<VariableArrayT> &outputs = packets.back();
+        for (size_t p = verifiers.size(); p < outputs.size(); p++)
+        {
+            pb.add_r1cs_constraint(
+              ConstraintT(outputs[p][SIGNATURE_PACKET_REQUIRED], 1, 0), FMT(annotation_prefix, ".notVerified[%zu]", p));
+        }
+
+        for (const auto &verifier : verifiers)
+        {
+            verifier->generate_r1cs_constraints();
+        }
+    }
+};
+
 } // namespace Loopring
 
 #endif
@@ -5,6 +5,7 @@
 
 #include "../Utils/Constants.h"
 #include "../Utils/Data.h"
+#include "../Utils/Log.h"
 
 #include "MerkleTree.h"
 
@@ -24,8 +25,8 @@ struct StorageState
 
 static void printStorage(const ProtoboardT &pb, const StorageState &state)
 {
-    std::cout << "- data: " << pb.val(state.data) << std::endl;
-    std::cout << "- storageID: " << pb.val(state.storageID) << std::endl;
+    LOG_ERROR("- data: " << pb.val(state.data));
+    LOG_ERROR("- storageID: " << pb.val(state.storageID));
 }
 
 class StorageGadget : public GadgetT
@@ -92,21 +93,21 @@ class UpdateStorageGadget : public GadgetT
     {
     }
 
-    void generate_r1cs_witness(const StorageUpdate &update)
+    void generate_r1cs_witness(const StorageUpdate &update, MerkleHashMemo *memo = nullptr)
     {
         leafBefore.generate_r1cs_witness();
         leafAfter.generate_r1cs_witness();
 
         proof.fill_with_field_elements(pb, update.proof.data);
-        proofVerifierBefore.generate_r1cs_witness();
-        rootCalculatorAfter.generate_r1cs_witness();
+        proofVerifierBefore.generate_r1cs_witness(memo);
+        rootCalculatorAfter.generate_r1cs_witness(memo);
 
         ASSERT(pb.val(proofVerifierBefore.m_expected_root) == update.rootBefore, annotation_prefix);
         if (pb.val(rootCalculatorAfter.result()) != update.rootAfter)
         {
-            std::cout << "Before:" << std::endl;
+            LOG_ERROR("Before:");
             printStorage(pb, valuesBefore);
-            std::cout << "After:" << std::endl;
+            LOG_ERROR("After:");
             printStorage(pb, valuesAfter);
             ASSERT(pb.val(rootCalculatorAfter.result()) == update.rootAfter, annotation_prefix);
         }
@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _BENCHMARKRESULTS_H_
+#define _BENCHMARKRESULTS_H_
+
+#include "Data.h"
+#include "Log.h"
+#include "MemoryProfile.h"
+#include "Statistics.h"
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The commit the prover was built from, set by the build
+#ifndef GIT_COMMIT
+#define GIT_COMMIT "unknown"
+#endif
+
+namespace Loopring
+{
+
+// Differences with a p-value below this are significant
+static const double BENCHMARK_SIGNIFICANCE_LEVEL = 0.05;
+
+static std::string getCPUModel()
+{
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+    {
+        if (line.compare(0, 10, "model name") == 0)
+        {
+            const size_t pos = line.find(':');
+            return (pos != std::string::npos && pos + 2 <= line.size()) ? line.substr(pos + 2) : line;
+        }
+    }
+    return "unknown";
+}
+
+// Information about the machine and the build the results were measured with
+static json getSystemInfo()
+{
+    json info;
+    info["commit"] = GIT_COMMIT;
+    info["cpu"] = getCPUModel();
+    info["num_cpus"] = std::thread::hardware_concurrency();
+    info["peak_rss_mb"] = getPeakRSS_MB();
+    return info;
+}
+
+// A measured value of a benchmark in the baseline and in the new results
+struct BenchmarkComparison
+{
+    std::string name;
+    double baselineMean;
+    double mean;
+    // Relative to the baseline, e.g. 0.05 when 5% slower
+    double change;
+    // NaN when there are not enough samples to know
+    double pValue;
+    bool significant;
+    // Significantly slower by more than the allowed slowdown
+    bool regression;
+};
+
+static void compareSamples(
+  const std::string &name,
+  const std::vector<double> &baseline,
+  const std::vector<double> &samples,
+  double maxSlowdown,
+  std::vector<BenchmarkComparison> &comparisons)
+{
+    if (baseline.empty() || samples.empty())
+    {
+        return;
+    }
+    BenchmarkComparison comparison;
+    comparison.name = name;
+    comparison.baselineMean = summarizeSamples(baseline).mean;
+    comparison.mean = summarizeSamples(samples).mean;
+    comparison.change = (comparison.baselineMean != 0.0)
+                          ? (comparison.mean - comparison.baselineMean) / comparison.baselineMean
+                          : 0.0;
+    TTestResult tTest;
+    comparison.pValue = welchTTest(baseline, samples, tTest) ? tTest.pValue : NAN;
+    comparison.significant = (comparison.pValue < BENCHMARK_SIGNIFICANCE_LEVEL);
+    comparison.regression = comparison.significant && comparison.change > maxSlowdown;
+    comparisons.push_back(comparison);
+}
+
+// Values that do not change between runs (e.g. the number of constraints)
+static void compareExact(
+  const std::string &name,
+  double baseline,
+  double value,
+  double maxSlowdown,
+  std::vector<BenchmarkComparison> &comparisons)
+{
+    compareSamples(name, {baseline, baseline}, {value, value}, maxSlowdown, comparisons);
+}
+
+static std::vector<double> getSamples(const json &iterations, const std::string &key)
+{
+    std::vector<double> samples;
+    for (const json &iteration : iterations)
+    {
+        if (iteration.contains(key))
+        {
+            samples.push_back(iteration.at(key).get<double>());
+        }
+    }
+    return samples;
+}
+
+// The samples of a single stage or phase (group is "stages" or "phases")
+static std::vector<double> getStageSamples(const json &iterations, const std::string &group, const std::string &stage)
+{
+    std::vector<double> samples;
+    for (const json &iteration : iterations)
+    {
+        if (iteration.contains(group) && iteration.at(group).contains(stage))
+        {
+            samples.push_back(iteration.at(group).at(stage).get<double>());
+        }
+    }
+    return samples;
+}
+
+// Results of -benchmark, the configs are matched by their values
+static void compareProverResults(
+  const json &baseline,
+  const json &results,
+  double maxSlowdown,
+  std::vector<BenchmarkComparison> &comparisons)
+{
+    for (const json &result : results.at("results"))
+    {
+        for (const json &baselineResult : baseline.at("results"))
+        {
+            if (baselineResult.at("config") != result.at("config"))
+            {
+                continue;
+            }
+            const std::string name = result.at("config").dump();
+            const json &baselineIterations = baselineResult.at("iterations");
+            const json &iterations = result.at("iterations");
+            compareSamples(
+              name + " prove_ms",
+              getSamples(baselineIterations, "prove_ms"),
+              getSamples(iterations, "prove_ms"),
+              maxSlowdown,
+              comparisons);
+            compareSamples(
+              name + " witness_ms",
+              getSamples(baselineIterations, "witness_ms"),
+              getSamples(iterations, "witness_ms"),
+              maxSlowdown,
+              comparisons);
+
+            // The phases and the stages of the prover (e.g. each FFT and
+            // multi-exponentiation)
+            for (const std::string group : {"phases", "stages"})
+            {
+                if (iterations.empty() || !iterations[0].contains(group))
+                {
+                    continue;
+                }
+                for (const auto &stage : iterations[0].at(group).items())
+                {
+                    compareSamples(
+                      name + " " + stage.key() + " ms",
+                      getStageSamples(baselineIterations, group, stage.key()),
+                      getStageSamples(iterations, group, stage.key()),
+                      maxSlowdown,
+                      comparisons);
+                }
+            }
+            break;
+        }
+    }
+}
+
+// Results of dex_circuit_bench, the gadgets are matched by name
+static void compareGadgetResults(
+  const json &baseline,
+  const json &results,
+  double maxSlowdown,
+  std::vector<BenchmarkComparison> &comparisons)
+{
+    for (const json &result : results.at("benchmarks"))
+    {
+        for (const json &baselineResult : baseline.at("benchmarks"))
+        {
+            if (baselineResult.at("name") != result.at("name"))
+            {
+                continue;
+            }
+            const std::string name = result.at("name").get<std::string>();
+            compareExact(
+              name + " constraints",
+              baselineResult.at("constraints").get<double>(),
+              result.at("constraints").get<double>(),
+              maxSlowdown,
+              comparisons);
+            compareExact(
+              name + " variables",
+              baselineResult.at("variables").get<double>(),
+              result.at("variables").get<double>(),
+              maxSlowdown,
+              comparisons);
+            if (baselineResult.contains("witnessGenerationSamplesUs") && result.contains("witnessGenerationSamplesUs"))
+            {
+                compareSamples(
+                  name + " witness_us",
+                  baselineResult.at("witnessGenerationSamplesUs").get<std::vector<double>>(),
+                  result.at("witnessGenerationSamplesUs").get<std::vector<double>>(),
+                  maxSlowdown,
+                  comparisons);
+            }
+            break;
+        }
+    }
+}
+
+// Compares the results of -benchmark or of dex_circuit_bench with a baseline.
+// maxSlowdown is the relative slowdown that is still accepted (e.g. 0.02).
+static bool compareBenchmarkResults(
+  const json &baseline,
+  const json &results,
+  double maxSlowdown,
+  std::vector<BenchmarkComparison> &comparisons)
+{
+    if (baseline.contains("results") && results.contains("results"))
+    {
+        compareProverResults(baseline, results, maxSlowdown, comparisons);
+    }
+    else if (baseline.contains("benchmarks") && results.contains("benchmarks"))
+    {
+        compareGadgetResults(baseline, results, maxSlowdown, comparisons);
+    }
+    else
+    {
+        LOG_ERROR("The results are not of the same kind of benchmark");
+        return false;
+    }
+    return true;
+}
+
+} // namespace Loopring
+
+#endif
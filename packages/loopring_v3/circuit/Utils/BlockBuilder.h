@@ -0,0 +1,1296 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _BLOCKBUILDER_H_
+#define _BLOCKBUILDER_H_
+
+#include "BlockValidator.h"
+#include "Constants.h"
+#include "Data.h"
+#include "Log.h"
+#include "MerkleChecker.h"
+#include "SparseMerkleTree.h"
+#include "Utils.h"
+#include "../ThirdParty/BigIntHeader.hpp"
+
+#include "ethsnarks.hpp"
+
+#include <cassert>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Integers in the block input can be numbers, decimal strings or booleans
+static FieldT parseFieldElement(const json &value)
+{
+    if (value.is_string())
+    {
+        return FieldT(value.get<std::string>().c_str());
+    }
+    if (value.is_boolean())
+    {
+        return value.get<bool>() ? FieldT::one() : FieldT::zero();
+    }
+    return FieldT(value.get<unsigned long>());
+}
+
+static FieldT getField(const json &j, const char *key)
+{
+    return parseFieldElement(j.at(key));
+}
+
+static FieldT fromBigInt(const BigInt &value)
+{
+    return FieldT(value.to_string().c_str());
+}
+
+static std::string toDecimalString(const FieldT &value)
+{
+    return toBigInt(value).to_string();
+}
+
+static unsigned long getStorageAddress(const FieldT &storageID)
+{
+    return storageID.as_ulong() % NUM_STORAGE_SLOTS;
+}
+
+// A value that is only set by some transaction types
+template <typename T> class TxValue
+{
+  public:
+    TxValue() : set(false)
+    {
+    }
+
+    TxValue &operator=(const T &_value)
+    {
+        value = _value;
+        set = true;
+        return *this;
+    }
+
+    bool isSet() const
+    {
+        return set;
+    }
+
+    T getOr(const T &defaultValue) const
+    {
+        return set ? value : defaultValue;
+    }
+
+  private:
+    bool set;
+    T value;
+};
+
+class ExchangeBalance
+{
+  public:
+    ExchangeBalance(const SparseMerkleTree &emptyStorageTree)
+        : balance(FieldT::zero()), weightAMM(FieldT::zero()), storageTree(emptyStorageTree)
+    {
+    }
+
+    FieldT balance;
+    FieldT weightAMM;
+    // Only the storage leaves that were written, by storage address
+    std::unordered_map<unsigned long, StorageLeaf> storage;
+    SparseMerkleTree storageTree;
+    // The storage addresses written since the last ExchangeState::clearChanges
+    std::unordered_set<unsigned long> changedStorage;
+
+    StorageLeaf getStorage(unsigned long address) const
+    {
+        auto it = storage.find(address);
+        return (it != storage.end()) ? it->second : getDefaultStorageLeaf();
+    }
+
+    BalanceLeaf getLeaf() const
+    {
+        BalanceLeaf leaf;
+        leaf.balance = balance;
+        leaf.weightAMM = weightAMM;
+        leaf.storageRoot = storageTree.getRoot();
+        return leaf;
+    }
+};
+
+class ExchangeAccount
+{
+  public:
+    ExchangeAccount(const SparseMerkleTree &emptyBalancesTree)
+        : owner(FieldT::zero()),
+          nonce(FieldT::zero()),
+          feeBipsAMM(FieldT::zero()),
+          balancesTree(emptyBalancesTree)
+    {
+        publicKey.x = FieldT::zero();
+        publicKey.y = FieldT::zero();
+    }
+
+    FieldT owner;
+    jubjub::EdwardsPoint publicKey;
+    FieldT nonce;
+    FieldT feeBipsAMM;
+    // Only the balances that were written, by token ID
+    std::unordered_map<unsigned long, ExchangeBalance> balances;
+    SparseMerkleTree balancesTree;
+    // The token IDs written since the last ExchangeState::clearChanges
+    std::unordered_set<unsigned long> changedBalances;
+
+    AccountLeaf getLeaf() const
+    {
+        AccountLeaf leaf;
+        leaf.owner = owner;
+        leaf.publicKey = publicKey;
+        leaf.nonce = nonce;
+        leaf.feeBipsAMM = feeBipsAMM;
+        leaf.balancesRoot = balancesTree.getRoot();
+        return leaf;
+    }
+};
+
+class ExchangeState;
+
+// A state that is not in memory (e.g. a snapshot in a StateStore). The accounts
+// are only read from it when they are used for the first time.
+class StateSource
+{
+  public:
+    virtual ~StateSource(){};
+
+    virtual FieldT getRoot() const = 0;
+
+    // Reads the account and restores the nodes of the accounts tree needed to
+    // update it
+    virtual void loadAccount(ExchangeState &state, unsigned long accountID, ExchangeAccount &account) const = 0;
+};
+
+// The native state of an exchange, the same as the State in operator/state.py.
+// All updates return the Merkle proofs the circuit needs.
+class ExchangeState
+{
+  public:
+    ExchangeState()
+        : emptyBalance(newStorageTree()),
+          emptyAccount(newBalancesTree(emptyBalance.storageTree.getRoot())),
+          accountsTree(newAccountsTree(emptyAccount.balancesTree.getRoot())),
+          source(nullptr)
+    {
+    }
+
+    // Starts from the state of the source instead of the empty state. Must be
+    // called before any account is used, the source needs to stay valid.
+    void setSource(const StateSource *_source)
+    {
+        assert(accounts.empty());
+        source = _source;
+        accountsTree.restoreNode(TREE_DEPTH_ACCOUNTS, 0, source->getRoot());
+    }
+
+    // If an account below the node of the accounts tree was read from the
+    // source (the node may be changed since)
+    bool isLoaded(unsigned int level, unsigned long index) const
+    {
+        auto it = loadedAccounts.lower_bound(index << (2 * level));
+        return it != loadedAccounts.end() && (*it >> (2 * level)) == index;
+    }
+
+    const FieldT &getRoot() const
+    {
+        return accountsTree.getRoot();
+    }
+
+    ExchangeAccount &getAccount(unsigned long accountID)
+    {
+        auto it = accounts.find(accountID);
+        if (it != accounts.end())
+        {
+            return it->second;
+        }
+        ExchangeAccount &account = accounts.emplace(accountID, emptyAccount).first->second;
+        if (source != nullptr)
+        {
+            source->loadAccount(*this, accountID, account);
+            loadedAccounts.insert(accountID);
+        }
+        return account;
+    }
+
+    ExchangeBalance &getBalance(ExchangeAccount &account, unsigned long tokenID)
+    {
+        return account.balances.emplace(tokenID, emptyBalance).first->second;
+    }
+
+    const SparseMerkleTree &getAccountsTree() const
+    {
+        return accountsTree;
+    }
+
+    SparseMerkleTree &getAccountsTree()
+    {
+        return accountsTree;
+    }
+
+    // The accounts written since the last clearChanges (used by StateStore to
+    // only copy what changed)
+    const std::unordered_set<unsigned long> &getChangedAccounts() const
+    {
+        return changedAccounts;
+    }
+
+    void clearChanges()
+    {
+        for (unsigned long accountID : changedAccounts)
+        {
+            ExchangeAccount &account = getAccount(accountID);
+            for (unsigned long tokenID : account.changedBalances)
+            {
+                getBalance(account, tokenID).changedStorage.clear();
+            }
+            account.changedBalances.clear();
+        }
+        changedAccounts.clear();
+    }
+
+    // Same as getBalance, but does not add the balance to the account
+    const ExchangeBalance &findBalance(const ExchangeAccount &account, unsigned long tokenID) const
+    {
+        auto it = account.balances.find(tokenID);
+        return (it != account.balances.end()) ? it->second : emptyBalance;
+    }
+
+    StorageUpdate updateStorage(ExchangeBalance &balance, const FieldT &storageID, const FieldT &data)
+    {
+        const unsigned long address = getStorageAddress(storageID);
+
+        StorageUpdate update;
+        update.storageID = storageID;
+        update.rootBefore = balance.storageTree.getRoot();
+        update.before = balance.getStorage(address);
+        update.proof = balance.storageTree.createProof(address);
+
+        StorageLeaf &leaf = balance.storage.emplace(address, getDefaultStorageLeaf()).first->second;
+        leaf.data = data;
+        leaf.storageID = storageID;
+        balance.storageTree.update(address, hashStorageLeaf(leaf));
+        balance.changedStorage.insert(address);
+
+        update.after = leaf;
+        update.rootAfter = balance.storageTree.getRoot();
+        return update;
+    }
+
+    BalanceUpdate updateBalance(
+      ExchangeAccount &account,
+      unsigned long tokenID,
+      const FieldT &delta,
+      const TxValue<FieldT> &weight = TxValue<FieldT>())
+    {
+        ExchangeBalance &balance = getBalance(account, tokenID);
+        const FieldT rootBefore = account.balancesTree.getRoot();
+        const BalanceLeaf before = balance.getLeaf();
+
+        balance.balance += delta;
+        balance.weightAMM = weight.getOr(balance.weightAMM);
+
+        return finishBalanceUpdate(account, tokenID, rootBefore, before);
+    }
+
+    BalanceUpdate updateBalanceAndStorage(
+      ExchangeAccount &account,
+      unsigned long tokenID,
+      const FieldT &storageID,
+      const FieldT &data,
+      const FieldT &delta,
+      const TxValue<FieldT> &weight,
+      StorageUpdate &storageUpdate)
+    {
+        ExchangeBalance &balance = getBalance(account, tokenID);
+        const FieldT rootBefore = account.balancesTree.getRoot();
+        const BalanceLeaf before = balance.getLeaf();
+
+        storageUpdate = updateStorage(balance, storageID, data);
+        balance.balance += delta;
+        balance.weightAMM = weight.getOr(balance.weightAMM);
+        // The NFT data is cleared when all NFTs are gone
+        if (tokenID >= NFT_TOKEN_ID_START && balance.balance == FieldT::zero())
+        {
+            balance.weightAMM = FieldT::zero();
+        }
+
+        return finishBalanceUpdate(account, tokenID, rootBefore, before);
+    }
+
+    // Writes the current leaf of the account to the accounts tree
+    AccountUpdate updateAccount(unsigned long accountID, const AccountLeaf &before)
+    {
+        // The account needs to be loaded for the proof
+        const ExchangeAccount &account = getAccount(accountID);
+
+        AccountUpdate update;
+        update.accountID = FieldT(accountID);
+        update.rootBefore = accountsTree.getRoot();
+        update.before = before;
+        update.proof = accountsTree.createProof(accountID);
+
+        update.after = account.getLeaf();
+        accountsTree.update(accountID, hashAccountLeaf(update.after));
+        changedAccounts.insert(accountID);
+        update.rootAfter = accountsTree.getRoot();
+        return update;
+    }
+
+    // Loads a state saved by operator/state.py. The trees are rebuilt from the
+    // leaves.
+    void load(const json &jState)
+    {
+        SparseMerkleTree::Leaves accountLeaves;
+        const json &jAccounts = jState.at("accounts_values");
+        for (auto itAccount = jAccounts.begin(); itAccount != jAccounts.end(); ++itAccount)
+        {
+            const unsigned long accountID = std::stoul(itAccount.key());
+            const json &jAccount = itAccount.value();
+            ExchangeAccount &account = getAccount(accountID);
+            account.owner = getField(jAccount, "owner");
+            account.publicKey.x = getField(jAccount, "publicKeyX");
+            account.publicKey.y = getField(jAccount, "publicKeyY");
+            account.nonce = getField(jAccount, "nonce");
+            account.feeBipsAMM = getField(jAccount, "feeBipsAMM");
+
+            SparseMerkleTree::Leaves balanceLeaves;
+            const json &jBalances = jAccount.at("_balancesLeafs");
+            for (auto itBalance = jBalances.begin(); itBalance != jBalances.end(); ++itBalance)
+            {
+                const unsigned long tokenID = std::stoul(itBalance.key());
+                const json &jBalance = itBalance.value();
+                ExchangeBalance &balance = getBalance(account, tokenID);
+                balance.balance = getField(jBalance, "balance");
+                balance.weightAMM = getField(jBalance, "weightAMM");
+
+                SparseMerkleTree::Leaves storageLeaves;
+                const json &jStorage = jBalance.at("_storageLeafs");
+                for (auto itStorage = jStorage.begin(); itStorage != jStorage.end(); ++itStorage)
+                {
+                    const unsigned long address = std::stoul(itStorage.key());
+                    StorageLeaf leaf;
+                    leaf.data = getField(itStorage.value(), "data");
+                    leaf.storageID = getField(itStorage.value(), "storageID");
+                    balance.storage[address] = leaf;
+                    balance.changedStorage.insert(address);
+                    storageLeaves.emplace_back(address, hashStorageLeaf(leaf));
+                }
+                balance.storageTree.update(storageLeaves);
+                balanceLeaves.emplace_back(tokenID, hashBalanceLeaf(balance.getLeaf()));
+                account.changedBalances.insert(tokenID);
+            }
+            account.balancesTree.update(balanceLeaves);
+            accountLeaves.emplace_back(accountID, hashAccountLeaf(account.getLeaf()));
+            changedAccounts.insert(accountID);
+        }
+        accountsTree.update(accountLeaves);
+    }
+
+    // Saves the state in the format read by load (only the accounts in memory
+    // when a source is used)
+    json save() const
+    {
+        json jAccounts = json::object();
+        for (const auto &itAccount : accounts)
+        {
+            const ExchangeAccount &account = itAccount.second;
+            json jBalances = json::object();
+            for (const auto &itBalance : account.balances)
+            {
+                const ExchangeBalance &balance = itBalance.second;
+                json jStorage = json::object();
+                for (const auto &itStorage : balance.storage)
+                {
+                    json jLeaf;
+                    jLeaf["data"] = toDecimalString(itStorage.second.data);
+                    jLeaf["storageID"] = toDecimalString(itStorage.second.storageID);
+                    jStorage[std::to_string(itStorage.first)] = jLeaf;
+                }
+                json jBalance;
+                jBalance["balance"] = toDecimalString(balance.balance);
+                jBalance["weightAMM"] = toDecimalString(balance.weightAMM);
+                jBalance["_storageLeafs"] = jStorage;
+                jBalances[std::to_string(itBalance.first)] = jBalance;
+            }
+            json jAccount;
+            jAccount["owner"] = toDecimalString(account.owner);
+            jAccount["publicKeyX"] = toDecimalString(account.publicKey.x);
+            jAccount["publicKeyY"] = toDecimalString(account.publicKey.y);
+            jAccount["nonce"] = toDecimalString(account.nonce);
+            jAccount["feeBipsAMM"] = toDecimalString(account.feeBipsAMM);
+            jAccount["_balancesLeafs"] = jBalances;
+            jAccounts[std::to_string(itAccount.first)] = jAccount;
+        }
+        json jState;
+        jState["accounts_values"] = jAccounts;
+        return jState;
+    }
+
+  private:
+    // Copied for every new balance and account
+    ExchangeBalance emptyBalance;
+    ExchangeAccount emptyAccount;
+
+    SparseMerkleTree accountsTree;
+    std::unordered_map<unsigned long, ExchangeAccount> accounts;
+    std::unordered_set<unsigned long> changedAccounts;
+
+    const StateSource *source;
+    // The accounts read from the source (sorted for isLoaded)
+    std::set<unsigned long> loadedAccounts;
+
+    BalanceUpdate finishBalanceUpdate(
+      ExchangeAccount &account,
+      unsigned long tokenID,
+      const FieldT &rootBefore,
+      const BalanceLeaf &before)
+    {
+        BalanceUpdate update;
+        update.tokenID = FieldT(tokenID);
+        update.rootBefore = rootBefore;
+        update.before = before;
+        update.proof = account.balancesTree.createProof(tokenID);
+
+        update.after = findBalance(account, tokenID).getLeaf();
+        account.balancesTree.update(tokenID, hashBalanceLeaf(update.after));
+        account.changedBalances.insert(tokenID);
+        update.rootAfter = account.balancesTree.getRoot();
+        return update;
+    }
+};
+
+struct BlockContext
+{
+    unsigned long operatorAccountID;
+    long long protocolTakerFeeBips;
+    long long protocolMakerFeeBips;
+    unsigned int numConditionalTransactions;
+};
+
+// The changes a transaction makes to accounts A and B, the operator and the
+// protocol fee pool (the TXV_* values in operator/state.py). Values that are
+// not set by the transaction keep the current value in the state.
+struct TransactionValues
+{
+    TxValue<Signature> signatureA;
+    TxValue<Signature> signatureB;
+
+    unsigned long accountID_A = 1;
+    TxValue<FieldT> owner_A;
+    TxValue<FieldT> publicKeyX_A;
+    TxValue<FieldT> publicKeyY_A;
+    FieldT nonce_A = FieldT::zero();
+    TxValue<FieldT> feeBipsAMM_A;
+    unsigned long tokenS_A = 0;
+    FieldT balanceS_A = FieldT::zero();
+    TxValue<FieldT> weightS_A;
+    unsigned long tokenB_A = 0;
+    FieldT balanceB_A = FieldT::zero();
+    TxValue<FieldT> weightB_A;
+    FieldT storageAddress_A = FieldT::zero();
+    TxValue<FieldT> storageData_A;
+    TxValue<FieldT> storageID_A;
+
+    unsigned long accountID_B = 1;
+    TxValue<FieldT> owner_B;
+    TxValue<FieldT> publicKeyX_B;
+    TxValue<FieldT> publicKeyY_B;
+    FieldT nonce_B = FieldT::zero();
+    unsigned long tokenS_B = 0;
+    FieldT balanceS_B = FieldT::zero();
+    TxValue<FieldT> weightS_B;
+    unsigned long tokenB_B = 0;
+    FieldT balanceB_B = FieldT::zero();
+    TxValue<FieldT> weightB_B;
+    FieldT storageAddress_B = FieldT::zero();
+    TxValue<FieldT> storageData_B;
+    TxValue<FieldT> storageID_B;
+
+    FieldT balanceDeltaA_O = FieldT::zero();
+    FieldT balanceDeltaB_O = FieldT::zero();
+
+    FieldT balanceDeltaA_P = FieldT::zero();
+    FieldT balanceDeltaB_P = FieldT::zero();
+};
+
+// Parsers for the transactions in the block input (operator/create_block.py)
+
+static void parseSignature(const json &j, const char *key, TxValue<Signature> &signature)
+{
+    if (j.contains(key) && !j.at(key).is_null())
+    {
+        signature = j.at(key).get<Signature>();
+    }
+}
+
+static Order parseOrder(const json &j)
+{
+    Order order;
+    order.storageID = getField(j, "storageID");
+    order.accountID = getField(j, "accountID");
+    order.tokenS = getField(j, "tokenIdS");
+    order.tokenB = getField(j, "tokenIdB");
+    order.amountS = getField(j, "amountS");
+    order.amountB = getField(j, "amountB");
+    order.validUntil = getField(j, "validUntil");
+    order.maxFeeBips = getField(j, "maxFeeBips");
+    order.fillAmountBorS = getField(j, "fillAmountBorS");
+    order.taker = getField(j, "taker");
+    order.nftDataB = getField(j, "nftDataB");
+    order.feeBips = getField(j, "feeBips");
+    order.amm = getField(j, "amm");
+    return order;
+}
+
+static Transfer parseTransfer(const json &j)
+{
+    Transfer transfer;
+    transfer.fromAccountID = getField(j, "fromAccountID");
+    transfer.toAccountID = getField(j, "toAccountID");
+    transfer.tokenID = getField(j, "tokenID");
+    transfer.amount = getField(j, "amount");
+    transfer.feeTokenID = getField(j, "feeTokenID");
+    transfer.fee = getField(j, "fee");
+    transfer.validUntil = getField(j, "validUntil");
+    transfer.to = getField(j, "to");
+    transfer.dualAuthorX = getField(j, "dualAuthorX");
+    transfer.dualAuthorY = getField(j, "dualAuthorY");
+    transfer.storageID = getField(j, "storageID");
+    transfer.payerToAccountID = getField(j, "payerToAccountID");
+    transfer.payerTo = getField(j, "payerTo");
+    transfer.payeeToAccountID = getField(j, "payeeToAccountID");
+    transfer.maxFee = getField(j, "maxFee");
+    transfer.putAddressesInDA = getField(j, "putAddressesInDA");
+    transfer.type = getField(j, "type");
+    transfer.toTokenID = getField(j, "toTokenID");
+    return transfer;
+}
+
+static Withdrawal parseWithdrawal(const json &j)
+{
+    Withdrawal withdrawal;
+    withdrawal.accountID = getField(j, "accountID");
+    withdrawal.tokenID = getField(j, "tokenID");
+    withdrawal.amount = getField(j, "amount");
+    withdrawal.feeTokenID = getField(j, "feeTokenID");
+    withdrawal.fee = getField(j, "fee");
+    withdrawal.onchainDataHash = getField(j, "onchainDataHash");
+    withdrawal.storageID = getField(j, "storageID");
+    withdrawal.validUntil = getField(j, "validUntil");
+    withdrawal.maxFee = getField(j, "maxFee");
+    withdrawal.type = getField(j, "type");
+    return withdrawal;
+}
+
+static Deposit parseDeposit(const json &j)
+{
+    Deposit deposit;
+    deposit.owner = getField(j, "owner");
+    deposit.accountID = getField(j, "accountID");
+    deposit.tokenID = getField(j, "tokenID");
+    deposit.amount = getField(j, "amount");
+    return deposit;
+}
+
+static AccountUpdateTx parseAccountUpdate(const json &j)
+{
+    AccountUpdateTx update;
+    update.owner = getField(j, "owner");
+    update.accountID = getField(j, "accountID");
+    update.publicKeyX = getField(j, "publicKeyX");
+    update.publicKeyY = getField(j, "publicKeyY");
+    update.feeTokenID = getField(j, "feeTokenID");
+    update.fee = getField(j, "fee");
+    update.maxFee = getField(j, "maxFee");
+    update.validUntil = getField(j, "validUntil");
+    update.type = getField(j, "type");
+    return update;
+}
+
+static AmmUpdate parseAmmUpdate(const json &j)
+{
+    AmmUpdate update;
+    update.accountID = getField(j, "accountID");
+    update.tokenID = getField(j, "tokenID");
+    update.feeBips = getField(j, "feeBips");
+    update.tokenWeight = getField(j, "tokenWeight");
+    return update;
+}
+
+static SignatureVerification parseSignatureVerification(const json &j)
+{
+    SignatureVerification verification;
+    verification.accountID = getField(j, "accountID");
+    verification.data = getField(j, "data");
+    return verification;
+}
+
+static NftMint parseNftMint(const json &j)
+{
+    NftMint nftMint;
+    nftMint.minterAccountID = getField(j, "minterAccountID");
+    nftMint.tokenAccountID = getField(j, "tokenAccountID");
+    nftMint.amount = getField(j, "amount");
+    nftMint.feeTokenID = getField(j, "feeTokenID");
+    nftMint.fee = getField(j, "fee");
+    nftMint.validUntil = getField(j, "validUntil");
+    nftMint.maxFee = getField(j, "maxFee");
+    nftMint.type = getField(j, "type");
+    nftMint.nftType = getField(j, "nftType");
+    nftMint.tokenAddress = getField(j, "tokenAddress");
+    nftMint.nftIDHi = getField(j, "nftIDHi");
+    nftMint.nftIDLo = getField(j, "nftIDLo");
+    nftMint.creatorFeeBips = getField(j, "creatorFeeBips");
+    nftMint.toAccountID = getField(j, "toAccountID");
+    nftMint.toTokenID = getField(j, "toTokenID");
+    nftMint.to = getField(j, "to");
+    nftMint.storageID = getField(j, "storageID");
+    return nftMint;
+}
+
+static NftData parseNftData(const json &j)
+{
+    NftData nftData;
+    nftData.type = getField(j, "type");
+    nftData.accountID = getField(j, "accountID");
+    nftData.tokenID = getField(j, "tokenID");
+    nftData.minter = getField(j, "minter");
+    nftData.nftType = getField(j, "nftType");
+    nftData.tokenAddress = getField(j, "tokenAddress");
+    nftData.nftIDHi = getField(j, "nftIDHi");
+    nftData.nftIDLo = getField(j, "nftIDLo");
+    nftData.creatorFeeBips = getField(j, "creatorFeeBips");
+    return nftData;
+}
+
+// Order matching, the same as operator/state.py
+
+struct Fill
+{
+    BigInt S;
+    BigInt B;
+};
+
+// The amount already filled in the trade history of the order
+static BigInt getFilled(ExchangeState &state, const Order &order)
+{
+    const ExchangeAccount &account = state.getAccount(order.accountID.as_ulong());
+    const unsigned long address = getStorageAddress(order.storageID);
+    const StorageLeaf storage = state.findBalance(account, order.tokenS.as_ulong()).getStorage(address);
+    // Storage trimming
+    const FieldT leafStorageID = (storage.storageID != FieldT::zero()) ? storage.storageID : FieldT(address);
+    return (order.storageID == leafStorageID) ? toBigInt(storage.data) : BigInt(0);
+}
+
+static Fill getMaxFill(ExchangeState &state, const Order &order, const BigInt &filled)
+{
+    const ExchangeAccount &account = state.getAccount(order.accountID.as_ulong());
+    const BigInt balanceS = toBigInt(state.findBalance(account, order.tokenS.as_ulong()).balance);
+    const BigInt amountS = toBigInt(order.amountS);
+    const BigInt amountB = toBigInt(order.amountB);
+
+    const bool limitOnB = order.fillAmountBorS == FieldT::one();
+    const BigInt limit = limitOnB ? amountB : amountS;
+    const BigInt filledLimited = (limit < filled) ? limit : filled;
+    const BigInt remaining = limit - filledLimited;
+    const BigInt remainingS = limitOnB ? mulDiv(remaining, amountS, amountB) : remaining;
+
+    Fill fill;
+    fill.S = (balanceS < remainingS) ? balanceS : remainingS;
+    fill.B = mulDiv(fill.S, amountB, amountS);
+    return fill;
+}
+
+static void matchOrders(const Order &takerOrder, Fill &takerFill, const Order &makerOrder, Fill &makerFill)
+{
+    if (takerFill.B < makerFill.S)
+    {
+        makerFill.S = takerFill.B;
+        makerFill.B = mulDiv(takerFill.B, toBigInt(makerOrder.amountB), toBigInt(makerOrder.amountS));
+    }
+    else
+    {
+        takerFill.S = mulDiv(makerFill.S, toBigInt(takerOrder.amountS), toBigInt(takerOrder.amountB));
+        takerFill.B = makerFill.S;
+    }
+}
+
+static void calculateFees(
+  const BigInt &amount,
+  long long feeBips,
+  long long protocolFeeBips,
+  BigInt &fee,
+  BigInt &protocolFee)
+{
+    protocolFee = (amount * protocolFeeBips) / 100000;
+    fee = (amount * feeBips) / 10000;
+}
+
+// The transactions, the same as State.executeTransaction in operator/state.py
+
+static bool executeSpotTrade(
+  ExchangeState &state,
+  const BlockContext &context,
+  const json &input,
+  SpotTrade &spotTrade,
+  TransactionValues &values)
+{
+    spotTrade.orderA = parseOrder(input.at("orderA"));
+    spotTrade.orderB = parseOrder(input.at("orderB"));
+    const Order &orderA = spotTrade.orderA;
+    const Order &orderB = spotTrade.orderB;
+    if (
+      orderA.amountS == FieldT::zero() || orderA.amountB == FieldT::zero() || orderB.amountS == FieldT::zero() ||
+      orderB.amountB == FieldT::zero())
+    {
+        LOG_ERROR("Order amount is zero");
+        return false;
+    }
+
+    // Amount filled in the trade history
+    const BigInt filled_A = getFilled(state, orderA);
+    const BigInt filled_B = getFilled(state, orderB);
+
+    // Simple matching logic
+    Fill fillA = getMaxFill(state, orderA, filled_A);
+    Fill fillB = getMaxFill(state, orderB, filled_B);
+    if (orderA.fillAmountBorS == FieldT::one())
+    {
+        matchOrders(orderA, fillA, orderB, fillB);
+        fillA.S = fillB.B;
+    }
+    else
+    {
+        matchOrders(orderB, fillB, orderA, fillA);
+        fillA.B = fillB.S;
+    }
+
+    // Round the fills to the float values stored in the transaction
+    const unsigned int fFillS_A = toFloat(fillA.S, Float24Encoding);
+    const unsigned int fFillS_B = toFloat(fillB.S, Float24Encoding);
+    spotTrade.fillS_A = FieldT(fFillS_A);
+    spotTrade.fillS_B = FieldT(fFillS_B);
+    fillA.S = fromFloat(fFillS_A, Float24Encoding);
+    fillB.S = fromFloat(fFillS_B, Float24Encoding);
+    fillA.B = fillB.S;
+    fillB.B = fillA.S;
+
+    const unsigned long tokenS_A = orderA.tokenS.as_ulong();
+    const unsigned long tokenB_A = orderA.tokenB.as_ulong();
+    const unsigned long tokenS_B = orderB.tokenS.as_ulong();
+    const unsigned long tokenB_B = orderB.tokenB.as_ulong();
+
+    // The fees are paid in tokenS when buying an NFT
+    const bool allNft = tokenS_A >= NFT_TOKEN_ID_START && tokenS_B >= NFT_TOKEN_ID_START;
+    const long long protocolTakerFeeBips = allNft ? 0 : context.protocolTakerFeeBips;
+    const long long protocolMakerFeeBips = allNft ? 0 : context.protocolMakerFeeBips;
+    const bool nftB_A = tokenB_A >= NFT_TOKEN_ID_START;
+    const bool nftB_B = tokenB_B >= NFT_TOKEN_ID_START;
+    const long long feeBips_A = orderA.feeBips.as_ulong();
+    const long long feeBips_B = orderB.feeBips.as_ulong();
+
+    BigInt fee_SA, protocolFee_SA, fee_BA, protocolFee_BA;
+    BigInt fee_SB, protocolFee_SB, fee_BB, protocolFee_BB;
+    calculateFees(fillA.S, nftB_A ? feeBips_A : 0, nftB_A ? protocolTakerFeeBips : 0, fee_SA, protocolFee_SA);
+    calculateFees(fillA.B, nftB_A ? 0 : feeBips_A, nftB_A ? 0 : protocolTakerFeeBips, fee_BA, protocolFee_BA);
+    calculateFees(fillB.S, nftB_B ? feeBips_B : 0, nftB_B ? protocolMakerFeeBips : 0, fee_SB, protocolFee_SB);
+    calculateFees(fillB.B, nftB_B ? 0 : feeBips_B, nftB_B ? 0 : protocolMakerFeeBips, fee_BB, protocolFee_BB);
+
+    parseSignature(input.at("orderA"), "signature", values.signatureA);
+    parseSignature(input.at("orderB"), "signature", values.signatureB);
+
+    values.accountID_A = orderA.accountID.as_ulong();
+    const ExchangeAccount &accountA = state.getAccount(values.accountID_A);
+
+    values.tokenS_A = tokenS_A;
+    values.balanceS_A = -fromBigInt(fillA.S + fee_SA);
+    if (orderA.amm == FieldT::one())
+    {
+        values.weightS_A = state.findBalance(accountA, tokenS_A).weightAMM - fromBigInt(fillA.S);
+    }
+
+    values.tokenB_A = tokenB_A;
+    values.balanceB_A = fromBigInt(fillA.B) - fromBigInt(fee_BA);
+    if (orderA.amm == FieldT::one())
+    {
+        values.weightB_A = state.findBalance(accountA, tokenB_A).weightAMM + fromBigInt(fillA.B);
+    }
+
+    values.storageAddress_A = orderA.storageID;
+    values.storageData_A = fromBigInt(filled_A + (orderA.fillAmountBorS == FieldT::one() ? fillA.B : fillA.S));
+    values.storageID_A = orderA.storageID;
+
+    values.accountID_B = orderB.accountID.as_ulong();
+    const ExchangeAccount &accountB = state.getAccount(values.accountID_B);
+
+    values.tokenS_B = tokenS_B;
+    values.balanceS_B = -fromBigInt(fillB.S + fee_SB);
+    if (orderB.amm == FieldT::one())
+    {
+        values.weightS_B = state.findBalance(accountB, tokenS_B).weightAMM - fromBigInt(fillB.S);
+    }
+
+    values.tokenB_B = tokenB_B;
+    values.balanceB_B = fromBigInt(fillB.B) - fromBigInt(fee_BB);
+    if (orderB.amm == FieldT::one())
+    {
+        values.weightB_B = state.findBalance(accountB, tokenB_B).weightAMM + fromBigInt(fillB.B);
+    }
+
+    values.storageAddress_B = orderB.storageID;
+    values.storageData_B = fromBigInt(filled_B + (orderB.fillAmountBorS == FieldT::one() ? fillB.B : fillB.S));
+    values.storageID_B = orderB.storageID;
+
+    // The NFT data moves with the NFT
+    if (tokenS_A >= NFT_TOKEN_ID_START)
+    {
+        values.weightB_B = state.findBalance(accountA, tokenS_A).weightAMM;
+    }
+    if (tokenS_B >= NFT_TOKEN_ID_START)
+    {
+        values.weightB_A = state.findBalance(accountB, tokenS_B).weightAMM;
+    }
+
+    values.balanceDeltaA_O = fromBigInt(fee_BA + fee_SB) - fromBigInt(protocolFee_BA + protocolFee_SB);
+    values.balanceDeltaB_O = fromBigInt(fee_BB + fee_SA) - fromBigInt(protocolFee_BB + protocolFee_SA);
+
+    values.balanceDeltaA_P = fromBigInt(protocolFee_BA + protocolFee_SB);
+    values.balanceDeltaB_P = fromBigInt(protocolFee_BB + protocolFee_SA);
+    return true;
+}
+
+static void executeTransfer(
+  ExchangeState &state,
+  BlockContext &context,
+  const json &input,
+  Transfer &transfer,
+  TransactionValues &values)
+{
+    transfer = parseTransfer(input);
+    const FieldT amount = roundToFloatValue(transfer.amount, Float24Encoding);
+    const FieldT fee = roundToFloatValue(transfer.fee, Float16Encoding);
+
+    parseSignature(input, "signature", values.signatureA);
+    parseSignature(input, "dualSignature", values.signatureB);
+
+    values.accountID_A = transfer.fromAccountID.as_ulong();
+    const ExchangeAccount &accountA = state.getAccount(values.accountID_A);
+
+    values.tokenS_A = transfer.tokenID.as_ulong();
+    values.balanceS_A = -amount;
+
+    values.tokenB_A = transfer.feeTokenID.as_ulong();
+    values.balanceB_A = -fee;
+
+    values.accountID_B = transfer.toAccountID.as_ulong();
+    values.owner_B = transfer.to;
+
+    values.tokenB_B = transfer.toTokenID.as_ulong();
+    values.balanceB_B = amount;
+
+    if (values.tokenS_A >= NFT_TOKEN_ID_START)
+    {
+        values.weightB_B = state.findBalance(accountA, values.tokenS_A).weightAMM;
+    }
+
+    values.storageAddress_A = transfer.storageID;
+    values.storageData_A = FieldT::one();
+    values.storageID_A = transfer.storageID;
+
+    if (transfer.type != FieldT::zero())
+    {
+        context.numConditionalTransactions++;
+    }
+
+    values.balanceDeltaA_O = fee;
+}
+
+static void executeWithdrawal(
+  ExchangeState &state,
+  BlockContext &context,
+  const json &input,
+  Withdrawal &withdrawal,
+  TransactionValues &values)
+{
+    withdrawal = parseWithdrawal(input);
+    const unsigned long type = withdrawal.type.as_ulong();
+    const unsigned long accountID = withdrawal.accountID.as_ulong();
+    const unsigned long tokenID = withdrawal.tokenID.as_ulong();
+
+    // Calculate how much can be withdrawn
+    if (type == 2)
+    {
+        withdrawal.amount = state.findBalance(state.getAccount(accountID), tokenID).balance;
+    }
+    else if (type == 3)
+    {
+        withdrawal.amount = FieldT::zero();
+    }
+
+    // Protocol fee withdrawals are withdrawn from the protocol fee pool, a
+    // dummy account is used as account A
+    const bool isProtocolFeeWithdrawal = accountID == 0;
+    const FieldT fee = roundToFloatValue(withdrawal.fee, Float16Encoding);
+
+    parseSignature(input, "signature", values.signatureA);
+
+    values.accountID_A = isProtocolFeeWithdrawal ? 1 : accountID;
+
+    values.tokenS_A = tokenID;
+    values.balanceS_A = isProtocolFeeWithdrawal ? FieldT::zero() : -withdrawal.amount;
+
+    values.tokenB_A = withdrawal.feeTokenID.as_ulong();
+    values.balanceB_A = -fee;
+
+    values.tokenB_B = tokenID;
+
+    values.storageAddress_A = withdrawal.storageID;
+    if (type == 0 || type == 1)
+    {
+        values.storageData_A = FieldT::one();
+        values.storageID_A = withdrawal.storageID;
+    }
+    if (!isProtocolFeeWithdrawal && type == 2)
+    {
+        values.weightS_A = FieldT::zero();
+    }
+
+    values.balanceDeltaA_O = fee;
+
+    values.balanceDeltaB_P = isProtocolFeeWithdrawal ? -withdrawal.amount : FieldT::zero();
+
+    context.numConditionalTransactions++;
+}
+
+static void executeDeposit(BlockContext &context, const json &input, Deposit &deposit, TransactionValues &values)
+{
+    deposit = parseDeposit(input);
+
+    values.accountID_A = deposit.accountID.as_ulong();
+    values.owner_A = deposit.owner;
+
+    values.tokenS_A = deposit.tokenID.as_ulong();
+    values.balanceS_A = deposit.amount;
+
+    context.numConditionalTransactions++;
+}
+
+static void executeAccountUpdate(
+  BlockContext &context,
+  const json &input,
+  AccountUpdateTx &update,
+  TransactionValues &values)
+{
+    update = parseAccountUpdate(input);
+    const FieldT fee = roundToFloatValue(update.fee, Float16Encoding);
+
+    values.accountID_A = update.accountID.as_ulong();
+
+    values.owner_A = update.owner;
+    values.publicKeyX_A = update.publicKeyX;
+    values.publicKeyY_A = update.publicKeyY;
+    values.nonce_A = FieldT::one();
+
+    values.tokenS_A = update.feeTokenID.as_ulong();
+    values.balanceS_A = -fee;
+
+    values.tokenB_A = update.feeTokenID.as_ulong();
+
+    values.balanceDeltaA_O = fee;
+
+    parseSignature(input, "signature", values.signatureA);
+
+    if (update.type != FieldT::zero())
+    {
+        context.numConditionalTransactions++;
+    }
+}
+
+static void executeAmmUpdate(BlockContext &context, const json &input, AmmUpdate &update, TransactionValues &values)
+{
+    update = parseAmmUpdate(input);
+
+    values.accountID_A = update.accountID.as_ulong();
+    values.tokenS_A = update.tokenID.as_ulong();
+
+    values.nonce_A = FieldT::one();
+    values.feeBipsAMM_A = update.feeBips;
+
+    values.weightS_A = update.tokenWeight;
+
+    context.numConditionalTransactions++;
+}
+
+static void executeSignatureVerification(
+  const json &input,
+  SignatureVerification &verification,
+  TransactionValues &values)
+{
+    verification = parseSignatureVerification(input);
+
+    values.accountID_A = verification.accountID.as_ulong();
+    parseSignature(input, "signature", values.signatureA);
+}
+
+static void executeNftMint(BlockContext &context, const json &input, NftMint &nftMint, TransactionValues &values)
+{
+    nftMint = parseNftMint(input);
+    const FieldT nftData = getField(input, "nftData");
+    const unsigned long type = nftMint.type.as_ulong();
+    const FieldT fee = roundToFloatValue(nftMint.fee, Float16Encoding);
+
+    parseSignature(input, "signature", values.signatureA);
+
+    values.accountID_A = nftMint.minterAccountID.as_ulong();
+    values.tokenS_A = nftMint.feeTokenID.as_ulong();
+    values.balanceS_A = -fee;
+
+    values.tokenB_B = nftMint.feeTokenID.as_ulong();
+
+    values.tokenB_A = nftMint.toTokenID.as_ulong();
+    values.tokenS_B = nftMint.toTokenID.as_ulong();
+
+    if (type == 0)
+    {
+        values.accountID_B = nftMint.tokenAccountID.as_ulong();
+
+        values.balanceB_A = nftMint.amount;
+        values.weightB_A = nftData;
+    }
+    else
+    {
+        values.accountID_B = nftMint.toAccountID.as_ulong();
+        values.owner_B = nftMint.to;
+
+        values.balanceS_B = nftMint.amount;
+        values.weightS_B = nftData;
+    }
+
+    if (type != 2)
+    {
+        values.storageAddress_A = nftMint.storageID;
+        values.storageData_A = FieldT::one();
+        values.storageID_A = nftMint.storageID;
+    }
+
+    if (type != 0)
+    {
+        context.numConditionalTransactions++;
+    }
+
+    values.balanceDeltaB_O = fee;
+}
+
+static void executeNftData(const json &input, NftData &nftData, TransactionValues &values)
+{
+    nftData = parseNftData(input);
+
+    values.accountID_A = nftData.accountID.as_ulong();
+    values.tokenS_A = nftData.tokenID.as_ulong();
+}
+
+// Applies the changes of a transaction to the state
+static Witness applyTransactionValues(
+  ExchangeState &state,
+  const BlockContext &context,
+  const TransactionValues &values)
+{
+    static const Signature defaultSignature = dummySignature.get<Signature>();
+    Witness witness;
+
+    // Update A
+    ExchangeAccount &accountA = state.getAccount(values.accountID_A);
+    const AccountLeaf accountBefore_A = accountA.getLeaf();
+    const StorageLeaf storage_A =
+      state.findBalance(accountA, values.tokenS_A).getStorage(getStorageAddress(values.storageAddress_A));
+    witness.balanceUpdateS_A = state.updateBalanceAndStorage(
+      accountA,
+      values.tokenS_A,
+      values.storageID_A.getOr(storage_A.storageID),
+      values.storageData_A.getOr(storage_A.data),
+      values.balanceS_A,
+      values.weightS_A,
+      witness.storageUpdate_A);
+    witness.balanceUpdateB_A = state.updateBalance(accountA, values.tokenB_A, values.balanceB_A, values.weightB_A);
+    accountA.owner = values.owner_A.getOr(accountA.owner);
+    accountA.publicKey.x = values.publicKeyX_A.getOr(accountA.publicKey.x);
+    accountA.publicKey.y = values.publicKeyY_A.getOr(accountA.publicKey.y);
+    accountA.nonce += values.nonce_A;
+    accountA.feeBipsAMM = values.feeBipsAMM_A.getOr(accountA.feeBipsAMM);
+    witness.accountUpdate_A = state.updateAccount(values.accountID_A, accountBefore_A);
+
+    // Update B (the defaults are read after A was updated)
+    ExchangeAccount &accountB = state.getAccount(values.accountID_B);
+    const AccountLeaf accountBefore_B = accountB.getLeaf();
+    const StorageLeaf storage_B =
+      state.findBalance(accountB, values.tokenS_B).getStorage(getStorageAddress(values.storageAddress_B));
+    witness.balanceUpdateS_B = state.updateBalanceAndStorage(
+      accountB,
+      values.tokenS_B,
+      values.storageID_B.getOr(storage_B.storageID),
+      values.storageData_B.getOr(storage_B.data),
+      values.balanceS_B,
+      values.weightS_B,
+      witness.storageUpdate_B);
+    witness.balanceUpdateB_B = state.updateBalance(accountB, values.tokenB_B, values.balanceB_B, values.weightB_B);
+    accountB.owner = values.owner_B.getOr(accountB.owner);
+    accountB.publicKey.x = values.publicKeyX_B.getOr(accountB.publicKey.x);
+    accountB.publicKey.y = values.publicKeyY_B.getOr(accountB.publicKey.y);
+    accountB.nonce += values.nonce_B;
+    witness.accountUpdate_B = state.updateAccount(values.accountID_B, accountBefore_B);
+
+    // Update the balances of the operator
+    ExchangeAccount &accountO = state.getAccount(context.operatorAccountID);
+    const AccountLeaf accountBefore_O = accountO.getLeaf();
+    witness.balanceUpdateB_O = state.updateBalance(accountO, values.tokenB_B, values.balanceDeltaB_O);
+    witness.balanceUpdateA_O = state.updateBalance(accountO, values.tokenB_A, values.balanceDeltaA_O);
+    witness.accountUpdate_O = state.updateAccount(context.operatorAccountID, accountBefore_O);
+
+    // Protocol fee payment, the account itself is only updated at the end of
+    // the block
+    ExchangeAccount &accountP = state.getAccount(0);
+    witness.balanceUpdateB_P = state.updateBalance(accountP, values.tokenB_B, values.balanceDeltaB_P);
+    witness.balanceUpdateA_P = state.updateBalance(accountP, values.tokenB_A, values.balanceDeltaA_P);
+
+    witness.signatureA = values.signatureA.getOr(defaultSignature);
+    witness.signatureB = values.signatureB.getOr(witness.signatureA);
+    witness.numConditionalTransactionsAfter = FieldT(context.numConditionalTransactions);
+    return witness;
+}
+
+// Executes a transaction of the block input on the state
+static bool executeTransaction(
+  ExchangeState &state,
+  BlockContext &context,
+  const json &input,
+  UniversalTransaction &transaction)
+{
+    const std::string txType = input.at("txType").get<std::string>();
+    TransactionValues values;
+    TransactionType type;
+    if (txType == "Noop")
+    {
+        type = TransactionType::Noop;
+    }
+    else if (txType == "SpotTrade")
+    {
+        type = TransactionType::SpotTrade;
+        if (!executeSpotTrade(state, context, input, transaction.spotTrade, values))
+        {
+            return false;
+        }
+    }
+    else if (txType == "Transfer")
+    {
+        type = TransactionType::Transfer;
+        executeTransfer(state, context, input, transaction.transfer, values);
+    }
+    else if (txType == "Withdraw")
+    {
+        type = TransactionType::Withdrawal;
+        executeWithdrawal(state, context, input, transaction.withdraw, values);
+    }
+    else if (txType == "Deposit")
+    {
+        type = TransactionType::Deposit;
+        executeDeposit(context, input, transaction.deposit, values);
+    }
+    else if (txType == "AccountUpdate")
+    {
+        type = TransactionType::AccountUpdate;
+        executeAccountUpdate(context, input, transaction.accountUpdate, values);
+    }
+    else if (txType == "AmmUpdate")
+    {
+        type = TransactionType::AmmUpdate;
+        executeAmmUpdate(context, input, transaction.ammUpdate, values);
+    }
+    else if (txType == "SignatureVerification")
+    {
+        type = TransactionType::SignatureVerification;
+        executeSignatureVerification(input, transaction.signatureVerification, values);
+    }
+    else if (txType == "NftMint")
+    {
+        type = TransactionType::NftMint;
+        executeNftMint(context, input, transaction.nftMint, values);
+    }
+    else if (txType == "NftData")
+    {
+        type = TransactionType::NftData;
+        executeNftData(input, transaction.nftData, values);
+    }
+    else
+    {
+        LOG_ERROR("Unknown transaction type: " << txType);
+        return false;
+    }
+
+    transaction.type = FieldT(int(type));
+    transaction.witness = applyTransactionValues(state, context, values);
+    setDummyTransactions(transaction);
+    return true;
+}
+
+// Builds a block from the block input of operator/create_block.py, the same as
+// createBlock but without the JSON roundtrip through the Python operator. The
+// state is updated to the state after the block. On failure the state can be
+// partially updated.
+static bool buildBlock(ExchangeState &state, const json &input, Block &block)
+{
+    block.exchange = getField(input, "exchange");
+    block.merkleRootBefore = state.getRoot();
+    block.timestamp = getField(input, "timestamp");
+    block.protocolTakerFeeBips = getField(input, "protocolTakerFeeBips");
+    block.protocolMakerFeeBips = getField(input, "protocolMakerFeeBips");
+    block.operatorAccountID = getField(input, "operatorAccountID");
+    block.signature = (input.contains("signature") ? input.at("signature") : dummySignature).get<Signature>();
+
+    BlockContext context;
+    context.operatorAccountID = block.operatorAccountID.as_ulong();
+    context.protocolTakerFeeBips = block.protocolTakerFeeBips.as_ulong();
+    context.protocolMakerFeeBips = block.protocolMakerFeeBips.as_ulong();
+    context.numConditionalTransactions = 0;
+
+    // Protocol fee payment
+    const AccountLeaf accountBefore_P = state.getAccount(0).getLeaf();
+
+    const json &jTransactions = input.at("transactions");
+    block.transactions.clear();
+    block.transactions.resize(jTransactions.size());
+    for (size_t i = 0; i < jTransactions.size(); i++)
+    {
+        if (!executeTransaction(state, context, jTransactions[i], block.transactions[i]))
+        {
+            LOG_ERROR("Could not execute transaction " << i);
+            return false;
+        }
+    }
+
+    // Protocol fees
+    block.accountUpdate_P = state.updateAccount(0, accountBefore_P);
+
+    // Operator
+    ExchangeAccount &accountO = state.getAccount(context.operatorAccountID);
+    const AccountLeaf accountBefore_O = accountO.getLeaf();
+    accountO.nonce += FieldT::one();
+    block.accountUpdate_O = state.updateAccount(context.operatorAccountID, accountBefore_O);
+
+    block.merkleRootAfter = state.getRoot();
+    return true;
+}
+
+} // namespace Loopring
+
+#endif
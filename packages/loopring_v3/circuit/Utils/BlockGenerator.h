@@ -0,0 +1,775 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _BLOCKGENERATOR_H_
+#define _BLOCKGENERATOR_H_
+
+#include "BlockBuilder.h"
+#include "Constants.h"
+#include "Data.h"
+#include "Jubjub.h"
+#include "Log.h"
+#include "Poseidon.h"
+#include "SignatureChecker.h"
+#include "../Circuits/Circuit.h"
+#include "../Gadgets/MathGadgets.h"
+
+#include "ethsnarks.hpp"
+
+#include <cstdint>
+#include <gmp.h>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// EdDSA keys and signatures with the same scheme as EdDSA_Poseidon
+struct EdDSAKeyPair
+{
+    FieldT secretKey;
+    jubjub::EdwardsPoint publicKey;
+};
+
+// A random scalar in [0, JUBJUB_SUBGROUP_ORDER)
+static FieldT getRandomScalar(std::mt19937_64 &rng)
+{
+    mpz_t value, order;
+    mpz_inits(value, order, NULL);
+    mpz_set_str(order, JUBJUB_SUBGROUP_ORDER, 10);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        mpz_mul_2exp(value, value, 64);
+        mpz_add_ui(value, value, rng());
+    }
+    mpz_mod(value, value, order);
+    const FieldT scalar = FieldT(libff::bigint<FieldT::num_limbs>(value));
+    mpz_clears(value, order, NULL);
+    return scalar;
+}
+
+static EdDSAKeyPair createKeyPair(std::mt19937_64 &rng, const jubjub::Params &params)
+{
+    EdDSAKeyPair keyPair;
+    keyPair.secretKey = getRandomScalar(rng);
+    keyPair.publicKey =
+      scalarMul(ExtendedPoint(params.Gx, params.Gy), toScalarBits(keyPair.secretKey), params).toAffine();
+    return keyPair;
+}
+
+// R = B*r, s = r + H(R, A, M)*k, so that B*s == R + A*H(R, A, M)
+static Signature signMessage(
+  const EdDSAKeyPair &keyPair,
+  const FieldT &message,
+  std::mt19937_64 &rng,
+  const jubjub::Params &params)
+{
+    const FieldT r = getRandomScalar(rng);
+    SignatureCheck check;
+    check.publicKey = keyPair.publicKey;
+    check.message = message;
+    check.signature.R = scalarMul(ExtendedPoint(params.Gx, params.Gy), toScalarBits(r), params).toAffine();
+    const FieldT hash = hashSignature(check);
+
+    mpz_t order, s, h, k;
+    mpz_inits(order, s, h, k, NULL);
+    mpz_set_str(order, JUBJUB_SUBGROUP_ORDER, 10);
+    r.as_bigint().to_mpz(s);
+    hash.as_bigint().to_mpz(h);
+    keyPair.secretKey.as_bigint().to_mpz(k);
+    mpz_addmul(s, h, k);
+    mpz_mod(s, s, order);
+    check.signature.s = FieldT(libff::bigint<FieldT::num_limbs>(s));
+    mpz_clears(order, s, h, k, NULL);
+    return check.signature;
+}
+
+// The messages that are signed, the same as the hashes in the circuits
+
+static FieldT getTransferHash(const FieldT &exchange, const Transfer &transfer)
+{
+    return PoseidonNative<Poseidon_12>::hash(
+      {exchange,
+       transfer.fromAccountID,
+       transfer.payerToAccountID,
+       transfer.tokenID,
+       transfer.amount,
+       transfer.feeTokenID,
+       transfer.maxFee,
+       transfer.payerTo,
+       transfer.dualAuthorX,
+       transfer.dualAuthorY,
+       transfer.validUntil,
+       transfer.storageID});
+}
+
+static FieldT getWithdrawalHash(const FieldT &exchange, const Withdrawal &withdrawal)
+{
+    return PoseidonNative<Poseidon_9>::hash(
+      {exchange,
+       withdrawal.accountID,
+       withdrawal.tokenID,
+       withdrawal.amount,
+       withdrawal.feeTokenID,
+       withdrawal.maxFee,
+       withdrawal.onchainDataHash,
+       withdrawal.validUntil,
+       withdrawal.storageID});
+}
+
+static FieldT getAccountUpdateHash(const FieldT &exchange, const AccountUpdateTx &update, const FieldT &nonce)
+{
+    return PoseidonNative<Poseidon_8>::hash(
+      {exchange,
+       update.accountID,
+       update.feeTokenID,
+       update.maxFee,
+       update.publicKeyX,
+       update.publicKeyY,
+       update.validUntil,
+       nonce});
+}
+
+static FieldT getNftData(const NftData &nft)
+{
+    return PoseidonNative<Poseidon_6>::hash(
+      {nft.minter, nft.nftType, nft.tokenAddress, nft.nftIDLo, nft.nftIDHi, nft.creatorFeeBips});
+}
+
+static FieldT getNftMintHash(const FieldT &exchange, const NftMint &nftMint, const FieldT &nftData)
+{
+    return PoseidonNative<Poseidon_9>::hash(
+      {exchange,
+       nftMint.minterAccountID,
+       nftMint.toAccountID,
+       nftData,
+       nftMint.amount,
+       nftMint.feeTokenID,
+       nftMint.maxFee,
+       nftMint.validUntil,
+       nftMint.storageID});
+}
+
+static FieldT getOrderHash(const FieldT &exchange, const Order &order)
+{
+    return PoseidonNative<Poseidon_11>::hash(
+      {exchange,
+       order.storageID,
+       order.accountID,
+       order.tokenS,
+       isNftToken(order.tokenB) ? order.nftDataB : order.tokenB,
+       order.amountS,
+       order.amountB,
+       order.validUntil,
+       order.maxFeeBips,
+       order.fillAmountBorS,
+       order.taker});
+}
+
+static json toJSON(const Signature &signature)
+{
+    json jSignature;
+    jSignature["Rx"] = toDecimalString(signature.R.x);
+    jSignature["Ry"] = toDecimalString(signature.R.y);
+    jSignature["s"] = toDecimalString(signature.s);
+    return jSignature;
+}
+
+static const unsigned int GENERATOR_OPERATOR_ACCOUNT_ID = 1;
+static const unsigned int GENERATOR_VALID_UNTIL = 0xFFFFFFFF;
+static const unsigned int GENERATOR_AMM_FEE_BIPS = 20;
+
+struct BlockGeneratorConfig
+{
+    unsigned int blockSize;
+    uint64_t seed;
+    unsigned int numAccounts;
+    unsigned int numTokens;
+    // The relative number of transactions of each type, by txType (e.g.
+    // {"SpotTrade": 3, "Transfer": 1}). SpotTradeAMM generates a SpotTrade
+    // against the AMM pool.
+    std::map<std::string, double> transactions;
+};
+
+static void from_json(const json &j, BlockGeneratorConfig &config)
+{
+    config.blockSize = j.at("blockSize").get<unsigned int>();
+    config.seed = j.contains("seed") ? j.at("seed").get<uint64_t>() : 0;
+    config.numAccounts = j.contains("numAccounts") ? j.at("numAccounts").get<unsigned int>() : 64;
+    config.numTokens = j.contains("numTokens") ? j.at("numTokens").get<unsigned int>() : 4;
+    config.transactions = j.at("transactions").get<std::map<std::string, double>>();
+}
+
+// Generates valid blocks with random transactions of any size, e.g. to
+// benchmark circuits for which no operator blocks are available. All accounts
+// have an EdDSA key pair and enough balance in every token for all generated
+// transactions, all transactions that need a signature are signed. The same
+// seed generates the same blocks. The first account is an AMM pool with a
+// virtual balance in every token. The operator signature of a block depends on
+// its public data, which is only known in the circuit, so the blocks are signed
+// by the circuit with getBlockSigner.
+// Supported transaction types: Noop, Deposit, Withdraw, Transfer, SpotTrade,
+// SpotTradeAMM, AccountUpdate, AmmUpdate, SignatureVerification, NftMint and
+// NftData.
+class BlockGenerator
+{
+  public:
+    BlockGenerator(const BlockGeneratorConfig &_config)
+        : config(_config), rng(_config.seed), exchange(FieldT::zero()), timestamp(1600000000)
+    {
+    }
+
+    // Creates the accounts on an empty state. Account 0 is the protocol fee
+    // pool, account 1 is the operator.
+    void setupState(ExchangeState &state)
+    {
+        const FieldT initialBalance = FieldT("1000000000000000000000000");
+        const FieldT initialWeight = FieldT("100000000000000000000");
+        accounts.clear();
+        nfts.clear();
+
+        // The operator only needs a key to sign the blocks
+        operatorKeyPair = createKeyPair(rng, params);
+        ExchangeAccount &operatorAccount = state.getAccount(GENERATOR_OPERATOR_ACCOUNT_ID);
+        const AccountLeaf operatorBefore = operatorAccount.getLeaf();
+        operatorAccount.publicKey = operatorKeyPair.publicKey;
+        state.updateAccount(GENERATOR_OPERATOR_ACCOUNT_ID, operatorBefore);
+
+        for (unsigned int i = 0; i < config.numAccounts; i++)
+        {
+            const bool isPool = (i == 0);
+            GeneratedAccount generated;
+            generated.accountID = GENERATOR_OPERATOR_ACCOUNT_ID + 1 + i;
+            generated.owner = FieldT((rng() >> 1) | 1);
+            generated.keyPair = createKeyPair(rng, params);
+            generated.nonce = FieldT::zero();
+            generated.nextStorageID.resize(config.numTokens, 0);
+            generated.nextNftTokenID = NFT_TOKEN_ID_START;
+            generated.feeBipsAMM = isPool ? GENERATOR_AMM_FEE_BIPS : 0;
+            generated.weightsAMM.resize(config.numTokens, isPool ? initialWeight : FieldT::zero());
+
+            ExchangeAccount &account = state.getAccount(generated.accountID);
+            const AccountLeaf before = account.getLeaf();
+            account.owner = generated.owner;
+            account.publicKey = generated.keyPair.publicKey;
+            account.feeBipsAMM = FieldT(generated.feeBipsAMM);
+            for (unsigned int tokenID = 0; tokenID < config.numTokens; tokenID++)
+            {
+                TxValue<FieldT> weight;
+                weight = generated.weightsAMM[tokenID];
+                state.updateBalance(account, tokenID, initialBalance, weight);
+            }
+            state.updateAccount(generated.accountID, before);
+            accounts.push_back(generated);
+        }
+    }
+
+    // Generates the block input for buildBlock. The state needs to be set up
+    // with setupState, blocks need to be built in the order they are
+    // generated.
+    bool generateBlock(json &input)
+    {
+        if (accounts.size() < 2 || config.numTokens < 2)
+        {
+            LOG_ERROR("At least 2 accounts and 2 tokens are needed");
+            return false;
+        }
+        std::vector<std::string> txTypes;
+        std::vector<double> weights;
+        for (const auto &it : config.transactions)
+        {
+            txTypes.push_back(it.first);
+            weights.push_back(it.second);
+        }
+        std::discrete_distribution<size_t> txTypeDistribution(weights.begin(), weights.end());
+
+        json transactions = json::array();
+        for (unsigned int i = 0; i < config.blockSize; i++)
+        {
+            json transaction;
+            if (!generateTransaction(txTypes[txTypeDistribution(rng)], transaction))
+            {
+                return false;
+            }
+            transactions.push_back(transaction);
+        }
+
+        input = json();
+        input["blockType"] = 0;
+        input["blockSize"] = config.blockSize;
+        input["exchange"] = toDecimalString(exchange);
+        input["timestamp"] = timestamp;
+        input["protocolTakerFeeBips"] = 25;
+        input["protocolMakerFeeBips"] = 10;
+        input["operatorAccountID"] = GENERATOR_OPERATOR_ACCOUNT_ID;
+        input["transactions"] = transactions;
+        return true;
+    }
+
+    // Signs the blocks with the key of the operator, see Circuit::setBlockSigner.
+    // The nonce of a signature only depends on the message.
+    BlockSigner getBlockSigner() const
+    {
+        const EdDSAKeyPair keyPair = operatorKeyPair;
+        const uint64_t seed = config.seed;
+        return [keyPair, seed](const FieldT &message) {
+            jubjub::Params params;
+            std::mt19937_64 rng(seed ^ message.as_ulong());
+            return signMessage(keyPair, message, rng, params);
+        };
+    }
+
+    // Changes the transactions of the next blocks, e.g. to first mint NFTs and
+    // then only set their data
+    void setTransactions(const std::map<std::string, double> &transactions)
+    {
+        config.transactions = transactions;
+    }
+
+  private:
+    struct GeneratedAccount
+    {
+        unsigned int accountID;
+        FieldT owner;
+        EdDSAKeyPair keyPair;
+        FieldT nonce;
+        // Storage IDs are never reused
+        std::vector<unsigned long> nextStorageID;
+        // Every NFT is minted in a new token slot
+        unsigned long nextNftTokenID;
+        // The AMM state, only set for the pool
+        unsigned int feeBipsAMM;
+        std::vector<FieldT> weightsAMM;
+    };
+
+    BlockGeneratorConfig config;
+    std::mt19937_64 rng;
+    jubjub::Params params;
+    FieldT exchange;
+    unsigned int timestamp;
+    EdDSAKeyPair operatorKeyPair;
+    std::vector<GeneratedAccount> accounts;
+    // The NFTs minted so far
+    std::vector<NftData> nfts;
+
+    unsigned int getRandom(unsigned int begin, unsigned int end)
+    {
+        return std::uniform_int_distribution<unsigned int>(begin, end - 1)(rng);
+    }
+
+    GeneratedAccount &getRandomAccount()
+    {
+        return accounts[getRandom(0, accounts.size())];
+    }
+
+    GeneratedAccount &getOtherRandomAccount(const GeneratedAccount &account)
+    {
+        const unsigned int offset = getRandom(1, accounts.size());
+        return accounts[(account.accountID - accounts[0].accountID + offset) % accounts.size()];
+    }
+
+    unsigned int getRandomToken()
+    {
+        return getRandom(0, config.numTokens);
+    }
+
+    // mantissa * 10^exponent with an 11 bit mantissa, exactly representable in
+    // all float encodings
+    FieldT getRandomAmount(unsigned int minExponent, unsigned int maxExponent)
+    {
+        const unsigned int mantissa = getRandom(1, 1 << 11);
+        const unsigned int exponent = getRandom(minExponent, maxExponent + 1);
+        return FieldT((std::to_string(mantissa) + std::string(exponent, '0')).c_str());
+    }
+
+    GeneratedAccount &getPool()
+    {
+        return accounts[0];
+    }
+
+    // Rounds down to the same 11 bit mantissa as getRandomAmount
+    static BigInt roundDownAmount(BigInt amount)
+    {
+        BigInt scale = 1;
+        while (amount >= 1 << 11)
+        {
+            amount /= 10;
+            scale *= 10;
+        }
+        return amount * scale;
+    }
+
+    FieldT getNextStorageID(GeneratedAccount &account, unsigned int tokenID)
+    {
+        return FieldT(account.nextStorageID[tokenID]++);
+    }
+
+    bool generateTransaction(const std::string &txType, json &tx)
+    {
+        tx["txType"] = txType;
+        if (txType == "Noop")
+        {
+            return true;
+        }
+        if (txType == "Deposit")
+        {
+            generateDeposit(tx);
+        }
+        else if (txType == "Withdraw")
+        {
+            generateWithdrawal(tx);
+        }
+        else if (txType == "Transfer")
+        {
+            generateTransfer(tx);
+        }
+        else if (txType == "SpotTrade")
+        {
+            generateSpotTrade(tx);
+        }
+        else if (txType == "SpotTradeAMM")
+        {
+            tx["txType"] = "SpotTrade";
+            generateAmmSpotTrade(tx);
+        }
+        else if (txType == "AccountUpdate")
+        {
+            generateAccountUpdate(tx);
+        }
+        else if (txType == "AmmUpdate")
+        {
+            generateAmmUpdate(tx);
+        }
+        else if (txType == "SignatureVerification")
+        {
+            generateSignatureVerification(tx);
+        }
+        else if (txType == "NftMint")
+        {
+            generateNftMint(tx);
+        }
+        else if (txType == "NftData")
+        {
+            generateNftData(tx);
+        }
+        else
+        {
+            LOG_ERROR("Transaction type cannot be generated: " << txType);
+            return false;
+        }
+        return true;
+    }
+
+    void generateDeposit(json &tx)
+    {
+        const GeneratedAccount &account = getRandomAccount();
+        tx["owner"] = toDecimalString(account.owner);
+        tx["accountID"] = account.accountID;
+        tx["tokenID"] = getRandomToken();
+        tx["amount"] = toDecimalString(getRandomAmount(12, 18));
+    }
+
+    void generateWithdrawal(json &tx)
+    {
+        GeneratedAccount &account = getRandomAccount();
+        const unsigned int tokenID = getRandomToken();
+        Withdrawal withdrawal;
+        withdrawal.accountID = FieldT(account.accountID);
+        withdrawal.tokenID = FieldT(tokenID);
+        withdrawal.amount = getRandomAmount(12, 16);
+        withdrawal.feeTokenID = FieldT(getRandomToken());
+        withdrawal.fee = getRandomAmount(10, 14);
+        withdrawal.maxFee = withdrawal.fee;
+        withdrawal.onchainDataHash = FieldT::zero();
+        withdrawal.storageID = getNextStorageID(account, tokenID);
+        withdrawal.validUntil = FieldT(GENERATOR_VALID_UNTIL);
+        withdrawal.type = FieldT::zero();
+
+        tx["owner"] = toDecimalString(account.owner);
+        tx["accountID"] = account.accountID;
+        tx["tokenID"] = tokenID;
+        tx["amount"] = toDecimalString(withdrawal.amount);
+        tx["feeTokenID"] = withdrawal.feeTokenID.as_ulong();
+        tx["fee"] = toDecimalString(withdrawal.fee);
+        tx["maxFee"] = toDecimalString(withdrawal.maxFee);
+        tx["onchainDataHash"] = "0";
+        tx["storageID"] = toDecimalString(withdrawal.storageID);
+        tx["validUntil"] = GENERATOR_VALID_UNTIL;
+        tx["type"] = 0;
+        tx["signature"] =
+          toJSON(signMessage(account.keyPair, getWithdrawalHash(exchange, withdrawal), rng, params));
+    }
+
+    void generateTransfer(json &tx)
+    {
+        GeneratedAccount &from = getRandomAccount();
+        const GeneratedAccount &to = getOtherRandomAccount(from);
+        const unsigned int tokenID = getRandomToken();
+        Transfer transfer;
+        transfer.fromAccountID = FieldT(from.accountID);
+        transfer.toAccountID = FieldT(to.accountID);
+        transfer.tokenID = FieldT(tokenID);
+        transfer.amount = getRandomAmount(12, 16);
+        transfer.feeTokenID = FieldT(getRandomToken());
+        transfer.fee = getRandomAmount(10, 14);
+        transfer.maxFee = transfer.fee;
+        transfer.validUntil = FieldT(GENERATOR_VALID_UNTIL);
+        transfer.to = to.owner;
+        transfer.dualAuthorX = FieldT::zero();
+        transfer.dualAuthorY = FieldT::zero();
+        transfer.storageID = getNextStorageID(from, tokenID);
+        transfer.payerToAccountID = transfer.toAccountID;
+        transfer.payerTo = to.owner;
+        transfer.payeeToAccountID = transfer.toAccountID;
+
+        tx["fromAccountID"] = from.accountID;
+        tx["toAccountID"] = to.accountID;
+        tx["tokenID"] = tokenID;
+        tx["amount"] = toDecimalString(transfer.amount);
+        tx["feeTokenID"] = transfer.feeTokenID.as_ulong();
+        tx["fee"] = toDecimalString(transfer.fee);
+        tx["maxFee"] = toDecimalString(transfer.maxFee);
+        tx["validUntil"] = GENERATOR_VALID_UNTIL;
+        tx["type"] = 0;
+        tx["storageID"] = toDecimalString(transfer.storageID);
+        tx["from"] = toDecimalString(from.owner);
+        tx["to"] = toDecimalString(to.owner);
+        tx["dualAuthorX"] = "0";
+        tx["dualAuthorY"] = "0";
+        tx["payerToAccountID"] = to.accountID;
+        tx["payerTo"] = toDecimalString(to.owner);
+        tx["payeeToAccountID"] = to.accountID;
+        tx["putAddressesInDA"] = false;
+        tx["toTokenID"] = tokenID;
+        // The dual author is the payer, so the same signature is used for both
+        // hashes
+        tx["signature"] = toJSON(signMessage(from.keyPair, getTransferHash(exchange, transfer), rng, params));
+    }
+
+    // AMM orders pay no fee and are not signed
+    json generateOrder(
+      GeneratedAccount &account,
+      unsigned int tokenS,
+      unsigned int tokenB,
+      const FieldT &amountS,
+      const FieldT &amountB,
+      bool amm = false)
+    {
+        Order order;
+        order.storageID = getNextStorageID(account, tokenS);
+        order.accountID = FieldT(account.accountID);
+        order.tokenS = FieldT(tokenS);
+        order.tokenB = FieldT(tokenB);
+        order.amountS = amountS;
+        order.amountB = amountB;
+        order.validUntil = FieldT(GENERATOR_VALID_UNTIL);
+        order.maxFeeBips = FieldT(50);
+        order.fillAmountBorS = FieldT::zero();
+        order.taker = FieldT::zero();
+        order.nftDataB = FieldT::zero();
+
+        json jOrder;
+        jOrder["storageID"] = toDecimalString(order.storageID);
+        jOrder["accountID"] = account.accountID;
+        jOrder["tokenIdS"] = tokenS;
+        jOrder["tokenIdB"] = tokenB;
+        jOrder["amountS"] = toDecimalString(amountS);
+        jOrder["amountB"] = toDecimalString(amountB);
+        jOrder["validUntil"] = GENERATOR_VALID_UNTIL;
+        jOrder["maxFeeBips"] = 50;
+        jOrder["feeBips"] = amm ? 0 : getRandom(0, 51);
+        jOrder["fillAmountBorS"] = false;
+        jOrder["taker"] = "0";
+        jOrder["amm"] = amm;
+        jOrder["nftDataB"] = "0";
+        if (!amm)
+        {
+            jOrder["signature"] = toJSON(signMessage(account.keyPair, getOrderHash(exchange, order), rng, params));
+        }
+        return jOrder;
+    }
+
+    // Two orders at the same price that are filled completely
+    void generateSpotTrade(json &tx)
+    {
+        GeneratedAccount &accountA = getRandomAccount();
+        GeneratedAccount &accountB = getOtherRandomAccount(accountA);
+        const unsigned int tokenS = getRandomToken();
+        const unsigned int tokenB = (tokenS + getRandom(1, config.numTokens)) % config.numTokens;
+        const FieldT amountS = getRandomAmount(12, 16);
+        const FieldT amountB = getRandomAmount(12, 16);
+        tx["orderA"] = generateOrder(accountA, tokenS, tokenB, amountS, amountB);
+        tx["orderB"] = generateOrder(accountB, tokenB, tokenS, amountB, amountS);
+    }
+
+    // Sells between 0.1% and 10% of the virtual balance of the pool to the
+    // pool, at the best price the pool allows
+    void generateAmmSpotTrade(json &tx)
+    {
+        GeneratedAccount &pool = getPool();
+        GeneratedAccount &account = getOtherRandomAccount(pool);
+        const unsigned int tokenIn = getRandomToken();
+        const unsigned int tokenOut = (tokenIn + getRandom(1, config.numTokens)) % config.numTokens;
+        const BigInt balanceIn = toBigInt(pool.weightsAMM[tokenIn]);
+        const BigInt balanceOut = toBigInt(pool.weightsAMM[tokenOut]);
+        const BigInt amountIn = roundDownAmount(mulDiv(balanceIn, getRandom(1, 101), 1000));
+        BigInt maxAmountOut;
+        calcOutGivenInAMM(balanceIn, balanceOut, pool.feeBipsAMM, amountIn, maxAmountOut);
+        const BigInt amountOut = roundDownAmount(maxAmountOut);
+
+        tx["orderA"] = generateOrder(account, tokenIn, tokenOut, fromBigInt(amountIn), fromBigInt(amountOut));
+        tx["orderB"] = generateOrder(pool, tokenOut, tokenIn, fromBigInt(amountOut), fromBigInt(amountIn), true);
+        pool.weightsAMM[tokenIn] = fromBigInt(balanceIn + amountIn);
+        pool.weightsAMM[tokenOut] = fromBigInt(balanceOut - amountOut);
+    }
+
+    // Sets a new key pair, signed with the current key
+    void generateAccountUpdate(json &tx)
+    {
+        GeneratedAccount &account = getRandomAccount();
+        const EdDSAKeyPair keyPair = createKeyPair(rng, params);
+        AccountUpdateTx update;
+        update.owner = account.owner;
+        update.accountID = FieldT(account.accountID);
+        update.publicKeyX = keyPair.publicKey.x;
+        update.publicKeyY = keyPair.publicKey.y;
+        update.feeTokenID = FieldT(getRandomToken());
+        update.fee = getRandomAmount(10, 14);
+        update.maxFee = update.fee;
+        update.validUntil = FieldT(GENERATOR_VALID_UNTIL);
+        update.type = FieldT::zero();
+
+        tx["owner"] = toDecimalString(account.owner);
+        tx["accountID"] = account.accountID;
+        tx["publicKeyX"] = toDecimalString(update.publicKeyX);
+        tx["publicKeyY"] = toDecimalString(update.publicKeyY);
+        tx["feeTokenID"] = update.feeTokenID.as_ulong();
+        tx["fee"] = toDecimalString(update.fee);
+        tx["maxFee"] = toDecimalString(update.maxFee);
+        tx["validUntil"] = GENERATOR_VALID_UNTIL;
+        tx["type"] = 0;
+        tx["signature"] =
+          toJSON(signMessage(account.keyPair, getAccountUpdateHash(exchange, update, account.nonce), rng, params));
+
+        account.keyPair = keyPair;
+        account.nonce += FieldT::one();
+    }
+
+    // Only the pool is updated, the other accounts need to stay without
+    // weights (see generateNftMint)
+    void generateAmmUpdate(json &tx)
+    {
+        GeneratedAccount &pool = getPool();
+        const unsigned int tokenID = getRandomToken();
+        pool.feeBipsAMM = getRandom(0, 1 << NUM_BITS_AMM_BIPS);
+        pool.weightsAMM[tokenID] = getRandomAmount(12, 18);
+        tx["owner"] = toDecimalString(pool.owner);
+        tx["accountID"] = pool.accountID;
+        tx["tokenID"] = tokenID;
+        tx["feeBips"] = pool.feeBipsAMM;
+        tx["tokenWeight"] = toDecimalString(pool.weightsAMM[tokenID]);
+        pool.nonce += FieldT::one();
+    }
+
+    void generateSignatureVerification(json &tx)
+    {
+        const GeneratedAccount &account = getRandomAccount();
+        const FieldT data = getRandomScalar(rng);
+        tx["owner"] = toDecimalString(account.owner);
+        tx["accountID"] = account.accountID;
+        tx["data"] = toDecimalString(data);
+        tx["signature"] = toJSON(signMessage(account.keyPair, data, rng, params));
+    }
+
+    // Mints a new NFT on L2 (type 0) to the minter. The circuit checks the NFT
+    // data against the fee token balance of the token account, so the pool
+    // cannot be the token account.
+    void generateNftMint(json &tx)
+    {
+        const GeneratedAccount &tokenAccount = accounts[getRandom(1, accounts.size())];
+        GeneratedAccount &minter = getOtherRandomAccount(tokenAccount);
+        NftData nft;
+        nft.type = FieldT::zero();
+        nft.accountID = FieldT(minter.accountID);
+        nft.tokenID = FieldT(minter.nextNftTokenID++);
+        nft.minter = minter.owner;
+        nft.nftType = FieldT(getRandom(0, 2));
+        nft.tokenAddress = tokenAccount.owner;
+        nft.nftIDHi = FieldT(rng() >> 1);
+        nft.nftIDLo = FieldT(rng() >> 1);
+        nft.creatorFeeBips = FieldT(getRandom(0, 51));
+        const FieldT nftData = getNftData(nft);
+
+        const unsigned int feeTokenID = getRandomToken();
+        NftMint nftMint;
+        nftMint.minterAccountID = nft.accountID;
+        nftMint.toAccountID = nft.accountID;
+        nftMint.amount = FieldT(getRandom(1, 101));
+        nftMint.feeTokenID = FieldT(feeTokenID);
+        nftMint.fee = getRandomAmount(10, 14);
+        nftMint.maxFee = nftMint.fee;
+        nftMint.validUntil = FieldT(GENERATOR_VALID_UNTIL);
+        nftMint.storageID = getNextStorageID(minter, feeTokenID);
+
+        tx["type"] = 0;
+        tx["minterAccountID"] = minter.accountID;
+        tx["tokenAccountID"] = tokenAccount.accountID;
+        tx["nftType"] = nft.nftType.as_ulong();
+        tx["tokenAddress"] = toDecimalString(nft.tokenAddress);
+        tx["nftIDHi"] = toDecimalString(nft.nftIDHi);
+        tx["nftIDLo"] = toDecimalString(nft.nftIDLo);
+        tx["creatorFeeBips"] = nft.creatorFeeBips.as_ulong();
+        tx["nftData"] = toDecimalString(nftData);
+        tx["amount"] = toDecimalString(nftMint.amount);
+        tx["feeTokenID"] = feeTokenID;
+        tx["fee"] = toDecimalString(nftMint.fee);
+        tx["maxFee"] = toDecimalString(nftMint.maxFee);
+        tx["validUntil"] = GENERATOR_VALID_UNTIL;
+        tx["toAccountID"] = minter.accountID;
+        tx["toTokenID"] = nft.tokenID.as_ulong();
+        tx["to"] = toDecimalString(minter.owner);
+        tx["storageID"] = toDecimalString(nftMint.storageID);
+        tx["signature"] =
+          toJSON(signMessage(minter.keyPair, getNftMintHash(exchange, nftMint, nftData), rng, params));
+        nfts.push_back(nft);
+    }
+
+    // The data of a minted NFT, or of an empty NFT slot (with a zero minter)
+    // when nothing was minted yet
+    void generateNftData(json &tx)
+    {
+        NftData nft;
+        if (!nfts.empty())
+        {
+            nft = nfts[getRandom(0, nfts.size())];
+        }
+        else
+        {
+            const GeneratedAccount &account = getRandomAccount();
+            nft.accountID = FieldT(account.accountID);
+            nft.tokenID = FieldT(account.nextNftTokenID);
+            nft.minter = FieldT::zero();
+            nft.nftType = FieldT::zero();
+            nft.tokenAddress = FieldT::zero();
+            nft.nftIDHi = FieldT::zero();
+            nft.nftIDLo = FieldT::zero();
+            nft.creatorFeeBips = FieldT::zero();
+        }
+        tx["type"] = getRandom(0, 2);
+        tx["accountID"] = nft.accountID.as_ulong();
+        tx["tokenID"] = nft.tokenID.as_ulong();
+        tx["minter"] = toDecimalString(nft.minter);
+        tx["nftType"] = nft.nftType.as_ulong();
+        tx["tokenAddress"] = toDecimalString(nft.tokenAddress);
+        tx["nftIDHi"] = toDecimalString(nft.nftIDHi);
+        tx["nftIDLo"] = toDecimalString(nft.nftIDLo);
+        tx["creatorFeeBips"] = nft.creatorFeeBips.as_ulong();
+    }
+};
+
+} // namespace Loopring
+
+#endif
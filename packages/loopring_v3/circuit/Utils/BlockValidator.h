@@ -0,0 +1,540 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _BLOCKVALIDATOR_H_
+#define _BLOCKVALIDATOR_H_
+
+#include "Constants.h"
+#include "Data.h"
+#include "Utils.h"
+
+#include "../ThirdParty/BigIntHeader.hpp"
+#include "ethsnarks.hpp"
+
+#include <atomic>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Native (out-of-circuit) checks of the rules enforced by the transaction
+// circuits. These allow rejecting invalid blocks before any work is done on
+// the protoboard. The checks follow the gadgets exactly, so a block that
+// passes here can still fail in the circuit (e.g. invalid Merkle proofs or
+// signatures), but a block that fails here will never satisfy the circuit.
+
+// Information about the first transaction that is invalid
+struct BlockValidationFailure
+{
+    size_t txIndex;
+    std::string message;
+};
+
+static bool validationFailed(std::string &error, const std::string &message)
+{
+    error = message;
+    return false;
+}
+
+static const BigInt &getPowerOfTwo(unsigned int numBits)
+{
+    static const std::vector<BigInt> powers = []() {
+        std::vector<BigInt> values(NUM_BITS_MAX_VALUE + 1);
+        values[0] = 1;
+        for (unsigned int i = 1; i < values.size(); i++)
+        {
+            values[i] = values[i - 1] * 2;
+        }
+        return values;
+    }();
+    return powers[numBits];
+}
+
+static const BigInt &getFixedBase()
+{
+    static const BigInt fixedBase = BigInt(std::string(FIXED_BASE));
+    return fixedBase;
+}
+
+// Same as DualVariableGadget::generate_r1cs_constraints(true)
+static bool fitsInBits(const FieldT &value, unsigned int numBits)
+{
+    return value.as_bigint().num_bits() <= numBits;
+}
+
+static bool isNftToken(const FieldT &tokenID)
+{
+    return tokenID.as_ulong() >= NFT_TOKEN_ID_START;
+}
+
+// MulDivGadget (without the range checks)
+static BigInt mulDiv(const BigInt &value, const BigInt &numerator, const BigInt &denominator)
+{
+    return (value * numerator) / denominator;
+}
+
+// RequireAccuracyGadget
+static bool checkAccuracy(const BigInt &value, const BigInt &original, const Accuracy &accuracy)
+{
+    return value < getPowerOfTwo(NUM_BITS_AMOUNT) && value <= original &&
+           original * accuracy.numerator <= value * accuracy.denominator;
+}
+
+// FloatGadget + RequireAccuracyGadget as used for the fee and amount fields
+static bool checkFloatAccuracy(const BigInt &original, const FloatEncoding &encoding, const Accuracy &accuracy)
+{
+    if (original >= getPowerOfTwo(NUM_BITS_AMOUNT))
+    {
+        return false;
+    }
+    const BigInt value = fromFloat(toFloat(original, encoding), encoding);
+    return checkAccuracy(value, original, accuracy);
+}
+
+// RequireFillRateGadget
+static bool checkFillRate(
+  const BigInt &amountS,
+  const BigInt &amountB,
+  const BigInt &fillAmountS,
+  const BigInt &fillAmountB)
+{
+    if ((fillAmountS == 0) != (fillAmountB == 0))
+    {
+        return false;
+    }
+    return fillAmountS * amountB * 1000 <= fillAmountB * amountS * 1001;
+}
+
+// CalcOutGivenInAMMGadget, returns false if the gadget cannot be satisfied
+static bool calcOutGivenInAMM(
+  const BigInt &balanceIn,
+  const BigInt &balanceOut,
+  const BigInt &feeBips,
+  const BigInt &amountIn,
+  BigInt &result)
+{
+    const BigInt fee = mulDiv(amountIn, feeBips, 10000);
+    const BigInt y_denom = balanceIn + (amountIn - fee);
+    if (y_denom == 0 || y_denom >= getPowerOfTwo(NUM_BITS_AMOUNT))
+    {
+        return false;
+    }
+    const BigInt y = mulDiv(balanceIn, getFixedBase(), y_denom);
+    if (y > getFixedBase())
+    {
+        return false;
+    }
+    result = mulDiv(balanceOut, getFixedBase() - y, getFixedBase());
+    return true;
+}
+
+// SpotPriceAMMGadget, returns false if the gadget cannot be satisfied
+static bool calcSpotPriceAMM(const BigInt &balanceIn, const BigInt &balanceOut, const BigInt &feeBips, BigInt &result)
+{
+    if (balanceOut == 0)
+    {
+        return false;
+    }
+    const BigInt ratio = mulDiv(balanceIn, getFixedBase(), balanceOut);
+    if (ratio >= getPowerOfTwo(NUM_BITS_AMOUNT * 2 - 14))
+    {
+        return false;
+    }
+    result = mulDiv(ratio, 10000, BigInt(10000) - feeBips);
+    return true;
+}
+
+// RequireAMMFillsGadget for an AMM order
+static bool checkAMMFills(
+  const BigInt &orderFeeBips,
+  const BigInt &fillS,
+  const BigInt &fillB,
+  const BigInt &balanceS,
+  const BigInt &balanceB,
+  const BigInt &ammFeeBips,
+  std::string &error)
+{
+    if (orderFeeBips != 0)
+    {
+        return validationFailed(error, "AMM order with non-zero feeBips");
+    }
+    if (balanceB == 0 || balanceS == 0)
+    {
+        return validationFailed(error, "AMM balance is zero");
+    }
+    if (fillS > balanceS)
+    {
+        return validationFailed(error, "AMM fill exceeds the virtual balance");
+    }
+    if (balanceB + fillB >= getPowerOfTwo(NUM_BITS_AMOUNT))
+    {
+        return validationFailed(error, "AMM virtual balance overflow");
+    }
+
+    BigInt maxFillS;
+    if (!calcOutGivenInAMM(balanceB, balanceS, ammFeeBips, fillB, maxFillS))
+    {
+        return validationFailed(error, "AMM output amount could not be calculated");
+    }
+    if (fillS > maxFillS)
+    {
+        return validationFailed(error, "AMM fill too large: " + fillS.to_string() + " > " + maxFillS.to_string());
+    }
+
+    BigInt priceBefore;
+    BigInt priceAfter;
+    if (
+      !calcSpotPriceAMM(balanceB, balanceS, ammFeeBips, priceBefore) ||
+      !calcSpotPriceAMM(balanceB + fillB, balanceS - fillS, ammFeeBips, priceAfter))
+    {
+        return validationFailed(error, "AMM spot price could not be calculated");
+    }
+    if (priceAfter < priceBefore)
+    {
+        return validationFailed(error, "AMM price decreased");
+    }
+    return true;
+}
+
+// OrderGadget + the OrderMatchingGadget/RequireAMMFillsGadget checks for a
+// single order
+static bool validateOrder(
+  const Order &order,
+  const BigInt &timestamp,
+  const BigInt &fillS,
+  const BigInt &fillB,
+  const StorageLeaf &tradeHistory,
+  const FieldT &counterpartyOwner,
+  const BalanceLeaf &balanceS,
+  const BalanceLeaf &balanceB,
+  const AccountLeaf &account,
+  std::string &error)
+{
+    if (
+      !fitsInBits(order.storageID, NUM_BITS_STORAGEID) || !fitsInBits(order.accountID, NUM_BITS_ACCOUNT) ||
+      !fitsInBits(order.tokenS, NUM_BITS_TOKEN) || !fitsInBits(order.tokenB, NUM_BITS_TOKEN) ||
+      !fitsInBits(order.amountS, NUM_BITS_AMOUNT) || !fitsInBits(order.amountB, NUM_BITS_AMOUNT) ||
+      !fitsInBits(order.validUntil, NUM_BITS_TIMESTAMP) || !fitsInBits(order.maxFeeBips, NUM_BITS_BIPS) ||
+      !fitsInBits(order.fillAmountBorS, 1) || !fitsInBits(order.feeBips, NUM_BITS_BIPS) ||
+      !fitsInBits(order.amm, 1))
+    {
+        return validationFailed(error, "order field out of range");
+    }
+
+    const bool nftS = isNftToken(order.tokenS);
+    const bool nftB = isNftToken(order.tokenB);
+    const bool amm = order.amm == FieldT::one();
+    const BigInt amountS = toBigInt(order.amountS);
+    const BigInt amountB = toBigInt(order.amountB);
+    const unsigned long feeBips = order.feeBips.as_ulong();
+    const unsigned long maxFeeBips = order.maxFeeBips.as_ulong();
+
+    // Order
+    if (amountS == 0 || amountB == 0)
+    {
+        return validationFailed(error, "order amount is zero");
+    }
+    if (order.tokenS == order.tokenB)
+    {
+        return validationFailed(error, "tokenS == tokenB");
+    }
+    if (maxFeeBips > 10000)
+    {
+        return validationFailed(error, "maxFeeBips > 10000");
+    }
+    if (feeBips > maxFeeBips)
+    {
+        return validationFailed(
+          error, "feeBips > maxFeeBips: " + std::to_string(feeBips) + " > " + std::to_string(maxFeeBips));
+    }
+    if (nftS && nftB && feeBips != 0)
+    {
+        return validationFailed(error, "fee on an NFT/NFT trade");
+    }
+    if (amm && (nftS || nftB))
+    {
+        return validationFailed(error, "NFT in an AMM order");
+    }
+    if (nftB && fillB == 0)
+    {
+        return validationFailed(error, "zero NFT fill");
+    }
+    if (!(timestamp < toBigInt(order.validUntil)))
+    {
+        return validationFailed(error, "order expired");
+    }
+    if (order.taker != FieldT::zero() && order.taker != counterpartyOwner)
+    {
+        return validationFailed(error, "invalid taker");
+    }
+
+    // Trade history (StorageReaderGadget)
+    const BigInt storageID = toBigInt(order.storageID);
+    const BigInt leafStorageID = toBigInt(tradeHistory.storageID);
+    if (storageID < leafStorageID)
+    {
+        return validationFailed(error, "storageID already overwritten");
+    }
+    const BigInt filled = (storageID == leafStorageID) ? toBigInt(tradeHistory.data) : BigInt(0);
+
+    // Fill rate and limit
+    if (!checkFillRate(amountS, amountB, fillS, fillB))
+    {
+        return validationFailed(
+          error, "invalid fill rate: " + fillS.to_string() + "/" + fillB.to_string());
+    }
+    const bool limitOnB = order.fillAmountBorS == FieldT::one();
+    const BigInt filledAfter = filled + (limitOnB ? fillB : fillS);
+    if (filledAfter > (limitOnB ? amountB : amountS))
+    {
+        return validationFailed(error, "order overfilled: " + filledAfter.to_string());
+    }
+
+    // AMM
+    if (amm)
+    {
+        if (!checkAMMFills(
+              toBigInt(order.feeBips),
+              fillS,
+              fillB,
+              toBigInt(balanceS.weightAMM),
+              toBigInt(balanceB.weightAMM),
+              toBigInt(account.feeBipsAMM),
+              error))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool validateSpotTrade(const Block &block, const UniversalTransaction &tx, std::string &error)
+{
+    const SpotTrade &spotTrade = tx.spotTrade;
+    const Witness &witness = tx.witness;
+    const Order &orderA = spotTrade.orderA;
+    const Order &orderB = spotTrade.orderB;
+
+    if (!fitsInBits(spotTrade.fillS_A, 24) || !fitsInBits(spotTrade.fillS_B, 24))
+    {
+        return validationFailed(error, "fill out of range");
+    }
+    const BigInt fillS_A = fromFloat(spotTrade.fillS_A.as_ulong(), Float24Encoding);
+    const BigInt fillS_B = fromFloat(spotTrade.fillS_B.as_ulong(), Float24Encoding);
+    if (fillS_A >= getPowerOfTwo(NUM_BITS_AMOUNT) || fillS_B >= getPowerOfTwo(NUM_BITS_AMOUNT))
+    {
+        return validationFailed(error, "fill out of range");
+    }
+
+    const BigInt timestamp = toBigInt(block.timestamp);
+    std::string orderError;
+    if (!validateOrder(
+          orderA,
+          timestamp,
+          fillS_A,
+          fillS_B,
+          witness.storageUpdate_A.before,
+          witness.accountUpdate_B.before.owner,
+          witness.balanceUpdateS_A.before,
+          witness.balanceUpdateB_A.before,
+          witness.accountUpdate_A.before,
+          orderError))
+    {
+        return validationFailed(error, "orderA: " + orderError);
+    }
+    if (!validateOrder(
+          orderB,
+          timestamp,
+          fillS_B,
+          fillS_A,
+          witness.storageUpdate_B.before,
+          witness.accountUpdate_A.before.owner,
+          witness.balanceUpdateS_B.before,
+          witness.balanceUpdateB_B.before,
+          witness.accountUpdate_B.before,
+          orderError))
+    {
+        return validationFailed(error, "orderB: " + orderError);
+    }
+
+    // Fees (FeeCalculatorGadget). The fee is paid in tokenS when tokenB is an
+    // NFT, and there is no protocol fee for trades between NFTs.
+    const bool nftB_A = isNftToken(orderA.tokenB);
+    const bool nftB_B = isNftToken(orderB.tokenB);
+    const BigInt protocolTakerFeeBips =
+      (isNftToken(orderA.tokenS) && nftB_A) ? BigInt(0) : toBigInt(block.protocolTakerFeeBips);
+    const BigInt protocolMakerFeeBips =
+      (isNftToken(orderB.tokenS) && nftB_B) ? BigInt(0) : toBigInt(block.protocolMakerFeeBips);
+    const BigInt feeBipsA = toBigInt(orderA.feeBips);
+    const BigInt feeBipsB = toBigInt(orderB.feeBips);
+
+    const BigInt feeSA = mulDiv(fillS_A, nftB_A ? feeBipsA : BigInt(0), 10000);
+    const BigInt feeBA = mulDiv(fillS_B, nftB_A ? BigInt(0) : feeBipsA, 10000);
+    const BigInt feeSB = mulDiv(fillS_B, nftB_B ? feeBipsB : BigInt(0), 10000);
+    const BigInt feeBB = mulDiv(fillS_A, nftB_B ? BigInt(0) : feeBipsB, 10000);
+    const BigInt protocolFeeSA = mulDiv(fillS_A, nftB_A ? protocolTakerFeeBips : BigInt(0), 100000);
+    const BigInt protocolFeeBA = mulDiv(fillS_B, nftB_A ? BigInt(0) : protocolTakerFeeBips, 100000);
+    const BigInt protocolFeeSB = mulDiv(fillS_B, nftB_B ? protocolMakerFeeBips : BigInt(0), 100000);
+    const BigInt protocolFeeBB = mulDiv(fillS_A, nftB_B ? BigInt(0) : protocolMakerFeeBips, 100000);
+
+    // The token transfers can never make a balance negative
+    if (toBigInt(witness.balanceUpdateS_A.before.balance) < fillS_A + feeSA)
+    {
+        return validationFailed(error, "orderA: insufficient balance");
+    }
+    if (toBigInt(witness.balanceUpdateS_B.before.balance) < fillS_B + feeSB)
+    {
+        return validationFailed(error, "orderB: insufficient balance");
+    }
+    if (toBigInt(witness.balanceUpdateA_O.before.balance) + feeBA + feeSB < protocolFeeBA + protocolFeeSB)
+    {
+        return validationFailed(error, "operator: insufficient balance for protocol fees");
+    }
+    if (toBigInt(witness.balanceUpdateB_O.before.balance) + feeSA + feeBB < protocolFeeSA + protocolFeeBB)
+    {
+        return validationFailed(error, "operator: insufficient balance for protocol fees");
+    }
+    return true;
+}
+
+// Checks shared by all transactions signed with a fee (Transfer, Withdrawal,
+// AccountUpdate and NftMint)
+static bool validateFeePayment(
+  const BigInt &timestamp,
+  const FieldT &validUntil,
+  const FieldT &feeTokenID,
+  const FieldT &fee,
+  const FieldT &maxFee,
+  std::string &error)
+{
+    if (
+      !fitsInBits(validUntil, NUM_BITS_TIMESTAMP) || !fitsInBits(feeTokenID, NUM_BITS_TOKEN) ||
+      !fitsInBits(fee, NUM_BITS_AMOUNT) || !fitsInBits(maxFee, NUM_BITS_AMOUNT))
+    {
+        return validationFailed(error, "field out of range");
+    }
+    if (!(timestamp < toBigInt(validUntil)))
+    {
+        return validationFailed(error, "transaction expired");
+    }
+    const BigInt feeValue = toBigInt(fee);
+    if (feeValue > toBigInt(maxFee))
+    {
+        return validationFailed(error, "fee > maxFee");
+    }
+    if (isNftToken(feeTokenID))
+    {
+        return validationFailed(error, "fee paid in an NFT");
+    }
+    if (!checkFloatAccuracy(feeValue, Float16Encoding, Float16Accuracy))
+    {
+        return validationFailed(error, "fee cannot be represented as a float");
+    }
+    return true;
+}
+
+static bool validateTransaction(const Block &block, const UniversalTransaction &tx, std::string &error)
+{
+    const BigInt timestamp = toBigInt(block.timestamp);
+    switch (TransactionType(tx.type.as_ulong()))
+    {
+    case TransactionType::SpotTrade:
+    {
+        return validateSpotTrade(block, tx, error);
+    }
+    case TransactionType::Transfer:
+    {
+        const Transfer &transfer = tx.transfer;
+        if (!validateFeePayment(
+              timestamp, transfer.validUntil, transfer.feeTokenID, transfer.fee, transfer.maxFee, error))
+        {
+            return false;
+        }
+        if (!fitsInBits(transfer.tokenID, NUM_BITS_TOKEN) || !fitsInBits(transfer.amount, NUM_BITS_AMOUNT))
+        {
+            return validationFailed(error, "field out of range");
+        }
+        if (isNftToken(transfer.tokenID) && transfer.amount == FieldT::zero())
+        {
+            return validationFailed(error, "zero NFT transfer");
+        }
+        if (!checkFloatAccuracy(toBigInt(transfer.amount), Float24Encoding, Float24Accuracy))
+        {
+            return validationFailed(error, "amount cannot be represented as a float");
+        }
+        return true;
+    }
+    case TransactionType::Withdrawal:
+    {
+        const Withdrawal &withdrawal = tx.withdraw;
+        return validateFeePayment(
+          timestamp, withdrawal.validUntil, withdrawal.feeTokenID, withdrawal.fee, withdrawal.maxFee, error);
+    }
+    case TransactionType::AccountUpdate:
+    {
+        const AccountUpdateTx &update = tx.accountUpdate;
+        return validateFeePayment(timestamp, update.validUntil, update.feeTokenID, update.fee, update.maxFee, error);
+    }
+    case TransactionType::NftMint:
+    {
+        const NftMint &nftMint = tx.nftMint;
+        return validateFeePayment(
+          timestamp, nftMint.validUntil, nftMint.feeTokenID, nftMint.fee, nftMint.maxFee, error);
+    }
+    default:
+    {
+        // Nothing that can be checked without the state
+        return true;
+    }
+    }
+}
+
+// Validates all transactions in the block in parallel. Returns the first
+// (lowest index) invalid transaction.
+static bool validateBlock(const Block &block, BlockValidationFailure *failure = nullptr)
+{
+    const size_t numTransactions = block.transactions.size();
+    std::vector<std::string> errors(numTransactions);
+    std::atomic<size_t> firstFailure(std::numeric_limits<size_t>::max());
+
+#ifdef MULTICORE
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+    for (size_t i = 0; i < numTransactions; i++)
+    {
+        if (i >= firstFailure.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+        if (!validateTransaction(block, block.transactions[i], errors[i]))
+        {
+            size_t current = firstFailure.load();
+            while (i < current && !firstFailure.compare_exchange_weak(current, i))
+            {
+            }
+        }
+    }
+
+    const size_t failed = firstFailure.load();
+    if (failed == std::numeric_limits<size_t>::max())
+    {
+        return true;
+    }
+    if (failure)
+    {
+        failure->txIndex = failed;
+        failure->message = errors[failed];
+    }
+    return false;
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _CONSTRAINTCHECKER_H_
+#define _CONSTRAINTCHECKER_H_
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <string>
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Information about the first constraint that is not satisfied
+struct ConstraintFailure
+{
+    size_t index;
+    std::string annotation;
+    FieldT a;
+    FieldT b;
+    FieldT c;
+};
+
+// Checks if the values in the protoboard satisfy all constraints, the same
+// as `pb.is_satisfied()`, but the constraints are evaluated in chunks in
+// parallel and the first (lowest index) constraint that fails is reported.
+// Chunks after an already found failure are skipped.
+static bool checkConstraints(
+  const ProtoboardT &pb,
+  ConstraintFailure *failure = nullptr,
+  size_t chunkSize = 1 << 14)
+{
+    const auto &constraints = pb.constraint_system.constraints;
+    // The full assignment excluding the constant ONE (variable 0)
+    const auto &assignment = pb.values;
+    if (assignment.size() != pb.num_variables())
+    {
+        if (failure)
+        {
+            failure->index = std::numeric_limits<size_t>::max();
+            failure->annotation = "invalid assignment size";
+        }
+        return false;
+    }
+
+    const size_t numConstraints = constraints.size();
+    const size_t numChunks = (numConstraints + chunkSize - 1) / chunkSize;
+    std::atomic<size_t> firstFailure(std::numeric_limits<size_t>::max());
+
+#ifdef MULTICORE
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        const size_t begin = chunk * chunkSize;
+        const size_t end = std::min(begin + chunkSize, numConstraints);
+        for (size_t i = begin; i < end; i++)
+        {
+            // No need to continue if an earlier constraint already failed
+            if (i >= firstFailure.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+            const FieldT a = constraints[i]->getA().evaluate(assignment);
+            const FieldT b = constraints[i]->getB().evaluate(assignment);
+            const FieldT c = constraints[i]->getC().evaluate(assignment);
+            if (a * b != c)
+            {
+                size_t current = firstFailure.load();
+                while (i < current && !firstFailure.compare_exchange_weak(current, i))
+                {
+                }
+                break;
+            }
+        }
+    }
+
+    const size_t failed = firstFailure.load();
+    if (failed == std::numeric_limits<size_t>::max())
+    {
+        return true;
+    }
+
+    if (failure)
+    {
+        failure->index = failed;
+        failure->a = constraints[failed]->getA().evaluate(assignment);
+        failure->b = constraints[failed]->getB().evaluate(assignment);
+        failure->c = constraints[failed]->getC().evaluate(assignment);
+#ifdef DEBUG
+        auto it = pb.constraint_system.constraint_annotations.find(failed);
+        failure->annotation = (it != pb.constraint_system.constraint_annotations.end()) ? it->second : "";
+#else
+        failure->annotation = "";
+#endif
+    }
+    return false;
+}
+
+} // namespace Loopring
+
+#endif
@@ -677,31 +677,72 @@ class UniversalTransaction
     NftData nftData;
 };
 
-static void from_json(const json &j, UniversalTransaction &transaction)
+// Fills in dummy data for all tx types except the type of the transaction
+static void setDummyTransactions(UniversalTransaction &transaction)
 {
-    transaction.witness = j.at("witness").get<Witness>();
-
-    // Fill in dummy data for all tx types
-    transaction.spotTrade = dummySpotTrade.get<Loopring::SpotTrade>();
-    transaction.transfer = dummyTransfer.get<Loopring::Transfer>();
-    transaction.withdraw = dummyWithdraw.get<Loopring::Withdrawal>();
-    transaction.deposit = dummyDeposit.get<Loopring::Deposit>();
-    transaction.accountUpdate = dummyAccountUpdate.get<Loopring::AccountUpdateTx>();
-    transaction.ammUpdate = dummyAmmUpdate.get<Loopring::AmmUpdate>();
-    transaction.signatureVerification = dummySignatureVerification.get<Loopring::SignatureVerification>();
-    transaction.nftMint = dummyNftMint.get<Loopring::NftMint>();
-    transaction.nftData = dummyNftData.get<Loopring::NftData>();
+    const TransactionType type = TransactionType(transaction.type.as_ulong());
+    const Witness &witness = transaction.witness;
+    if (type != TransactionType::SpotTrade)
+    {
+        transaction.spotTrade = dummySpotTrade.get<Loopring::SpotTrade>();
+    }
+    if (type != TransactionType::Transfer)
+    {
+        transaction.transfer = dummyTransfer.get<Loopring::Transfer>();
+    }
+    if (type != TransactionType::Withdrawal)
+    {
+        transaction.withdraw = dummyWithdraw.get<Loopring::Withdrawal>();
+    }
+    if (type != TransactionType::Deposit)
+    {
+        transaction.deposit = dummyDeposit.get<Loopring::Deposit>();
+    }
+    if (type != TransactionType::AccountUpdate)
+    {
+        transaction.accountUpdate = dummyAccountUpdate.get<Loopring::AccountUpdateTx>();
+    }
+    if (type != TransactionType::AmmUpdate)
+    {
+        transaction.ammUpdate = dummyAmmUpdate.get<Loopring::AmmUpdate>();
+    }
+    if (type != TransactionType::SignatureVerification)
+    {
+        transaction.signatureVerification = dummySignatureVerification.get<Loopring::SignatureVerification>();
+    }
+    if (type != TransactionType::NftMint)
+    {
+        transaction.nftMint = dummyNftMint.get<Loopring::NftMint>();
+    }
+    if (type != TransactionType::NftData)
+    {
+        transaction.nftData = dummyNftData.get<Loopring::NftData>();
+    }
 
     // Patch some of the dummy tx's so they are valid against the current state
     // Deposit
-    transaction.deposit.owner = transaction.witness.accountUpdate_A.before.owner;
+    if (type != TransactionType::Deposit)
+    {
+        transaction.deposit.owner = witness.accountUpdate_A.before.owner;
+    }
     // AccountUpdate
-    transaction.accountUpdate.owner = transaction.witness.accountUpdate_A.before.owner;
+    if (type != TransactionType::AccountUpdate)
+    {
+        transaction.accountUpdate.owner = witness.accountUpdate_A.before.owner;
+    }
     // Transfer
-    transaction.transfer.to = transaction.witness.accountUpdate_B.before.owner;
-    transaction.transfer.payerTo = transaction.witness.accountUpdate_B.before.owner;
+    if (type != TransactionType::Transfer)
+    {
+        transaction.transfer.to = witness.accountUpdate_B.before.owner;
+        transaction.transfer.payerTo = witness.accountUpdate_B.before.owner;
+    }
+}
+
+static void from_json(const json &j, UniversalTransaction &transaction)
+{
+    transaction.witness = j.at("witness").get<Witness>();
 
-    // Now get the actual transaction data for the actual transaction that will
+    // Get the actual transaction data for the actual transaction that will
     // execute from the block
     if (j.contains("noop"))
     {
@@ -752,6 +793,9 @@ static void from_json(const json &j, UniversalTransaction &transaction)
         transaction.type = ethsnarks::FieldT(int(Loopring::TransactionType::NftData));
         transaction.nftData = j.at("nftData").get<Loopring::NftData>();
     }
+
+    // Fill in dummy data for all other tx types
+    setDummyTransactions(transaction);
 }
 
 class Block
@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _JUBJUB_H_
+#define _JUBJUB_H_
+
+#include "ethsnarks.hpp"
+#include "jubjub/params.hpp"
+#include "jubjub/point.hpp"
+
+#include <algorithm>
+#include <gmp.h>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Order of the prime order subgroup of Baby Jubjub
+static const char *JUBJUB_SUBGROUP_ORDER =
+  "2736030358979909402780800718157159386076813972158567259200215660948447373041";
+
+// Native (out-of-circuit) Baby Jubjub point in extended twisted Edwards
+// coordinates (x = X/Z, y = Y/Z, x*y = T/Z). Additions and doublings don't need
+// any inversions. The formulas are complete on Baby Jubjub.
+// See https://eprint.iacr.org/2008/522.pdf
+class ExtendedPoint
+{
+  public:
+    FieldT X;
+    FieldT Y;
+    FieldT T;
+    FieldT Z;
+
+    ExtendedPoint() : X(FieldT::zero()), Y(FieldT::one()), T(FieldT::zero()), Z(FieldT::one())
+    {
+    }
+
+    ExtendedPoint(const FieldT &x, const FieldT &y) : X(x), Y(y), T(x * y), Z(FieldT::one())
+    {
+    }
+
+    explicit ExtendedPoint(const jubjub::EdwardsPoint &point) : ExtendedPoint(point.x, point.y)
+    {
+    }
+
+    static ExtendedPoint identity()
+    {
+        return ExtendedPoint();
+    }
+
+    jubjub::EdwardsPoint toAffine() const
+    {
+        const FieldT invZ = Z.inverse();
+        return jubjub::EdwardsPoint(X * invZ, Y * invZ);
+    }
+
+    ExtendedPoint add(const ExtendedPoint &other, const jubjub::Params &params) const
+    {
+        const FieldT A = X * other.X;
+        const FieldT B = Y * other.Y;
+        const FieldT C = params.d * T * other.T;
+        const FieldT D = Z * other.Z;
+        const FieldT E = (X + Y) * (other.X + other.Y) - A - B;
+        const FieldT F = D - C;
+        const FieldT G = D + C;
+        const FieldT H = B - params.a * A;
+        ExtendedPoint result;
+        result.X = E * F;
+        result.Y = G * H;
+        result.T = E * H;
+        result.Z = F * G;
+        return result;
+    }
+
+    ExtendedPoint dbl(const jubjub::Params &params) const
+    {
+        const FieldT A = X.squared();
+        const FieldT B = Y.squared();
+        const FieldT C = Z.squared() + Z.squared();
+        const FieldT D = params.a * A;
+        const FieldT E = (X + Y).squared() - A - B;
+        const FieldT G = D + B;
+        const FieldT F = G - C;
+        const FieldT H = D - B;
+        ExtendedPoint result;
+        result.X = E * F;
+        result.Y = G * H;
+        result.T = E * H;
+        result.Z = F * G;
+        return result;
+    }
+
+    ExtendedPoint neg() const
+    {
+        ExtendedPoint result = *this;
+        result.X = -X;
+        result.T = -T;
+        return result;
+    }
+
+    bool isIdentity() const
+    {
+        return X == FieldT::zero() && Y == Z;
+    }
+
+    bool operator==(const ExtendedPoint &other) const
+    {
+        return X * other.Z == other.X * Z && Y * other.Z == other.Y * Z;
+    }
+};
+
+// a*x^2 + y^2 == 1 + d*x^2*y^2
+static bool isOnCurve(const jubjub::EdwardsPoint &point, const jubjub::Params &params)
+{
+    const FieldT xx = point.x.squared();
+    const FieldT yy = point.y.squared();
+    return params.a * xx + yy == FieldT::one() + params.d * xx * yy;
+}
+
+// Scalars are stored as bits, LSB first
+using ScalarBits = std::vector<bool>;
+
+static ScalarBits toScalarBits(const mpz_t value)
+{
+    const size_t numBits = mpz_sizeinbase(value, 2);
+    ScalarBits bits(numBits);
+    for (size_t i = 0; i < numBits; i++)
+    {
+        bits[i] = mpz_tstbit(value, i);
+    }
+    return bits;
+}
+
+static ScalarBits toScalarBits(const FieldT &value)
+{
+    mpz_t v;
+    mpz_init(v);
+    value.as_bigint().to_mpz(v);
+    ScalarBits bits = toScalarBits(v);
+    mpz_clear(v);
+    return bits;
+}
+
+static ExtendedPoint scalarMul(const ExtendedPoint &point, const ScalarBits &scalar, const jubjub::Params &params)
+{
+    ExtendedPoint result;
+    for (size_t i = scalar.size(); i-- > 0;)
+    {
+        result = result.dbl(params);
+        if (scalar[i])
+        {
+            result = result.add(point, params);
+        }
+    }
+    return result;
+}
+
+// sum(points[i] * scalars[i]). All points share the same chain of doublings
+// (Straus' method), so this is much cheaper than separate multiplications.
+static ExtendedPoint multiScalarMul(
+  const std::vector<ExtendedPoint> &points,
+  const std::vector<ScalarBits> &scalars,
+  const jubjub::Params &params)
+{
+    size_t numBits = 0;
+    for (const ScalarBits &scalar : scalars)
+    {
+        numBits = std::max(numBits, scalar.size());
+    }
+    ExtendedPoint result;
+    for (size_t i = numBits; i-- > 0;)
+    {
+        result = result.dbl(params);
+        for (size_t j = 0; j < points.size(); j++)
+        {
+            if (i < scalars[j].size() && scalars[j][i])
+            {
+                result = result.add(points[j], params);
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// Levels below this value are compiled out completely.
+// Can be set from the build (e.g. -DLOG_MIN_LEVEL=2 to remove all debug logging).
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+namespace Loopring
+{
+
+enum class LogLevel
+{
+    Trace = 0,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    None
+};
+
+class Log
+{
+  public:
+    static LogLevel getLevel()
+    {
+        return LogLevel(level().load(std::memory_order_relaxed));
+    }
+
+    static void setLevel(LogLevel newLevel)
+    {
+        level().store(int(newLevel), std::memory_order_relaxed);
+    }
+
+    // Checked before the message is formatted, so disabled levels only cost a
+    // single relaxed load (or nothing at all when below LOG_MIN_LEVEL).
+    static bool isEnabled(LogLevel messageLevel)
+    {
+        return int(messageLevel) >= LOG_MIN_LEVEL && int(messageLevel) >= level().load(std::memory_order_relaxed);
+    }
+
+    static void write(LogLevel messageLevel, const std::string &message)
+    {
+        // Lines can be written from multiple threads during witness generation
+        const std::lock_guard<std::mutex> lock(mutex());
+        std::ostream &out = (messageLevel >= LogLevel::Warning) ? std::cerr : std::cout;
+        out << message << std::endl;
+    }
+
+    static bool parseLevel(const std::string &name, LogLevel &result)
+    {
+        static const char *names[] = {"trace", "debug", "info", "warning", "error", "none"};
+        for (unsigned int i = 0; i <= (unsigned int)LogLevel::None; i++)
+        {
+            if (name.compare(names[i]) == 0)
+            {
+                result = LogLevel(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    static std::atomic<int> &level()
+    {
+        static std::atomic<int> currentLevel(int(LogLevel::Info));
+        return currentLevel;
+    }
+
+    static std::mutex &mutex()
+    {
+        static std::mutex logMutex;
+        return logMutex;
+    }
+};
+
+} // namespace Loopring
+
+#define LOG_ENABLED(level) (Loopring::Log::isEnabled(level))
+
+#define LOG(level, message)                                                                                            \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (LOG_ENABLED(level))                                                                                        \
+        {                                                                                                              \
+            std::ostringstream _logStream;                                                                             \
+            _logStream << message;                                                                                     \
+            Loopring::Log::write(level, _logStream.str());                                                             \
+        }                                                                                                              \
+    } while (false)
+
+#define LOG_TRACE(message) LOG(Loopring::LogLevel::Trace, message)
+#define LOG_DEBUG(message) LOG(Loopring::LogLevel::Debug, message)
+#define LOG_INFO(message) LOG(Loopring::LogLevel::Info, message)
+#define LOG_WARNING(message) LOG(Loopring::LogLevel::Warning, message)
+#define LOG_ERROR(message) LOG(Loopring::LogLevel::Error, message)
+
+#endif
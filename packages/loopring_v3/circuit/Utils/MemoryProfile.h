@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _MEMORYPROFILE_H_
+#define _MEMORYPROFILE_H_
+
+#include "Data.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace Loopring
+{
+
+// The maximum resident set size of the process so far
+static double getPeakRSS_MB()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0.0;
+    }
+    // Linux reports the size in KB
+    return usage.ru_maxrss / 1024.0;
+}
+
+struct MemoryUsage
+{
+    double vm_mb;
+    double rss_mb;
+    double peak_rss_mb;
+};
+
+static MemoryUsage getMemoryUsage()
+{
+    MemoryUsage usage = {0.0, 0.0, getPeakRSS_MB()};
+    // The sizes are in pages
+    std::ifstream statm("/proc/self/statm");
+    size_t vmPages = 0;
+    size_t rssPages = 0;
+    if (statm >> vmPages >> rssPages)
+    {
+        const double pageSize_mb = sysconf(_SC_PAGE_SIZE) / (1024.0 * 1024.0);
+        usage.vm_mb = vmPages * pageSize_mb;
+        usage.rss_mb = rssPages * pageSize_mb;
+        // The peak is only updated by the kernel now and then
+        usage.peak_rss_mb = std::max(usage.peak_rss_mb, usage.rss_mb);
+    }
+    return usage;
+}
+
+// The number of bytes of the elements of a container (not of the memory the
+// elements point to)
+template <typename C> static size_t getContainerBytes(const C &container)
+{
+    return container.size() * sizeof(*container.begin());
+}
+
+struct MemoryProfileEntry
+{
+    std::string stage;
+    MemoryUsage usage;
+    // The bytes used by the data structures alive after the stage
+    std::map<std::string, size_t> sizes;
+};
+
+// Records the memory usage of the process after each stage of the pipeline
+// (e.g. after the circuit is created or the proving key is loaded). Disabled
+// by default, checking if it is enabled only costs a single relaxed load.
+class MemoryProfile
+{
+  public:
+    static bool isEnabled()
+    {
+        return enabled().load(std::memory_order_relaxed);
+    }
+
+    // Starts recording, the profile is written to filename by write()
+    static void start(const std::string &filename)
+    {
+        const std::lock_guard<std::mutex> lock(mutex());
+        profileFilename() = filename;
+        entries().clear();
+        enabled().store(true, std::memory_order_relaxed);
+    }
+
+    // Stops recording, the entries recorded so far are kept
+    static void stop()
+    {
+        enabled().store(false, std::memory_order_relaxed);
+    }
+
+    // Removes the entries recorded so far
+    static void clear()
+    {
+        const std::lock_guard<std::mutex> lock(mutex());
+        entries().clear();
+    }
+
+    static void record(const std::string &stage, const std::map<std::string, size_t> &sizes)
+    {
+        if (!isEnabled())
+        {
+            return;
+        }
+#ifdef __GLIBC__
+        // Return the freed memory to the system so the RSS is not inflated by
+        // memory that is only cached by malloc
+        malloc_trim(0);
+#endif
+        const MemoryProfileEntry entry = {stage, getMemoryUsage(), sizes};
+        LOG_INFO(
+          "Memory after " << stage << ": VM: " << unsigned(entry.usage.vm_mb) << "MB; RSS: "
+                          << unsigned(entry.usage.rss_mb) << "MB; peak RSS: " << unsigned(entry.usage.peak_rss_mb)
+                          << "MB");
+        for (const auto &size : sizes)
+        {
+            LOG_INFO("- " << size.first << ": " << unsigned(size.second / (1024 * 1024)) << "MB");
+        }
+        const std::lock_guard<std::mutex> lock(mutex());
+        entries().push_back(entry);
+    }
+
+    static json toJSON()
+    {
+        const std::lock_guard<std::mutex> lock(mutex());
+        json jEntries = json::array();
+        for (const MemoryProfileEntry &entry : entries())
+        {
+            jEntries.push_back(
+              {{"stage", entry.stage},
+               {"vm_mb", entry.usage.vm_mb},
+               {"rss_mb", entry.usage.rss_mb},
+               {"peak_rss_mb", entry.usage.peak_rss_mb},
+               {"bytes", entry.sizes}});
+        }
+        return json{{"stages", jEntries}};
+    }
+
+    // Writes all entries recorded since start(), does nothing when profiling
+    // was never started
+    static bool write()
+    {
+        if (profileFilename().empty())
+        {
+            return true;
+        }
+        std::ofstream file(profileFilename());
+        if (!file.is_open())
+        {
+            LOG_ERROR("Cannot create memory profile file: " << profileFilename());
+            return false;
+        }
+        file << toJSON().dump(4) << std::endl;
+        return true;
+    }
+
+  private:
+    static std::atomic<bool> &enabled()
+    {
+        static std::atomic<bool> profileEnabled(false);
+        return profileEnabled;
+    }
+
+    static std::mutex &mutex()
+    {
+        static std::mutex profileMutex;
+        return profileMutex;
+    }
+
+    static std::vector<MemoryProfileEntry> &entries()
+    {
+        static std::vector<MemoryProfileEntry> profileEntries;
+        return profileEntries;
+    }
+
+    static std::string &profileFilename()
+    {
+        static std::string filename;
+        return filename;
+    }
+};
+
+// Writes the memory profile (when enabled) when it goes out of scope. With
+// clear the entries are removed after they are written, like for TraceWriter.
+class MemoryProfileWriter
+{
+  public:
+    MemoryProfileWriter(bool _clear = false) : clear(_clear)
+    {
+    }
+
+    ~MemoryProfileWriter()
+    {
+        MemoryProfile::write();
+        if (clear)
+        {
+            MemoryProfile::clear();
+        }
+    }
+
+  private:
+    bool clear;
+};
+
+} // namespace Loopring
+
+#endif
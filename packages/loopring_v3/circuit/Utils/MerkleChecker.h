@@ -0,0 +1,602 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _MERKLECHECKER_H_
+#define _MERKLECHECKER_H_
+
+#include "Constants.h"
+#include "Data.h"
+#include "Poseidon.h"
+#include "../Gadgets/MerkleTree.h"
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Native (out-of-circuit) verification of all Merkle proofs in a block
+// witness. Every path is recomputed the same way as UpdateAccountGadget,
+// UpdateBalanceGadget and UpdateStorageGadget do and the roots are checked to
+// chain correctly from one update to the next, so stale or mismatched state
+// is detected before the witness is generated.
+
+// Information about the first Merkle update that is invalid.
+// txIndex is equal to the number of transactions for the updates done at the
+// end of the block (protocol fee pool and operator).
+struct MerkleFailure
+{
+    size_t txIndex;
+    std::string tree;
+    std::string message;
+};
+
+// The children of a node on the path, the siblings are stored in the proof in
+// the same order as in merkle_path_compute_4
+static std::array<FieldT, 4> getMerkleChildren(
+  const FieldT &node,
+  unsigned long address,
+  unsigned int level,
+  const std::vector<FieldT> &proof)
+{
+    // The position of the node amongst its siblings
+    const unsigned int position = (address >> (2 * level)) & 3;
+    std::array<FieldT, 4> children;
+    unsigned int sibling = 0;
+    for (unsigned int c = 0; c < 4; c++)
+    {
+        children[c] = (c == position) ? node : proof[level * 3 + sibling++];
+    }
+    return children;
+}
+
+// Native version of merkle_path_compute_4
+template <typename HashT>
+static FieldT computeMerkleRoot(
+  unsigned int depth,
+  const FieldT &address,
+  const FieldT &leaf,
+  const std::vector<FieldT> &proof)
+{
+    const unsigned long addressValue = address.as_ulong();
+    FieldT node = leaf;
+    for (unsigned int i = 0; i < depth; i++)
+    {
+        node = PoseidonNative<HashT>::hash(getMerkleChildren(node, addressValue, i, proof));
+    }
+    return node;
+}
+
+struct MerklePath
+{
+    unsigned int depth;
+    unsigned long address;
+    const std::vector<FieldT> *proof;
+    // The leaf, replaced by the root by computeMerkleRoots
+    FieldT node;
+};
+
+// Computes the roots of many paths at once. The nodes on the same level of all
+// paths are hashed together in a single batch.
+template <typename HashT> static void computeMerkleRoots(std::vector<MerklePath> &paths)
+{
+    unsigned int maxDepth = 0;
+    for (const MerklePath &path : paths)
+    {
+        maxDepth = std::max(maxDepth, path.depth);
+    }
+    std::vector<typename PoseidonNative<HashT>::Inputs> inputs;
+    std::vector<size_t> indices;
+    std::vector<FieldT> hashes;
+    for (unsigned int level = 0; level < maxDepth; level++)
+    {
+        inputs.clear();
+        indices.clear();
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (level < paths[i].depth)
+            {
+                inputs.push_back(getMerkleChildren(paths[i].node, paths[i].address, level, *paths[i].proof));
+                indices.push_back(i);
+            }
+        }
+        hashes.resize(inputs.size());
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            hashes[i] = PoseidonNative<HashT>::hash(inputs[i]);
+        }
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            paths[indices[i]].node = hashes[i];
+        }
+    }
+}
+
+static PoseidonNative<HashAccountLeaf>::Inputs getLeafInputs(const AccountLeaf &leaf)
+{
+    return {leaf.owner, leaf.publicKey.x, leaf.publicKey.y, leaf.nonce, leaf.feeBipsAMM, leaf.balancesRoot};
+}
+
+static PoseidonNative<HashBalanceLeaf>::Inputs getLeafInputs(const BalanceLeaf &leaf)
+{
+    return {leaf.balance, leaf.weightAMM, leaf.storageRoot};
+}
+
+static PoseidonNative<HashStorageLeaf>::Inputs getLeafInputs(const StorageLeaf &leaf)
+{
+    return {leaf.data, leaf.storageID};
+}
+
+static FieldT hashAccountLeaf(const AccountLeaf &leaf)
+{
+    return PoseidonNative<HashAccountLeaf>::hash(getLeafInputs(leaf));
+}
+
+static FieldT hashBalanceLeaf(const BalanceLeaf &leaf)
+{
+    return PoseidonNative<HashBalanceLeaf>::hash(getLeafInputs(leaf));
+}
+
+static FieldT hashStorageLeaf(const StorageLeaf &leaf)
+{
+    return PoseidonNative<HashStorageLeaf>::hash(getLeafInputs(leaf));
+}
+
+static bool checkProofShape(unsigned int depth, const FieldT &address, const Proof &proof, std::string &error)
+{
+    if (proof.data.size() != depth * 3)
+    {
+        error = "invalid proof length: " + std::to_string(proof.data.size());
+        return false;
+    }
+    if (address.as_bigint().num_bits() > depth * 2)
+    {
+        error = "address out of range";
+        return false;
+    }
+    return true;
+}
+
+template <typename LeafT>
+static bool checkMerkleUpdate(
+  unsigned int depth,
+  const FieldT &address,
+  const LeafT &before,
+  const LeafT &after,
+  const Proof &proof,
+  const FieldT &rootBefore,
+  const FieldT &rootAfter,
+  FieldT (*hashLeaf)(const LeafT &),
+  std::string &error)
+{
+    if (!checkProofShape(depth, address, proof, error))
+    {
+        return false;
+    }
+    if (computeMerkleRoot<HashMerkleTree>(depth, address, hashLeaf(before), proof.data) != rootBefore)
+    {
+        error = "invalid proof for the leaf before";
+        return false;
+    }
+    if (computeMerkleRoot<HashMerkleTree>(depth, address, hashLeaf(after), proof.data) != rootAfter)
+    {
+        error = "invalid proof for the leaf after";
+        return false;
+    }
+    return true;
+}
+
+// Only the lower bits of the storageID are used as the address
+static FieldT getStorageSlot(const StorageUpdate &update)
+{
+    return FieldT(update.storageID.as_ulong() % NUM_STORAGE_SLOTS);
+}
+
+static bool checkStorageUpdate(const StorageUpdate &update, std::string &error)
+{
+    return checkMerkleUpdate<StorageLeaf>(
+      TREE_DEPTH_STORAGE,
+      getStorageSlot(update),
+      update.before,
+      update.after,
+      update.proof,
+      update.rootBefore,
+      update.rootAfter,
+      hashStorageLeaf,
+      error);
+}
+
+static bool checkBalanceUpdate(const BalanceUpdate &update, std::string &error)
+{
+    return checkMerkleUpdate<BalanceLeaf>(
+      TREE_DEPTH_TOKENS,
+      update.tokenID,
+      update.before,
+      update.after,
+      update.proof,
+      update.rootBefore,
+      update.rootAfter,
+      hashBalanceLeaf,
+      error);
+}
+
+static bool checkAccountUpdate(const AccountUpdate &update, std::string &error)
+{
+    return checkMerkleUpdate<AccountLeaf>(
+      TREE_DEPTH_ACCOUNTS,
+      update.accountID,
+      update.before,
+      update.after,
+      update.proof,
+      update.rootBefore,
+      update.rootAfter,
+      hashAccountLeaf,
+      error);
+}
+
+static bool merkleCheckFailed(MerkleFailure &failure, size_t txIndex, const char *tree, const std::string &message)
+{
+    failure.txIndex = txIndex;
+    failure.tree = tree;
+    failure.message = message;
+    return false;
+}
+
+// A Merkle update in the block, checked together with all other updates
+struct MerkleUpdateCheck
+{
+    size_t txIndex;
+    const char *tree;
+    unsigned int depth;
+    FieldT address;
+    const Proof *proof;
+    const FieldT *rootBefore;
+    const FieldT *rootAfter;
+    FieldT leafBefore;
+    FieldT leafAfter;
+};
+
+// Leaves of the same type that are hashed together
+template <typename HashT> class LeafHashes
+{
+  public:
+    std::vector<typename PoseidonNative<HashT>::Inputs> inputs;
+    std::vector<FieldT *> outputs;
+
+    void add(const typename PoseidonNative<HashT>::Inputs &leaf, FieldT *output)
+    {
+        inputs.push_back(leaf);
+        outputs.push_back(output);
+    }
+
+    void hash()
+    {
+        std::vector<FieldT> hashes(inputs.size());
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            hashes[i] = PoseidonNative<HashT>::hash(inputs[i]);
+        }
+        for (size_t i = 0; i < hashes.size(); i++)
+        {
+            *outputs[i] = hashes[i];
+        }
+    }
+};
+
+class BlockMerkleUpdates
+{
+  public:
+    std::vector<MerkleUpdateCheck> checks;
+    LeafHashes<HashStorageLeaf> storageLeaves;
+    LeafHashes<HashBalanceLeaf> balanceLeaves;
+    LeafHashes<HashAccountLeaf> accountLeaves;
+
+    explicit BlockMerkleUpdates(size_t numUpdates)
+    {
+        // The leaf hashes are written directly in the checks
+        checks.reserve(numUpdates);
+    }
+
+    void add(size_t txIndex, const char *tree, const StorageUpdate &update)
+    {
+        add(txIndex, tree, TREE_DEPTH_STORAGE, getStorageSlot(update), update);
+        storageLeaves.add(getLeafInputs(update.before), &checks.back().leafBefore);
+        storageLeaves.add(getLeafInputs(update.after), &checks.back().leafAfter);
+    }
+
+    void add(size_t txIndex, const char *tree, const BalanceUpdate &update)
+    {
+        add(txIndex, tree, TREE_DEPTH_TOKENS, update.tokenID, update);
+        balanceLeaves.add(getLeafInputs(update.before), &checks.back().leafBefore);
+        balanceLeaves.add(getLeafInputs(update.after), &checks.back().leafAfter);
+    }
+
+    void add(size_t txIndex, const char *tree, const AccountUpdate &update)
+    {
+        add(txIndex, tree, TREE_DEPTH_ACCOUNTS, update.accountID, update);
+        accountLeaves.add(getLeafInputs(update.before), &checks.back().leafBefore);
+        accountLeaves.add(getLeafInputs(update.after), &checks.back().leafAfter);
+    }
+
+    void hashLeaves()
+    {
+        storageLeaves.hash();
+        balanceLeaves.hash();
+        accountLeaves.hash();
+    }
+
+  private:
+    template <typename UpdateT>
+    void add(size_t txIndex, const char *tree, unsigned int depth, const FieldT &address, const UpdateT &update)
+    {
+        assert(checks.size() < checks.capacity());
+        MerkleUpdateCheck check;
+        check.txIndex = txIndex;
+        check.tree = tree;
+        check.depth = depth;
+        check.address = address;
+        check.proof = &update.proof;
+        check.rootBefore = &update.rootBefore;
+        check.rootAfter = &update.rootAfter;
+        checks.push_back(check);
+    }
+};
+
+// All updates of a transaction, in the same order as in TransactionGadget
+static const unsigned int NUM_MERKLE_UPDATES_PER_TX = 13;
+
+static void addTransactionUpdates(BlockMerkleUpdates &updates, const Witness &witness, size_t txIndex)
+{
+    updates.add(txIndex, "storage_A", witness.storageUpdate_A);
+    updates.add(txIndex, "balanceS_A", witness.balanceUpdateS_A);
+    updates.add(txIndex, "balanceB_A", witness.balanceUpdateB_A);
+    updates.add(txIndex, "account_A", witness.accountUpdate_A);
+    updates.add(txIndex, "storage_B", witness.storageUpdate_B);
+    updates.add(txIndex, "balanceS_B", witness.balanceUpdateS_B);
+    updates.add(txIndex, "balanceB_B", witness.balanceUpdateB_B);
+    updates.add(txIndex, "account_B", witness.accountUpdate_B);
+    updates.add(txIndex, "balanceB_O", witness.balanceUpdateB_O);
+    updates.add(txIndex, "balanceA_O", witness.balanceUpdateA_O);
+    updates.add(txIndex, "account_O", witness.accountUpdate_O);
+    updates.add(txIndex, "balanceB_P", witness.balanceUpdateB_P);
+    updates.add(txIndex, "balanceA_P", witness.balanceUpdateA_P);
+}
+
+// Checks the proofs of all updates. All leaves and all Merkle paths in the block
+// are hashed in batches. Returns the index of the first invalid update.
+static size_t checkUpdateProofs(BlockMerkleUpdates &updates, MerkleFailure &failure)
+{
+    std::vector<MerkleUpdateCheck> &checks = updates.checks;
+    updates.hashLeaves();
+
+    size_t numValid = checks.size();
+    std::vector<MerklePath> paths;
+    paths.reserve(checks.size() * 2);
+    for (size_t i = 0; i < checks.size(); i++)
+    {
+        const MerkleUpdateCheck &check = checks[i];
+        std::string error;
+        if (!checkProofShape(check.depth, check.address, *check.proof, error))
+        {
+            merkleCheckFailed(failure, check.txIndex, check.tree, error);
+            numValid = i;
+            break;
+        }
+        const unsigned long address = check.address.as_ulong();
+        paths.push_back({check.depth, address, &check.proof->data, check.leafBefore});
+        paths.push_back({check.depth, address, &check.proof->data, check.leafAfter});
+    }
+
+    computeMerkleRoots<HashMerkleTree>(paths);
+
+    for (size_t i = 0; i < numValid; i++)
+    {
+        const MerkleUpdateCheck &check = checks[i];
+        if (paths[i * 2 + 0].node != *check.rootBefore)
+        {
+            merkleCheckFailed(failure, check.txIndex, check.tree, "invalid proof for the leaf before");
+            return i;
+        }
+        if (paths[i * 2 + 1].node != *check.rootAfter)
+        {
+            merkleCheckFailed(failure, check.txIndex, check.tree, "invalid proof for the leaf after");
+            return i;
+        }
+    }
+    return numValid;
+}
+
+// Checks that the roots in a transaction chain correctly, in the same order
+// as the updates are done in TransactionGadget
+static bool checkTransactionRoots(
+  const Witness &witness,
+  size_t txIndex,
+  FieldT &accountsRoot,
+  FieldT &protocolBalancesRoot,
+  MerkleFailure &failure)
+{
+    // Account A
+    if (witness.storageUpdate_A.rootBefore != witness.balanceUpdateS_A.before.storageRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "storage_A", "root before does not match the balance leaf");
+    }
+    if (witness.storageUpdate_A.rootAfter != witness.balanceUpdateS_A.after.storageRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "storage_A", "root after does not match the balance leaf");
+    }
+    if (witness.balanceUpdateS_A.rootBefore != witness.accountUpdate_A.before.balancesRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceS_A", "root before does not match the account leaf");
+    }
+    if (witness.balanceUpdateB_A.rootBefore != witness.balanceUpdateS_A.rootAfter)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceB_A", "root before does not match the previous update");
+    }
+    if (witness.balanceUpdateB_A.rootAfter != witness.accountUpdate_A.after.balancesRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceB_A", "root after does not match the account leaf");
+    }
+    if (witness.accountUpdate_A.rootBefore != accountsRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "account_A", "root before does not match the previous update");
+    }
+    // Account B
+    if (witness.storageUpdate_B.rootBefore != witness.balanceUpdateS_B.before.storageRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "storage_B", "root before does not match the balance leaf");
+    }
+    if (witness.storageUpdate_B.rootAfter != witness.balanceUpdateS_B.after.storageRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "storage_B", "root after does not match the balance leaf");
+    }
+    if (witness.balanceUpdateS_B.rootBefore != witness.accountUpdate_B.before.balancesRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceS_B", "root before does not match the account leaf");
+    }
+    if (witness.balanceUpdateB_B.rootBefore != witness.balanceUpdateS_B.rootAfter)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceB_B", "root before does not match the previous update");
+    }
+    if (witness.balanceUpdateB_B.rootAfter != witness.accountUpdate_B.after.balancesRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceB_B", "root after does not match the account leaf");
+    }
+    if (witness.accountUpdate_B.rootBefore != witness.accountUpdate_A.rootAfter)
+    {
+        return merkleCheckFailed(failure, txIndex, "account_B", "root before does not match the previous update");
+    }
+    // Operator
+    if (witness.balanceUpdateB_O.rootBefore != witness.accountUpdate_O.before.balancesRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceB_O", "root before does not match the account leaf");
+    }
+    if (witness.balanceUpdateA_O.rootBefore != witness.balanceUpdateB_O.rootAfter)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceA_O", "root before does not match the previous update");
+    }
+    if (witness.balanceUpdateA_O.rootAfter != witness.accountUpdate_O.after.balancesRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceA_O", "root after does not match the account leaf");
+    }
+    if (witness.accountUpdate_O.rootBefore != witness.accountUpdate_B.rootAfter)
+    {
+        return merkleCheckFailed(failure, txIndex, "account_O", "root before does not match the previous update");
+    }
+    // Protocol fee pool (the account itself is only updated at the end of the block)
+    if (witness.balanceUpdateB_P.rootBefore != protocolBalancesRoot)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceB_P", "root before does not match the previous update");
+    }
+    if (witness.balanceUpdateA_P.rootBefore != witness.balanceUpdateB_P.rootAfter)
+    {
+        return merkleCheckFailed(failure, txIndex, "balanceA_P", "root before does not match the previous update");
+    }
+
+    accountsRoot = witness.accountUpdate_O.rootAfter;
+    protocolBalancesRoot = witness.balanceUpdateA_P.rootAfter;
+    return true;
+}
+
+// Checks that the roots of the updates done at the end of the block chain
+// correctly with the roots after the last transaction
+static bool checkBlockRoots(
+  const Block &block,
+  const FieldT &accountsRoot,
+  const FieldT &protocolBalancesRoot,
+  MerkleFailure &failure)
+{
+    const size_t i = block.transactions.size();
+    if (block.accountUpdate_P.rootBefore != accountsRoot)
+    {
+        return merkleCheckFailed(failure, i, "account_P", "root before does not match the previous update");
+    }
+    if (block.accountUpdate_P.after.balancesRoot != protocolBalancesRoot)
+    {
+        return merkleCheckFailed(failure, i, "account_P", "balances root does not match the protocol pool updates");
+    }
+    if (block.accountUpdate_O.rootBefore != block.accountUpdate_P.rootAfter)
+    {
+        return merkleCheckFailed(failure, i, "account_O", "root before does not match the previous update");
+    }
+    if (block.accountUpdate_O.rootAfter != block.merkleRootAfter)
+    {
+        return merkleCheckFailed(failure, i, "account_O", "root after does not match merkleRootAfter");
+    }
+    return true;
+}
+
+// Verifies all Merkle proofs in the block, and checks that the roots chain from
+// merkleRootBefore to merkleRootAfter. Reports the first (lowest transaction
+// index) failure.
+static bool checkMerkleProofs(const Block &block, MerkleFailure *failure = nullptr)
+{
+    const size_t numTransactions = block.transactions.size();
+
+    // The updates done at the end of the block are added as the last transaction
+    BlockMerkleUpdates updates(numTransactions * NUM_MERKLE_UPDATES_PER_TX + 2);
+    for (size_t i = 0; i < numTransactions; i++)
+    {
+        addTransactionUpdates(updates, block.transactions[i].witness, i);
+    }
+    updates.add(numTransactions, "account_P", block.accountUpdate_P);
+    updates.add(numTransactions, "account_O", block.accountUpdate_O);
+
+    MerkleFailure proofFailure;
+    const size_t firstInvalid = checkUpdateProofs(updates, proofFailure);
+    const size_t invalidTx =
+      (firstInvalid < updates.checks.size()) ? proofFailure.txIndex : std::numeric_limits<size_t>::max();
+
+    // The roots need to chain correctly, this is cheap so done sequentially.
+    // A chaining failure in an earlier transaction takes precedence.
+    FieldT accountsRoot = block.merkleRootBefore;
+    FieldT protocolBalancesRoot = block.accountUpdate_P.before.balancesRoot;
+    MerkleFailure chainFailure;
+    bool chainValid = true;
+    for (size_t i = 0; i < numTransactions && i < invalidTx; i++)
+    {
+        if (!checkTransactionRoots(block.transactions[i].witness, i, accountsRoot, protocolBalancesRoot, chainFailure))
+        {
+            chainValid = false;
+            break;
+        }
+    }
+    if (chainValid && invalidTx == std::numeric_limits<size_t>::max())
+    {
+        chainValid = checkBlockRoots(block, accountsRoot, protocolBalancesRoot, chainFailure);
+    }
+
+    if (!chainValid)
+    {
+        if (failure)
+        {
+            *failure = chainFailure;
+        }
+        return false;
+    }
+    if (invalidTx != std::numeric_limits<size_t>::max())
+    {
+        if (failure)
+        {
+            *failure = proofFailure;
+        }
+        return false;
+    }
+    return true;
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _POSEIDON_H_
+#define _POSEIDON_H_
+
+#include "ethsnarks.hpp"
+#include "gadgets/poseidon.hpp"
+
+#include <array>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Native (out-of-circuit) Poseidon hash with the exact same parameters and
+// constants as the gadget it is instantiated with, e.g.
+// PoseidonNative<Poseidon_4>::hash({a, b, c, d}).
+template <typename HashT> class PoseidonNative;
+
+template <
+  unsigned param_t,
+  unsigned param_c,
+  unsigned param_F,
+  unsigned param_P,
+  unsigned nInputs,
+  unsigned nOutputs,
+  bool constrainOutputs>
+class PoseidonNative<Poseidon_gadget_T<param_t, param_c, param_F, param_P, nInputs, nOutputs, constrainOutputs>>
+{
+  public:
+    using HashT = Poseidon_gadget_T<param_t, param_c, param_F, param_P, nInputs, nOutputs, constrainOutputs>;
+    using Inputs = std::array<FieldT, nInputs>;
+
+    static FieldT hash(const Inputs &inputs)
+    {
+        std::array<FieldT, param_t> state;
+        for (unsigned i = 0; i < param_t; i++)
+        {
+            state[i] = (i < nInputs) ? inputs[i] : FieldT::zero();
+        }
+        permute(state);
+        return state[0];
+    }
+
+    static void permute(std::array<FieldT, param_t> &state)
+    {
+        // Same constants as used by the gadget (these are only generated once)
+        const PoseidonConstants &constants = HashT::get_constants();
+        const unsigned partialRoundsBegin = param_F / 2;
+        const unsigned partialRoundsEnd = partialRoundsBegin + param_P;
+
+        std::array<FieldT, param_t> mixed;
+        for (unsigned round = 0; round < param_F + param_P; round++)
+        {
+            // Add the round constant
+            for (unsigned i = 0; i < param_t; i++)
+            {
+                state[i] += constants.C[round];
+            }
+
+            // x^5 S-box, on all elements in full rounds, only on the first
+            // element in partial rounds
+            const bool fullRound = (round < partialRoundsBegin) || (round >= partialRoundsEnd);
+            for (unsigned i = 0; i < (fullRound ? param_t : 1); i++)
+            {
+                const FieldT squared = state[i].squared();
+                state[i] = squared.squared() * state[i];
+            }
+
+            // Mix with the MDS matrix
+            for (unsigned i = 0; i < param_t; i++)
+            {
+                mixed[i] = FieldT::zero();
+                for (unsigned j = 0; j < param_t; j++)
+                {
+                    mixed[i] += constants.M[i * param_t + j] * state[j];
+                }
+            }
+            state = mixed;
+        }
+    }
+};
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _PROVERTIMINGS_H_
+#define _PROVERTIMINGS_H_
+
+#include "Data.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+
+#include <libff/common/profiling.hpp>
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+namespace Loopring
+{
+
+// The phases of the Groth16 prover, the profiling blocks of the prover are
+// mapped to them by name
+static const char *PROVER_PHASE_FFT = "fft";
+static const char *PROVER_PHASE_MSM_A = "msm_a";
+static const char *PROVER_PHASE_MSM_B_G1 = "msm_b_g1";
+static const char *PROVER_PHASE_MSM_B_G2 = "msm_b_g2";
+static const char *PROVER_PHASE_MSM_H = "msm_h";
+static const char *PROVER_PHASE_MSM_L = "msm_l";
+
+// Returns the phase of a profiling block, or nullptr when the block is not
+// part of a single phase (e.g. the block around the complete prover)
+static const char *getProverPhase(const std::string &block)
+{
+    auto contains = [&block](const char *text) { return block.find(text) != std::string::npos; };
+    if (contains("polynomial H") || contains("FFT"))
+    {
+        return PROVER_PHASE_FFT;
+    }
+    if (contains("A-query"))
+    {
+        return PROVER_PHASE_MSM_A;
+    }
+    if (contains("B-query"))
+    {
+        return (contains("G1") || contains("B1")) ? PROVER_PHASE_MSM_B_G1 : PROVER_PHASE_MSM_B_G2;
+    }
+    if (contains("H-query"))
+    {
+        return PROVER_PHASE_MSM_H;
+    }
+    if (contains("L-query") || contains("K-query"))
+    {
+        return PROVER_PHASE_MSM_L;
+    }
+    return nullptr;
+}
+
+struct ProverTimings
+{
+    double total_ms;
+    // The CPU time of all threads of the process together
+    double cpu_ms;
+    unsigned int num_threads;
+    // cpu_ms / (total_ms * num_threads), 1 when all threads were busy all the
+    // time
+    double thread_utilization;
+    // The time spent in each phase
+    std::map<std::string, double> phases;
+    // The time spent in each profiling block of the prover, blocks can be
+    // nested
+    std::map<std::string, double> blocks;
+};
+
+static void to_json(json &j, const ProverTimings &timings)
+{
+    j = json{
+      {"total_ms", timings.total_ms},
+      {"cpu_ms", timings.cpu_ms},
+      {"num_threads", timings.num_threads},
+      {"thread_utilization", timings.thread_utilization},
+      {"phases", timings.phases},
+      {"blocks", timings.blocks}};
+}
+
+static double getProcessCPUTime_ms()
+{
+    struct timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+    {
+        return 0.0;
+    }
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1e6;
+}
+
+// Measures the time spent in the prover between start() and stop()
+class ProverTimer
+{
+  public:
+    void start()
+    {
+        // The profiling blocks of libff accumulate their times (in ns)
+        cumulativeTimes = libff::cumulative_times;
+        cpuTime_ms = getProcessCPUTime_ms();
+        begin = std::chrono::steady_clock::now();
+    }
+
+    void stop(ProverTimings &timings) const
+    {
+        const auto end = std::chrono::steady_clock::now();
+        timings.total_ms = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - begin).count();
+        timings.cpu_ms = getProcessCPUTime_ms() - cpuTime_ms;
+#ifdef MULTICORE
+        timings.num_threads = omp_get_max_threads();
+#else
+        timings.num_threads = 1;
+#endif
+        timings.thread_utilization =
+          (timings.total_ms > 0.0) ? timings.cpu_ms / (timings.total_ms * timings.num_threads) : 0.0;
+
+        timings.phases.clear();
+        timings.blocks.clear();
+        for (const auto &block : libff::cumulative_times)
+        {
+            const auto it = cumulativeTimes.find(block.first);
+            const long long before = (it != cumulativeTimes.end()) ? it->second : 0;
+            if (block.second <= before)
+            {
+                continue;
+            }
+            const double duration_ms = (block.second - before) / 1e6;
+            timings.blocks[block.first] = duration_ms;
+            const char *phase = getProverPhase(block.first);
+            if (phase)
+            {
+                timings.phases[phase] += duration_ms;
+            }
+        }
+    }
+
+  private:
+    std::map<std::string, long long> cumulativeTimes;
+    double cpuTime_ms;
+    std::chrono::steady_clock::time_point begin;
+};
+
+// Adds the profiling blocks of the last proof to the trace. libff keeps the
+// start and the duration of the last call of every block.
+static void traceProverBlocks(const ProverTimings &timings)
+{
+    if (!Trace::isEnabled())
+    {
+        return;
+    }
+    for (const auto &block : timings.blocks)
+    {
+        const auto enterTime = libff::enter_times.find(block.first);
+        const auto lastTime = libff::last_times.find(block.first);
+        if (enterTime != libff::enter_times.end() && lastTime != libff::last_times.end())
+        {
+            Trace::addEvent(block.first, -1, enterTime->second, enterTime->second + lastTime->second);
+        }
+    }
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _SIGNATURECHECKER_H_
+#define _SIGNATURECHECKER_H_
+
+#include "Data.h"
+#include "Jubjub.h"
+#include "Poseidon.h"
+#include "../Gadgets/MathGadgets.h"
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <gmp.h>
+#include <limits>
+#include <random>
+#include <vector>
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Native (out-of-circuit) verification of Poseidon EdDSA signatures, with the
+// same semantics as EdDSA_Poseidon: B*s == R + A*H(R, A, M), with the hash
+// used as a full 254-bit scalar. Signatures are verified in batches using a
+// random linear combination so a whole block only needs a single multi-scalar
+// multiplication. A failing batch is bisected to find the invalid signature.
+// A batch can only pass with an invalid signature when points with a small
+// order component are used, these are still rejected by the circuit.
+
+struct SignatureCheck
+{
+    jubjub::EdwardsPoint publicKey;
+    FieldT message;
+    Signature signature;
+    // Only signatures that are required need to be valid, but R always needs
+    // to be a valid point
+    bool required;
+};
+
+static FieldT hashSignature(const SignatureCheck &check)
+{
+    return PoseidonNative<Poseidon_5>::hash(
+      {check.signature.R.x, check.signature.R.y, check.publicKey.x, check.publicKey.y, check.message});
+}
+
+// Exact verification of a single signature
+static bool verifySignature(const SignatureCheck &check, const FieldT &hash, const jubjub::Params &params)
+{
+    const ExtendedPoint base(params.Gx, params.Gy);
+    const ExtendedPoint lhs = scalarMul(base, toScalarBits(check.signature.s), params);
+    const ExtendedPoint At = scalarMul(ExtendedPoint(check.publicKey), toScalarBits(hash), params);
+    const ExtendedPoint rhs = ExtendedPoint(check.signature.R).add(At, params);
+    return lhs == rhs;
+}
+
+// Verifies checks[indices[begin..end)] at once by checking
+// sum(z_i * (R_i + A_i*h_i - B*s_i)) == 0 for random odd 128-bit z_i.
+// A batch with only valid signatures always passes.
+static bool verifySignatureBatch(
+  const std::vector<SignatureCheck> &checks,
+  const std::vector<FieldT> &hashes,
+  const std::vector<size_t> &indices,
+  size_t begin,
+  size_t end,
+  const jubjub::Params &params,
+  std::mt19937_64 &rng)
+{
+    std::vector<ExtendedPoint> points;
+    std::vector<ScalarBits> scalars;
+    points.reserve((end - begin) * 2 + 1);
+    scalars.reserve((end - begin) * 2 + 1);
+
+    mpz_t order, z, s, sumS, zh;
+    mpz_inits(order, z, s, sumS, zh, NULL);
+    mpz_set_str(order, JUBJUB_SUBGROUP_ORDER, 10);
+    mpz_set_ui(sumS, 0);
+    for (size_t i = begin; i < end; i++)
+    {
+        const SignatureCheck &check = checks[indices[i]];
+
+        mpz_set_ui(z, rng());
+        mpz_mul_2exp(z, z, 64);
+        mpz_add_ui(z, z, rng() | 1);
+
+        // B has the order of the subgroup so s can be reduced
+        check.signature.s.as_bigint().to_mpz(s);
+        mpz_addmul(sumS, z, s);
+        mpz_mod(sumS, sumS, order);
+
+        // R and A are not necessarily in the subgroup, so the scalars cannot
+        // be reduced
+        hashes[indices[i]].as_bigint().to_mpz(zh);
+        mpz_mul(zh, zh, z);
+
+        points.emplace_back(check.signature.R);
+        scalars.emplace_back(toScalarBits(z));
+        points.emplace_back(check.publicKey);
+        scalars.emplace_back(toScalarBits(zh));
+    }
+    points.emplace_back(ExtendedPoint(params.Gx, params.Gy).neg());
+    scalars.emplace_back(toScalarBits(sumS));
+    mpz_clears(order, z, s, sumS, zh, NULL);
+
+    return multiScalarMul(points, scalars, params).isIdentity();
+}
+
+// Finds the first invalid signature in checks[indices[begin..end)] by
+// bisection. Returns false if all signatures are valid.
+static bool findInvalidSignature(
+  const std::vector<SignatureCheck> &checks,
+  const std::vector<FieldT> &hashes,
+  const std::vector<size_t> &indices,
+  size_t begin,
+  size_t end,
+  const jubjub::Params &params,
+  std::mt19937_64 &rng,
+  size_t &invalid)
+{
+    if (end - begin == 1)
+    {
+        if (verifySignature(checks[indices[begin]], hashes[indices[begin]], params))
+        {
+            return false;
+        }
+        invalid = indices[begin];
+        return true;
+    }
+    if (verifySignatureBatch(checks, hashes, indices, begin, end, params, rng))
+    {
+        return false;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    return findInvalidSignature(checks, hashes, indices, begin, mid, params, rng, invalid) ||
+           findInvalidSignature(checks, hashes, indices, mid, end, params, rng, invalid);
+}
+
+// Verifies all signatures, the batches are verified in parallel.
+// Returns the index of the first invalid signature found.
+static bool checkSignatures(
+  const std::vector<SignatureCheck> &checks,
+  const jubjub::Params &params,
+  size_t *invalidIndex = nullptr)
+{
+    auto failed = [&](size_t index) {
+        if (invalidIndex)
+        {
+            *invalidIndex = index;
+        }
+        return false;
+    };
+
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < checks.size(); i++)
+    {
+        const SignatureCheck &check = checks[i];
+        if (!isOnCurve(check.signature.R, params))
+        {
+            return failed(i);
+        }
+        if (check.required)
+        {
+            if (!isOnCurve(check.publicKey, params))
+            {
+                return failed(i);
+            }
+            indices.push_back(i);
+        }
+    }
+
+    std::vector<FieldT> hashes(checks.size());
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        hashes[indices[i]] = hashSignature(checks[indices[i]]);
+    }
+
+#ifdef MULTICORE
+    const size_t numBatches = std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), indices.size()));
+#else
+    const size_t numBatches = 1;
+#endif
+    const size_t batchSize = (indices.size() + numBatches - 1) / std::max<size_t>(1, numBatches);
+    std::vector<size_t> invalid(numBatches, std::numeric_limits<size_t>::max());
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+    for (size_t b = 0; b < numBatches; b++)
+    {
+        const size_t begin = std::min(indices.size(), b * batchSize);
+        const size_t end = std::min(indices.size(), begin + batchSize);
+        if (begin == end)
+        {
+            continue;
+        }
+        std::random_device rd;
+        std::mt19937_64 rng((uint64_t(rd()) << 32) | rd());
+        size_t index;
+        if (findInvalidSignature(checks, hashes, indices, begin, end, params, rng, index))
+        {
+            invalid[b] = index;
+        }
+    }
+    const size_t firstInvalid = *std::min_element(invalid.begin(), invalid.end());
+    if (firstInvalid != std::numeric_limits<size_t>::max())
+    {
+        return failed(firstInvalid);
+    }
+    return true;
+}
+
+} // namespace Loopring
+
+#endif
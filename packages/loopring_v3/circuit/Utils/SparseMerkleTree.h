@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _SPARSEMERKLETREE_H_
+#define _SPARSEMERKLETREE_H_
+
+#include "Constants.h"
+#include "Data.h"
+#include "MerkleChecker.h"
+#include "Poseidon.h"
+#include "../Gadgets/MerkleTree.h"
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// Native sparse quad Merkle tree, the same tree as
+// operator/sparse_merkle_tree.py. The nodes are hashed with HashMerkleTree
+// and the proofs have the layout used by merkle_path_compute_4 (3 siblings per
+// level, starting at the leaves). Only the nodes that are different from the
+// nodes of the empty tree are stored.
+class SparseMerkleTree
+{
+  public:
+    using Leaves = std::vector<std::pair<unsigned long, FieldT>>;
+
+    SparseMerkleTree(unsigned int _depth, const FieldT &defaultLeaf) : depth(_depth), nodes(_depth + 1)
+    {
+        defaultNodes.push_back(defaultLeaf);
+        for (unsigned int i = 0; i < depth; i++)
+        {
+            const FieldT &node = defaultNodes.back();
+            defaultNodes.push_back(PoseidonNative<HashMerkleTree>::hash({node, node, node, node}));
+        }
+    }
+
+    unsigned int getDepth() const
+    {
+        return depth;
+    }
+
+    unsigned long getNumLeaves() const
+    {
+        return 1UL << (2 * depth);
+    }
+
+    const FieldT &getRoot() const
+    {
+        return getNode(depth, 0);
+    }
+
+    const FieldT &get(unsigned long address) const
+    {
+        assert(address < getNumLeaves());
+        return getNode(0, address);
+    }
+
+    // The node on the given level (the leaves are on level 0)
+    const FieldT &getNode(unsigned int level, unsigned long index) const
+    {
+        auto it = nodes[level].find(index);
+        return (it != nodes[level].end()) ? it->second : defaultNodes[level];
+    }
+
+    // The node on the given level of the empty tree
+    const FieldT &getDefaultNode(unsigned int level) const
+    {
+        return defaultNodes[level];
+    }
+
+    // Sets a node that was computed before (e.g. when the tree is loaded from
+    // a StateStore) without updating its parents
+    void restoreNode(unsigned int level, unsigned long index, const FieldT &value)
+    {
+        setNode(level, index, value);
+    }
+
+    Proof createProof(unsigned long address) const
+    {
+        assert(address < getNumLeaves());
+        Proof proof;
+        proof.data.reserve(depth * 3);
+        for (unsigned int level = 0; level < depth; level++)
+        {
+            const unsigned long index = address >> (2 * level);
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                if (c != (index & 3))
+                {
+                    proof.data.push_back(getNode(level, (index & ~3UL) | c));
+                }
+            }
+        }
+        return proof;
+    }
+
+    bool verifyProof(const Proof &proof, unsigned long address, const FieldT &leaf) const
+    {
+        return proof.data.size() == depth * 3 &&
+               computeMerkleRoot<HashMerkleTree>(depth, FieldT(address), leaf, proof.data) == getRoot();
+    }
+
+    void update(unsigned long address, const FieldT &leaf)
+    {
+        update(Leaves{{address, leaf}});
+    }
+
+    // Updates many leaves at once (the last value is used for duplicate
+    // addresses). The tree is recomputed one level at a time, the parents of
+    // all changed nodes on a level are hashed together in parallel.
+    void update(const Leaves &leaves)
+    {
+        std::vector<unsigned long> changed;
+        changed.reserve(leaves.size());
+        for (const auto &leaf : leaves)
+        {
+            assert(leaf.first < getNumLeaves());
+            setNode(0, leaf.first, leaf.second);
+            changed.push_back(leaf.first);
+        }
+
+        std::vector<PoseidonNative<HashMerkleTree>::Inputs> inputs;
+        std::vector<FieldT> hashes;
+        for (unsigned int level = 0; level < depth; level++)
+        {
+            for (unsigned long &index : changed)
+            {
+                index >>= 2;
+            }
+            std::sort(changed.begin(), changed.end());
+            changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+            inputs.resize(changed.size());
+            for (size_t i = 0; i < changed.size(); i++)
+            {
+                for (unsigned int c = 0; c < 4; c++)
+                {
+                    inputs[i][c] = getNode(level, changed[i] * 4 + c);
+                }
+            }
+            hashes.resize(changed.size());
+#ifdef MULTICORE
+#pragma omp parallel for
+#endif
+            for (size_t i = 0; i < changed.size(); i++)
+            {
+                hashes[i] = PoseidonNative<HashMerkleTree>::hash(inputs[i]);
+            }
+            for (size_t i = 0; i < changed.size(); i++)
+            {
+                setNode(level + 1, changed[i], hashes[i]);
+            }
+        }
+    }
+
+  private:
+    unsigned int depth;
+    // The nodes of the empty tree on every level (the leaves are on level 0)
+    std::vector<FieldT> defaultNodes;
+    std::vector<std::unordered_map<unsigned long, FieldT>> nodes;
+
+    void setNode(unsigned int level, unsigned long index, const FieldT &value)
+    {
+        if (value == defaultNodes[level])
+        {
+            nodes[level].erase(index);
+        }
+        else
+        {
+            nodes[level][index] = value;
+        }
+    }
+};
+
+// The default leaves, the same as used by the operator
+static StorageLeaf getDefaultStorageLeaf()
+{
+    StorageLeaf leaf;
+    leaf.data = FieldT::zero();
+    leaf.storageID = FieldT::zero();
+    return leaf;
+}
+
+static BalanceLeaf getDefaultBalanceLeaf(const FieldT &emptyStorageRoot)
+{
+    BalanceLeaf leaf;
+    leaf.balance = FieldT::zero();
+    leaf.weightAMM = FieldT::zero();
+    leaf.storageRoot = emptyStorageRoot;
+    return leaf;
+}
+
+static AccountLeaf getDefaultAccountLeaf(const FieldT &emptyBalancesRoot)
+{
+    AccountLeaf leaf;
+    leaf.owner = FieldT::zero();
+    leaf.publicKey.x = FieldT::zero();
+    leaf.publicKey.y = FieldT::zero();
+    leaf.nonce = FieldT::zero();
+    leaf.feeBipsAMM = FieldT::zero();
+    leaf.balancesRoot = emptyBalancesRoot;
+    return leaf;
+}
+
+// The empty trees of the state
+static SparseMerkleTree newStorageTree()
+{
+    return SparseMerkleTree(TREE_DEPTH_STORAGE, hashStorageLeaf(getDefaultStorageLeaf()));
+}
+
+static SparseMerkleTree newBalancesTree(const FieldT &emptyStorageRoot)
+{
+    return SparseMerkleTree(TREE_DEPTH_TOKENS, hashBalanceLeaf(getDefaultBalanceLeaf(emptyStorageRoot)));
+}
+
+static SparseMerkleTree newAccountsTree(const FieldT &emptyBalancesRoot)
+{
+    return SparseMerkleTree(TREE_DEPTH_ACCOUNTS, hashAccountLeaf(getDefaultAccountLeaf(emptyBalancesRoot)));
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,884 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _STATESTORE_H_
+#define _STATESTORE_H_
+
+#include "BlockBuilder.h"
+#include "Constants.h"
+#include "Data.h"
+#include "Log.h"
+#include "SparseMerkleTree.h"
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// A file mapped into memory. The whole address range is reserved when the file
+// is opened so the mapping never moves when the file grows, pointers into the
+// file stay valid while it is open.
+class MappedFile
+{
+  public:
+    MappedFile() : fd(-1), data(nullptr), maxSize(0), fileSize(0)
+    {
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &filename, uint64_t _maxSize)
+    {
+        close();
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            LOG_ERROR("Cannot open file: " << filename);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || uint64_t(st.st_size) > _maxSize)
+        {
+            LOG_ERROR("Invalid file size: " << filename);
+            close();
+            return false;
+        }
+        void *ptr = mmap(nullptr, _maxSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            LOG_ERROR("Cannot map file: " << filename);
+            close();
+            return false;
+        }
+        data = static_cast<uint8_t *>(ptr);
+        maxSize = _maxSize;
+        fileSize = st.st_size;
+        return true;
+    }
+
+    void close()
+    {
+        if (data != nullptr)
+        {
+            munmap(data, maxSize);
+            data = nullptr;
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+        maxSize = 0;
+        fileSize = 0;
+    }
+
+    bool isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    uint8_t *getData() const
+    {
+        return data;
+    }
+
+    uint64_t getSize() const
+    {
+        return fileSize;
+    }
+
+    bool resize(uint64_t size)
+    {
+        if (size > maxSize || ftruncate(fd, size) != 0)
+        {
+            LOG_ERROR("Cannot resize file to " << size << " bytes");
+            return false;
+        }
+        fileSize = size;
+        return true;
+    }
+
+    // Writes the given range back to the file
+    bool sync(uint64_t offset, uint64_t size)
+    {
+        const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+        const uint64_t start = offset - (offset % pageSize);
+        if (msync(data + start, offset + size - start, MS_SYNC) != 0)
+        {
+            LOG_ERROR("Cannot sync file");
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    int fd;
+    uint8_t *data;
+    uint64_t maxSize;
+    uint64_t fileSize;
+};
+
+// The records in the state store. Every record starts with its hash, records
+// are referenced by their offset in the file and offset 0 is the empty
+// (default) subtree. Field elements are stored in their in-memory format, so a
+// store can only be used by the same build of the prover.
+struct StoreNode
+{
+    FieldT hash;
+    uint64_t children[4];
+};
+
+struct StoreStorageLeaf
+{
+    FieldT hash;
+    FieldT data;
+    FieldT storageID;
+};
+
+struct StoreBalanceLeaf
+{
+    FieldT hash;
+    FieldT balance;
+    FieldT weightAMM;
+    uint64_t storageRoot;
+};
+
+struct StoreAccountLeaf
+{
+    FieldT hash;
+    FieldT owner;
+    FieldT publicKeyX;
+    FieldT publicKeyY;
+    FieldT nonce;
+    FieldT feeBipsAMM;
+    uint64_t balancesRoot;
+};
+
+struct StoreSnapshot
+{
+    uint64_t blockIdx;
+    uint64_t accountsRoot;
+    // The snapshot of the previous commit, 0 for the first one
+    uint64_t previous;
+};
+
+struct StoreHeader
+{
+    uint64_t magic;
+    uint64_t version;
+    // The end of the committed records, everything after it is overwritten on
+    // the next commit
+    std::atomic<uint64_t> size;
+    // The last committed snapshot, 0 when nothing was committed yet
+    std::atomic<uint64_t> latestSnapshot;
+};
+
+static const uint64_t STATE_STORE_MAGIC = 0x3145544154534c52; // "LRSTATE1"
+static const uint64_t STATE_STORE_VERSION = 1;
+// The records start on the page after the header
+static const uint64_t STATE_STORE_HEADER_SIZE = 4096;
+static const uint64_t STATE_STORE_GROW_SIZE = 64ULL << 20;
+static const uint64_t STATE_STORE_MAX_SIZE = 1ULL << 40;
+
+class StateSnapshot;
+
+// Persistent store of the exchange state with a snapshot for every committed
+// block. The trees are stored in an append-only memory mapped file, a commit
+// only writes new nodes on the paths to the leaves that changed and shares all
+// other nodes with the previous snapshots (copy-on-write). Snapshots are never
+// modified after they are committed, so the prover can read snapshot N - 1
+// while block N + 1 is committed. Only a single thread may commit.
+class StateStore
+{
+  public:
+    StateStore()
+        : emptyStorageTree(newStorageTree()),
+          emptyBalancesTree(newBalancesTree(emptyStorageTree.getRoot())),
+          emptyAccountsTree(newAccountsTree(emptyBalancesTree.getRoot())),
+          end(0)
+    {
+    }
+
+    // Opens the store, a new store is created if the file does not exist
+    bool open(const std::string &filename, uint64_t maxSize = STATE_STORE_MAX_SIZE)
+    {
+        if (!file.open(filename, maxSize))
+        {
+            return false;
+        }
+        if (file.getSize() == 0)
+        {
+            if (!file.resize(STATE_STORE_HEADER_SIZE + STATE_STORE_GROW_SIZE))
+            {
+                return false;
+            }
+            StoreHeader *header = getHeader();
+            header->magic = STATE_STORE_MAGIC;
+            header->version = STATE_STORE_VERSION;
+            header->size.store(STATE_STORE_HEADER_SIZE);
+            header->latestSnapshot.store(0);
+            if (!file.sync(0, sizeof(StoreHeader)))
+            {
+                return false;
+            }
+        }
+        // The header can only be read when the file is large enough
+        if (
+          file.getSize() < STATE_STORE_HEADER_SIZE || getHeader()->magic != STATE_STORE_MAGIC ||
+          getHeader()->version != STATE_STORE_VERSION || getHeader()->size.load() > file.getSize())
+        {
+            LOG_ERROR("Invalid state store: " << filename);
+            file.close();
+            return false;
+        }
+        end = getHeader()->size.load();
+        return true;
+    }
+
+    bool getLatestSnapshot(StateSnapshot &snapshot) const;
+
+    bool getSnapshot(uint64_t blockIdx, StateSnapshot &snapshot) const;
+
+    // Stores the state after block blockIdx as a new snapshot. Only the leaves
+    // that changed since the last commit are written, the hashes are taken from
+    // the trees of the state. The changes of the state are cleared.
+    bool commit(uint64_t blockIdx, ExchangeState &state)
+    {
+        const StoreHeader *header = getHeader();
+        const uint64_t previous = header->latestSnapshot.load(std::memory_order_acquire);
+        const uint64_t rootBefore = (previous != 0) ? get<StoreSnapshot>(previous)->accountsRoot : 0;
+
+        std::vector<unsigned long> accountIDs(state.getChangedAccounts().begin(), state.getChangedAccounts().end());
+        std::sort(accountIDs.begin(), accountIDs.end());
+        std::vector<std::pair<unsigned long, uint64_t>> accountLeaves;
+        for (unsigned long accountID : accountIDs)
+        {
+            const uint64_t before = findLeaf(rootBefore, TREE_DEPTH_ACCOUNTS, accountID);
+            uint64_t leaf = 0;
+            if (!writeAccount(state, accountID, before, leaf))
+            {
+                return false;
+            }
+            accountLeaves.emplace_back(accountID, leaf);
+        }
+        uint64_t accountsRoot = rootBefore;
+        if (!accountLeaves.empty())
+        {
+            if (!writeTree(
+                  rootBefore,
+                  TREE_DEPTH_ACCOUNTS,
+                  0,
+                  accountLeaves,
+                  0,
+                  accountLeaves.size(),
+                  state.getAccountsTree(),
+                  accountsRoot))
+            {
+                return false;
+            }
+        }
+        assert(getHash(accountsRoot, TREE_DEPTH_ACCOUNTS, emptyAccountsTree) == state.getRoot());
+
+        StoreSnapshot snapshot;
+        snapshot.blockIdx = blockIdx;
+        snapshot.accountsRoot = accountsRoot;
+        snapshot.previous = previous;
+        uint64_t snapshotOffset = 0;
+        if (!append(snapshot, snapshotOffset))
+        {
+            return false;
+        }
+
+        // Publish the snapshot only after all its records are written
+        const uint64_t committed = header->size.load();
+        if (!file.sync(committed, end - committed))
+        {
+            return false;
+        }
+        getHeader()->size.store(end);
+        getHeader()->latestSnapshot.store(snapshotOffset, std::memory_order_release);
+        if (!file.sync(0, sizeof(StoreHeader)))
+        {
+            return false;
+        }
+
+        state.clearChanges();
+        return true;
+    }
+
+    // Low level access used by StateSnapshot
+
+    template <typename T> const T *get(uint64_t offset) const
+    {
+        return reinterpret_cast<const T *>(file.getData() + offset);
+    }
+
+    const SparseMerkleTree &getEmptyTree(unsigned int depth) const
+    {
+        if (depth == TREE_DEPTH_STORAGE)
+        {
+            return emptyStorageTree;
+        }
+        return (depth == TREE_DEPTH_TOKENS) ? emptyBalancesTree : emptyAccountsTree;
+    }
+
+    // The hash of the node at the given level
+    FieldT getHash(uint64_t offset, unsigned int level, const SparseMerkleTree &emptyTree) const
+    {
+        return (offset != 0) ? *get<FieldT>(offset) : emptyTree.getDefaultNode(level);
+    }
+
+    // The leaf record at the given address, 0 if the leaf is the default leaf
+    uint64_t findLeaf(uint64_t root, unsigned int depth, unsigned long address) const
+    {
+        uint64_t offset = root;
+        for (unsigned int level = depth; level > 0 && offset != 0; level--)
+        {
+            offset = get<StoreNode>(offset)->children[(address >> (2 * (level - 1))) & 3];
+        }
+        return offset;
+    }
+
+    Proof createProof(uint64_t root, unsigned int depth, unsigned long address) const
+    {
+        const SparseMerkleTree &emptyTree = getEmptyTree(depth);
+        // The nodes on the path to the leaf, starting at the root
+        std::vector<uint64_t> path(depth + 1, 0);
+        path[depth] = root;
+        for (unsigned int level = depth; level > 0 && path[level] != 0; level--)
+        {
+            path[level - 1] = get<StoreNode>(path[level])->children[(address >> (2 * (level - 1))) & 3];
+        }
+
+        Proof proof;
+        proof.data.reserve(depth * 3);
+        for (unsigned int level = 0; level < depth; level++)
+        {
+            const uint64_t parent = path[level + 1];
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                if (c != ((address >> (2 * level)) & 3))
+                {
+                    const uint64_t child = (parent != 0) ? get<StoreNode>(parent)->children[c] : 0;
+                    proof.data.push_back(getHash(child, level, emptyTree));
+                }
+            }
+        }
+        return proof;
+    }
+
+    // Calls f(level, index, offset) for every stored node of the tree
+    template <typename F>
+    void visitTree(uint64_t offset, unsigned int level, unsigned long index, const F &f) const
+    {
+        if (offset == 0)
+        {
+            return;
+        }
+        f(level, index, offset);
+        if (level > 0)
+        {
+            const StoreNode *node = get<StoreNode>(offset);
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                visitTree(node->children[c], level - 1, index * 4 + c, f);
+            }
+        }
+    }
+
+  private:
+    MappedFile file;
+    // Only used for the default nodes
+    SparseMerkleTree emptyStorageTree;
+    SparseMerkleTree emptyBalancesTree;
+    SparseMerkleTree emptyAccountsTree;
+    // The end of the written records
+    uint64_t end;
+
+    StoreHeader *getHeader()
+    {
+        return reinterpret_cast<StoreHeader *>(file.getData());
+    }
+
+    const StoreHeader *getHeader() const
+    {
+        return reinterpret_cast<const StoreHeader *>(file.getData());
+    }
+
+    template <typename T> bool append(const T &record, uint64_t &offset)
+    {
+        if (end + sizeof(T) > file.getSize())
+        {
+            if (!file.resize(std::max(end + sizeof(T), file.getSize() + STATE_STORE_GROW_SIZE)))
+            {
+                return false;
+            }
+        }
+        std::memcpy(file.getData() + end, &record, sizeof(T));
+        offset = end;
+        end += sizeof(T);
+        return true;
+    }
+
+    // Writes the nodes on the paths to the changed leaves (sorted by address)
+    // on top of the tree at node. All other nodes are shared with the old tree.
+    // Subtrees that are the same as the empty tree are not stored.
+    bool writeTree(
+      uint64_t node,
+      unsigned int level,
+      unsigned long index,
+      const std::vector<std::pair<unsigned long, uint64_t>> &leaves,
+      size_t begin,
+      size_t endLeaves,
+      const SparseMerkleTree &tree,
+      uint64_t &offset)
+    {
+        if (level == 0)
+        {
+            offset = leaves[begin].second;
+            return true;
+        }
+        const FieldT &hash = tree.getNode(level, index);
+        if (hash == tree.getDefaultNode(level))
+        {
+            offset = 0;
+            return true;
+        }
+
+        StoreNode newNode;
+        newNode.hash = hash;
+        for (unsigned int c = 0; c < 4; c++)
+        {
+            newNode.children[c] = (node != 0) ? get<StoreNode>(node)->children[c] : 0;
+        }
+        size_t i = begin;
+        for (unsigned int c = 0; c < 4; c++)
+        {
+            const unsigned long childIndex = index * 4 + c;
+            size_t j = i;
+            while (j < endLeaves && (leaves[j].first >> (2 * (level - 1))) == childIndex)
+            {
+                j++;
+            }
+            if (j > i)
+            {
+                if (!writeTree(newNode.children[c], level - 1, childIndex, leaves, i, j, tree, newNode.children[c]))
+                {
+                    return false;
+                }
+                i = j;
+            }
+        }
+        return append(newNode, offset);
+    }
+
+    bool writeAccount(ExchangeState &state, unsigned long accountID, uint64_t before, uint64_t &offset)
+    {
+        ExchangeAccount &account = state.getAccount(accountID);
+        const FieldT &hash = state.getAccountsTree().get(accountID);
+        const uint64_t balancesBefore = (before != 0) ? get<StoreAccountLeaf>(before)->balancesRoot : 0;
+
+        std::vector<unsigned long> tokenIDs(account.changedBalances.begin(), account.changedBalances.end());
+        std::sort(tokenIDs.begin(), tokenIDs.end());
+        std::vector<std::pair<unsigned long, uint64_t>> balanceLeaves;
+        for (unsigned long tokenID : tokenIDs)
+        {
+            const uint64_t balanceBefore = findLeaf(balancesBefore, TREE_DEPTH_TOKENS, tokenID);
+            uint64_t leaf = 0;
+            if (!writeBalance(state, account, tokenID, balanceBefore, leaf))
+            {
+                return false;
+            }
+            balanceLeaves.emplace_back(tokenID, leaf);
+        }
+        uint64_t balancesRoot = balancesBefore;
+        if (!balanceLeaves.empty())
+        {
+            if (!writeTree(
+                  balancesBefore,
+                  TREE_DEPTH_TOKENS,
+                  0,
+                  balanceLeaves,
+                  0,
+                  balanceLeaves.size(),
+                  account.balancesTree,
+                  balancesRoot))
+            {
+                return false;
+            }
+        }
+
+        if (hash == emptyAccountsTree.getDefaultNode(0))
+        {
+            offset = 0;
+            return true;
+        }
+        StoreAccountLeaf leaf;
+        leaf.hash = hash;
+        leaf.owner = account.owner;
+        leaf.publicKeyX = account.publicKey.x;
+        leaf.publicKeyY = account.publicKey.y;
+        leaf.nonce = account.nonce;
+        leaf.feeBipsAMM = account.feeBipsAMM;
+        leaf.balancesRoot = balancesRoot;
+        return append(leaf, offset);
+    }
+
+    bool writeBalance(
+      ExchangeState &state,
+      ExchangeAccount &account,
+      unsigned long tokenID,
+      uint64_t before,
+      uint64_t &offset)
+    {
+        const ExchangeBalance &balance = state.getBalance(account, tokenID);
+        const FieldT &hash = account.balancesTree.get(tokenID);
+        const uint64_t storageBefore = (before != 0) ? get<StoreBalanceLeaf>(before)->storageRoot : 0;
+
+        std::vector<unsigned long> addresses(balance.changedStorage.begin(), balance.changedStorage.end());
+        std::sort(addresses.begin(), addresses.end());
+        std::vector<std::pair<unsigned long, uint64_t>> storageLeaves;
+        for (unsigned long address : addresses)
+        {
+            const FieldT &storageHash = balance.storageTree.get(address);
+            uint64_t leaf = 0;
+            if (storageHash != emptyStorageTree.getDefaultNode(0))
+            {
+                const StorageLeaf storage = balance.getStorage(address);
+                StoreStorageLeaf storageLeaf;
+                storageLeaf.hash = storageHash;
+                storageLeaf.data = storage.data;
+                storageLeaf.storageID = storage.storageID;
+                if (!append(storageLeaf, leaf))
+                {
+                    return false;
+                }
+            }
+            storageLeaves.emplace_back(address, leaf);
+        }
+        uint64_t storageRoot = storageBefore;
+        if (!storageLeaves.empty())
+        {
+            if (!writeTree(
+                  storageBefore,
+                  TREE_DEPTH_STORAGE,
+                  0,
+                  storageLeaves,
+                  0,
+                  storageLeaves.size(),
+                  balance.storageTree,
+                  storageRoot))
+            {
+                return false;
+            }
+        }
+
+        if (hash == emptyBalancesTree.getDefaultNode(0))
+        {
+            offset = 0;
+            return true;
+        }
+        StoreBalanceLeaf leaf;
+        leaf.hash = hash;
+        leaf.balance = balance.balance;
+        leaf.weightAMM = balance.weightAMM;
+        leaf.storageRoot = storageRoot;
+        return append(leaf, offset);
+    }
+};
+
+// Read-only view of the state after a committed block. Stays valid while the
+// store is open. Can be used as the source of an ExchangeState, then only the
+// accounts used by the blocks built on it are read.
+class StateSnapshot : public StateSource
+{
+  public:
+    StateSnapshot() : store(nullptr), blockIdx(0), accountsRoot(0)
+    {
+    }
+
+    StateSnapshot(const StateStore &_store, const StoreSnapshot &snapshot)
+        : store(&_store), blockIdx(snapshot.blockIdx), accountsRoot(snapshot.accountsRoot)
+    {
+    }
+
+    uint64_t getBlockIdx() const
+    {
+        return blockIdx;
+    }
+
+    FieldT getRoot() const override
+    {
+        return store->getHash(accountsRoot, TREE_DEPTH_ACCOUNTS, store->getEmptyTree(TREE_DEPTH_ACCOUNTS));
+    }
+
+    AccountLeaf getAccountLeaf(unsigned long accountID) const
+    {
+        const uint64_t offset = findAccount(accountID);
+        if (offset == 0)
+        {
+            return getDefaultAccountLeaf(store->getEmptyTree(TREE_DEPTH_TOKENS).getRoot());
+        }
+        const StoreAccountLeaf *leaf = store->get<StoreAccountLeaf>(offset);
+        AccountLeaf accountLeaf;
+        accountLeaf.owner = leaf->owner;
+        accountLeaf.publicKey.x = leaf->publicKeyX;
+        accountLeaf.publicKey.y = leaf->publicKeyY;
+        accountLeaf.nonce = leaf->nonce;
+        accountLeaf.feeBipsAMM = leaf->feeBipsAMM;
+        accountLeaf.balancesRoot =
+          store->getHash(leaf->balancesRoot, TREE_DEPTH_TOKENS, store->getEmptyTree(TREE_DEPTH_TOKENS));
+        return accountLeaf;
+    }
+
+    BalanceLeaf getBalanceLeaf(unsigned long accountID, unsigned long tokenID) const
+    {
+        const uint64_t offset = findBalance(accountID, tokenID);
+        if (offset == 0)
+        {
+            return getDefaultBalanceLeaf(store->getEmptyTree(TREE_DEPTH_STORAGE).getRoot());
+        }
+        const StoreBalanceLeaf *leaf = store->get<StoreBalanceLeaf>(offset);
+        BalanceLeaf balanceLeaf;
+        balanceLeaf.balance = leaf->balance;
+        balanceLeaf.weightAMM = leaf->weightAMM;
+        balanceLeaf.storageRoot =
+          store->getHash(leaf->storageRoot, TREE_DEPTH_STORAGE, store->getEmptyTree(TREE_DEPTH_STORAGE));
+        return balanceLeaf;
+    }
+
+    StorageLeaf getStorageLeaf(unsigned long accountID, unsigned long tokenID, unsigned long address) const
+    {
+        const uint64_t balance = findBalance(accountID, tokenID);
+        const uint64_t storageRoot = (balance != 0) ? store->get<StoreBalanceLeaf>(balance)->storageRoot : 0;
+        const uint64_t offset = store->findLeaf(storageRoot, TREE_DEPTH_STORAGE, address);
+        if (offset == 0)
+        {
+            return getDefaultStorageLeaf();
+        }
+        const StoreStorageLeaf *leaf = store->get<StoreStorageLeaf>(offset);
+        StorageLeaf storageLeaf;
+        storageLeaf.data = leaf->data;
+        storageLeaf.storageID = leaf->storageID;
+        return storageLeaf;
+    }
+
+    Proof createAccountProof(unsigned long accountID) const
+    {
+        return store->createProof(accountsRoot, TREE_DEPTH_ACCOUNTS, accountID);
+    }
+
+    Proof createBalanceProof(unsigned long accountID, unsigned long tokenID) const
+    {
+        const uint64_t account = findAccount(accountID);
+        const uint64_t balancesRoot = (account != 0) ? store->get<StoreAccountLeaf>(account)->balancesRoot : 0;
+        return store->createProof(balancesRoot, TREE_DEPTH_TOKENS, tokenID);
+    }
+
+    // Loads the complete state of the snapshot into an empty ExchangeState.
+    // The stored hashes are used, nothing is rehashed.
+    void load(ExchangeState &state) const
+    {
+        SparseMerkleTree &accountsTree = state.getAccountsTree();
+        store->visitTree(
+          accountsRoot, TREE_DEPTH_ACCOUNTS, 0, [&](unsigned int level, unsigned long accountID, uint64_t offset) {
+              accountsTree.restoreNode(level, accountID, *store->get<FieldT>(offset));
+              if (level == 0)
+              {
+                  readAccount(state, state.getAccount(accountID), *store->get<StoreAccountLeaf>(offset));
+              }
+          });
+        state.clearChanges();
+    }
+
+    // Restores the nodes on the path to the account and their siblings (the
+    // nodes the proof of the account needs). Nodes below accounts that were
+    // loaded before are skipped, they may have been updated since.
+    void loadAccount(ExchangeState &state, unsigned long accountID, ExchangeAccount &account) const override
+    {
+        SparseMerkleTree &accountsTree = state.getAccountsTree();
+        const SparseMerkleTree &emptyTree = store->getEmptyTree(TREE_DEPTH_ACCOUNTS);
+        uint64_t offset = accountsRoot;
+        for (unsigned int level = TREE_DEPTH_ACCOUNTS; level > 0 && offset != 0; level--)
+        {
+            const StoreNode *node = store->get<StoreNode>(offset);
+            const unsigned long index = accountID >> (2 * level);
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                const unsigned long childIndex = index * 4 + c;
+                if (!state.isLoaded(level - 1, childIndex))
+                {
+                    accountsTree.restoreNode(
+                      level - 1, childIndex, store->getHash(node->children[c], level - 1, emptyTree));
+                }
+            }
+            offset = node->children[(accountID >> (2 * (level - 1))) & 3];
+        }
+        if (offset != 0)
+        {
+            readAccount(state, account, *store->get<StoreAccountLeaf>(offset));
+        }
+    }
+
+  private:
+    const StateStore *store;
+    uint64_t blockIdx;
+    uint64_t accountsRoot;
+
+    uint64_t findAccount(unsigned long accountID) const
+    {
+        return store->findLeaf(accountsRoot, TREE_DEPTH_ACCOUNTS, accountID);
+    }
+
+    uint64_t findBalance(unsigned long accountID, unsigned long tokenID) const
+    {
+        const uint64_t account = findAccount(accountID);
+        const uint64_t balancesRoot = (account != 0) ? store->get<StoreAccountLeaf>(account)->balancesRoot : 0;
+        return store->findLeaf(balancesRoot, TREE_DEPTH_TOKENS, tokenID);
+    }
+
+    void readAccount(ExchangeState &state, ExchangeAccount &account, const StoreAccountLeaf &leaf) const
+    {
+        account.owner = leaf.owner;
+        account.publicKey.x = leaf.publicKeyX;
+        account.publicKey.y = leaf.publicKeyY;
+        account.nonce = leaf.nonce;
+        account.feeBipsAMM = leaf.feeBipsAMM;
+        store->visitTree(
+          leaf.balancesRoot, TREE_DEPTH_TOKENS, 0, [&](unsigned int level, unsigned long tokenID, uint64_t offset) {
+              account.balancesTree.restoreNode(level, tokenID, *store->get<FieldT>(offset));
+              if (level == 0)
+              {
+                  const StoreBalanceLeaf &balanceLeaf = *store->get<StoreBalanceLeaf>(offset);
+                  ExchangeBalance &balance = state.getBalance(account, tokenID);
+                  balance.balance = balanceLeaf.balance;
+                  balance.weightAMM = balanceLeaf.weightAMM;
+                  loadStorage(balance, balanceLeaf.storageRoot);
+              }
+          });
+    }
+
+    void loadStorage(ExchangeBalance &balance, uint64_t storageRoot) const
+    {
+        store->visitTree(
+          storageRoot, TREE_DEPTH_STORAGE, 0, [&](unsigned int level, unsigned long address, uint64_t offset) {
+              balance.storageTree.restoreNode(level, address, *store->get<FieldT>(offset));
+              if (level == 0)
+              {
+                  const StoreStorageLeaf &storageLeaf = *store->get<StoreStorageLeaf>(offset);
+                  StorageLeaf &leaf = balance.storage[address];
+                  leaf.data = storageLeaf.data;
+                  leaf.storageID = storageLeaf.storageID;
+              }
+          });
+    }
+};
+
+inline bool StateStore::getLatestSnapshot(StateSnapshot &snapshot) const
+{
+    const uint64_t offset = getHeader()->latestSnapshot.load(std::memory_order_acquire);
+    if (offset == 0)
+    {
+        return false;
+    }
+    snapshot = StateSnapshot(*this, *get<StoreSnapshot>(offset));
+    return true;
+}
+
+inline bool StateStore::getSnapshot(uint64_t blockIdx, StateSnapshot &snapshot) const
+{
+    uint64_t offset = getHeader()->latestSnapshot.load(std::memory_order_acquire);
+    while (offset != 0)
+    {
+        const StoreSnapshot *storeSnapshot = get<StoreSnapshot>(offset);
+        if (storeSnapshot->blockIdx == blockIdx)
+        {
+            snapshot = StateSnapshot(*this, *storeSnapshot);
+            return true;
+        }
+        offset = storeSnapshot->previous;
+    }
+    return false;
+}
+
+// The state a block is built on, read from the latest snapshot of the store
+// (empty when the store is empty or when there is no store). The state after
+// the block is only stored by commit(), which is called once the block is known
+// to be valid (e.g. after it is proven), so a failing block never changes the
+// store and the next block is built on the same snapshot again.
+class PendingState
+{
+  public:
+    PendingState(StateStore *_store) : store(_store), blockIdx(1), fromSnapshot(false)
+    {
+        if (store != nullptr && store->getLatestSnapshot(snapshot))
+        {
+            state.setSource(&snapshot);
+            blockIdx = snapshot.getBlockIdx() + 1;
+            fromSnapshot = true;
+        }
+    }
+
+    // The state points into the snapshot
+    PendingState(const PendingState &) = delete;
+    PendingState &operator=(const PendingState &) = delete;
+
+    ExchangeState &getState()
+    {
+        return state;
+    }
+
+    // The index the block gets in the store
+    uint64_t getBlockIdx() const
+    {
+        return blockIdx;
+    }
+
+    bool isFromSnapshot() const
+    {
+        return fromSnapshot;
+    }
+
+    bool hasStore() const
+    {
+        return store != nullptr;
+    }
+
+    // Stores the state after the block as the snapshot of the block, does
+    // nothing without a store
+    bool commit()
+    {
+        return (store == nullptr) || store->commit(blockIdx, state);
+    }
+
+  private:
+    StateStore *store;
+    StateSnapshot snapshot;
+    ExchangeState state;
+    uint64_t blockIdx;
+    bool fromSnapshot;
+};
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _STATISTICS_H_
+#define _STATISTICS_H_
+
+#include <cmath>
+#include <vector>
+
+namespace Loopring
+{
+
+struct SampleSummary
+{
+    size_t count;
+    double mean;
+    // The unbiased sample variance
+    double variance;
+};
+
+static SampleSummary summarizeSamples(const std::vector<double> &samples)
+{
+    SampleSummary summary;
+    summary.count = samples.size();
+    summary.mean = 0.0;
+    summary.variance = 0.0;
+    if (samples.empty())
+    {
+        return summary;
+    }
+    for (double sample : samples)
+    {
+        summary.mean += sample;
+    }
+    summary.mean /= samples.size();
+    if (samples.size() > 1)
+    {
+        for (double sample : samples)
+        {
+            summary.variance += (sample - summary.mean) * (sample - summary.mean);
+        }
+        summary.variance /= (samples.size() - 1);
+    }
+    return summary;
+}
+
+// The continued fraction of the regularized incomplete beta function (modified
+// Lentz's method)
+static double incompleteBetaFraction(double a, double b, double x)
+{
+    const unsigned int maxIterations = 200;
+    const double epsilon = 1e-12;
+    const double tiny = 1e-300;
+
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    d = 1.0 / ((std::fabs(d) < tiny) ? tiny : d);
+    double h = d;
+    for (unsigned int i = 1; i <= maxIterations; i++)
+    {
+        const double m = i;
+        // Even step
+        double aa = m * (b - m) * x / ((a + 2.0 * m - 1.0) * (a + 2.0 * m));
+        d = 1.0 + aa * d;
+        d = 1.0 / ((std::fabs(d) < tiny) ? tiny : d);
+        c = 1.0 + aa / c;
+        c = (std::fabs(c) < tiny) ? tiny : c;
+        h *= d * c;
+        // Odd step
+        aa = -(a + m) * (a + b + m) * x / ((a + 2.0 * m) * (a + 2.0 * m + 1.0));
+        d = 1.0 + aa * d;
+        d = 1.0 / ((std::fabs(d) < tiny) ? tiny : d);
+        c = 1.0 + aa / c;
+        c = (std::fabs(c) < tiny) ? tiny : c;
+        const double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1.0) < epsilon)
+        {
+            break;
+        }
+    }
+    return h;
+}
+
+// The regularized incomplete beta function I_x(a, b)
+static double incompleteBeta(double a, double b, double x)
+{
+    if (x <= 0.0)
+    {
+        return 0.0;
+    }
+    if (x >= 1.0)
+    {
+        return 1.0;
+    }
+    const double front =
+      std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1.0 - x));
+    // The continued fraction converges quickly on this side
+    if (x < (a + 1.0) / (a + b + 2.0))
+    {
+        return front * incompleteBetaFraction(a, b, x) / a;
+    }
+    return 1.0 - front * incompleteBetaFraction(b, a, 1.0 - x) / b;
+}
+
+// P(|T| >= |t|) for Student's t-distribution
+static double getTwoSidedPValue(double t, double degreesOfFreedom)
+{
+    return incompleteBeta(degreesOfFreedom / 2.0, 0.5, degreesOfFreedom / (degreesOfFreedom + t * t));
+}
+
+struct TTestResult
+{
+    double t;
+    double degreesOfFreedom;
+    double pValue;
+};
+
+// Welch's t-test of the difference of the means of b and a, the samples can
+// have different variances. Needs at least 2 samples of each.
+static bool welchTTest(const std::vector<double> &a, const std::vector<double> &b, TTestResult &result)
+{
+    if (a.size() < 2 || b.size() < 2)
+    {
+        return false;
+    }
+    const SampleSummary summaryA = summarizeSamples(a);
+    const SampleSummary summaryB = summarizeSamples(b);
+    const double varianceA = summaryA.variance / summaryA.count;
+    const double varianceB = summaryB.variance / summaryB.count;
+    const double difference = summaryB.mean - summaryA.mean;
+    if (varianceA + varianceB == 0.0)
+    {
+        // No noise at all, any difference is significant
+        result.t = (difference == 0.0) ? 0.0 : (difference > 0.0 ? INFINITY : -INFINITY);
+        result.degreesOfFreedom = summaryA.count + summaryB.count - 2;
+        result.pValue = (difference == 0.0) ? 1.0 : 0.0;
+        return true;
+    }
+    result.t = difference / std::sqrt(varianceA + varianceB);
+    // Welch-Satterthwaite
+    const double denominator =
+      varianceA * varianceA / (summaryA.count - 1) + varianceB * varianceB / (summaryB.count - 1);
+    result.degreesOfFreedom = (varianceA + varianceB) * (varianceA + varianceB) / denominator;
+    result.pValue = getTwoSidedPValue(result.t, result.degreesOfFreedom);
+    return true;
+}
+
+} // namespace Loopring
+
+#endif
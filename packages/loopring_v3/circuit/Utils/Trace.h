@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "Data.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Loopring
+{
+
+// Events recorded after this many are dropped, so the trace of a long running
+// process (e.g. the prover server) cannot use all memory
+static const size_t TRACE_MAX_EVENTS = 1 << 20;
+
+struct TraceEvent
+{
+    std::string name;
+    // The index of the transaction (or -1)
+    int index;
+    unsigned int thread;
+    long long begin_ns;
+    long long end_ns;
+};
+
+// Records spans of the pipeline (witness generation, the prover, ...) and
+// writes them as Chrome trace events (chrome://tracing or ui.perfetto.dev).
+// Every thread gets its own lane. Disabled by default, a disabled span only
+// costs a single relaxed load.
+class Trace
+{
+  public:
+    static bool isEnabled()
+    {
+        return enabled().load(std::memory_order_relaxed);
+    }
+
+    // Starts recording, the events are written to filename by write()
+    static void start(const std::string &filename)
+    {
+        const std::lock_guard<std::mutex> lock(mutex());
+        traceFilename() = filename;
+        events().clear();
+        numDroppedEvents() = 0;
+        startTime() = now_ns();
+        // The thread that starts tracing gets the first lane
+        getThreadID();
+        enabled().store(true, std::memory_order_relaxed);
+    }
+
+    // Stops recording, the events recorded so far are kept
+    static void stop()
+    {
+        enabled().store(false, std::memory_order_relaxed);
+    }
+
+    // Removes the events recorded so far, the next events are relative to now
+    static void clear()
+    {
+        const std::lock_guard<std::mutex> lock(mutex());
+        events().clear();
+        numDroppedEvents() = 0;
+        startTime() = now_ns();
+    }
+
+    static size_t getNumEvents()
+    {
+        const std::lock_guard<std::mutex> lock(mutex());
+        return events().size();
+    }
+
+    // Nanoseconds on the same clock libff uses for its profiling blocks
+    static long long now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::high_resolution_clock::now().time_since_epoch())
+          .count();
+    }
+
+    // A small id per thread, the lane the events of the thread are shown in
+    static unsigned int getThreadID()
+    {
+        static std::atomic<unsigned int> nextID(0);
+        thread_local unsigned int id = nextID++;
+        return id;
+    }
+
+    static void addEvent(const std::string &name, int index, long long begin_ns, long long end_ns)
+    {
+        const TraceEvent event = {name, index, getThreadID(), begin_ns, end_ns};
+        const std::lock_guard<std::mutex> lock(mutex());
+        if (events().size() >= TRACE_MAX_EVENTS)
+        {
+            numDroppedEvents()++;
+            return;
+        }
+        events().push_back(event);
+    }
+
+    static json toJSON()
+    {
+        const std::lock_guard<std::mutex> lock(mutex());
+        json jEvents = json::array();
+        unsigned int numThreads = 0;
+        for (const TraceEvent &event : events())
+        {
+            json jEvent = {
+              {"name", event.name},
+              {"ph", "X"},
+              {"pid", 1},
+              {"tid", event.thread},
+              {"ts", (event.begin_ns - startTime()) / 1000.0},
+              {"dur", (event.end_ns - event.begin_ns) / 1000.0}};
+            if (event.index >= 0)
+            {
+                jEvent["args"] = {{"index", event.index}};
+            }
+            jEvents.push_back(jEvent);
+            numThreads = std::max(numThreads, event.thread + 1);
+        }
+        for (unsigned int i = 0; i < numThreads; i++)
+        {
+            jEvents.push_back(
+              {{"name", "thread_name"},
+               {"ph", "M"},
+               {"pid", 1},
+               {"tid", i},
+               {"args", {{"name", "thread " + std::to_string(i)}}}});
+        }
+        return json{{"traceEvents", jEvents}, {"displayTimeUnit", "ms"}};
+    }
+
+    // Writes all events recorded since start(), does nothing when tracing was
+    // never started
+    static bool write()
+    {
+        if (traceFilename().empty())
+        {
+            return true;
+        }
+        std::ofstream file(traceFilename());
+        if (!file.is_open())
+        {
+            LOG_ERROR("Cannot create trace file: " << traceFilename());
+            return false;
+        }
+        file << toJSON().dump();
+        const std::lock_guard<std::mutex> lock(mutex());
+        if (numDroppedEvents() > 0)
+        {
+            LOG_WARNING("Trace is full, " << numDroppedEvents() << " events were dropped");
+        }
+        return true;
+    }
+
+  private:
+    static std::atomic<bool> &enabled()
+    {
+        static std::atomic<bool> traceEnabled(false);
+        return traceEnabled;
+    }
+
+    static std::mutex &mutex()
+    {
+        static std::mutex traceMutex;
+        return traceMutex;
+    }
+
+    static std::vector<TraceEvent> &events()
+    {
+        static std::vector<TraceEvent> traceEvents;
+        return traceEvents;
+    }
+
+    static size_t &numDroppedEvents()
+    {
+        static size_t numDropped = 0;
+        return numDropped;
+    }
+
+    static std::string &traceFilename()
+    {
+        static std::string filename;
+        return filename;
+    }
+
+    static long long &startTime()
+    {
+        static long long time = 0;
+        return time;
+    }
+};
+
+// Records a span from its construction until it goes out of scope
+class TraceScope
+{
+  public:
+    TraceScope(const char *_name, int _index = -1) : name(_name), index(_index), begin_ns(0)
+    {
+        if (Trace::isEnabled())
+        {
+            begin_ns = Trace::now_ns();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (begin_ns != 0)
+        {
+            Trace::addEvent(name, index, begin_ns, Trace::now_ns());
+        }
+    }
+
+  private:
+    const char *name;
+    int index;
+    long long begin_ns;
+};
+
+// Writes the trace (when enabled) when it goes out of scope. With clear the
+// events are removed after they are written, so only the trace of the scope is
+// kept (e.g. of a single request of the server).
+class TraceWriter
+{
+  public:
+    TraceWriter(bool _clear = false) : clear(_clear)
+    {
+    }
+
+    ~TraceWriter()
+    {
+        Trace::write();
+        if (clear)
+        {
+            Trace::clear();
+        }
+    }
+
+  private:
+    bool clear;
+};
+
+} // namespace Loopring
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Traces the rest of the current scope
+#define TRACE_SCOPE(name) Loopring::TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name)
+// Traces the rest of the current scope for the transaction at the given index
+#define TRACE_SCOPE_INDEX(name, index) Loopring::TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name, int(index))
+
+#endif
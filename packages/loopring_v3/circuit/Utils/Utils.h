@@ -5,6 +5,7 @@
 
 #include "Constants.h"
 #include "Data.h"
+#include "Log.h"
 
 #include "../ThirdParty/BigIntHeader.hpp"
 #include "ethsnarks.hpp"
@@ -15,6 +16,9 @@
 #include "jubjub/point.hpp"
 #include "utils.hpp"
 
+#include <cstring>
+#include <gmp.h>
+
 #ifndef NDEBUG
 #define ASSERT(condition, message)                                                                                     \
     do                                                                                                                 \
@@ -120,12 +124,16 @@ static const VariableArrayT var_array(const std::vector<VariableT> &inputs)
 
 static BigInt toBigInt(ethsnarks::FieldT _value, bool sign = true)
 {
-    auto value = _value.as_bigint();
-    BigInt bi = 0;
-    for (unsigned int i = 0; i < value.num_bits(); i++)
-    {
-        bi = bi * 2 + (value.test_bit(value.num_bits() - 1 - i) ? 1 : 0);
-    }
+    // Convert through the decimal representation, building the value bit by
+    // bit is very slow with BigInt.
+    mpz_t value;
+    mpz_init(value);
+    _value.as_bigint().to_mpz(value);
+    std::string str(mpz_sizeinbase(value, 10) + 2, '\0');
+    mpz_get_str(&str[0], 10, value);
+    mpz_clear(value);
+    str.resize(strlen(str.c_str()));
+    BigInt bi = BigInt(str);
     if (!sign)
     {
         bi = -bi;
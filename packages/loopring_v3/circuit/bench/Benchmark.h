@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include "../Utils/Data.h"
+#include "../Utils/Log.h"
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace ethsnarks;
+
+namespace Loopring
+{
+
+// A single gadget on its own protoboard. The inputs of the gadget are
+// allocated and set outside of the measurements.
+class GadgetBenchmark
+{
+  public:
+    virtual ~GadgetBenchmark()
+    {
+    }
+
+    // Allocates the inputs of the gadget (and any gadgets it depends on)
+    virtual void allocateInputs(ProtoboardT &pb)
+    {
+    }
+
+    // Allocates the gadget and generates its constraints
+    virtual void generateConstraints(ProtoboardT &pb) = 0;
+
+    // Sets the values of the inputs
+    virtual void setInputs(ProtoboardT &pb)
+    {
+    }
+
+    // Generates the witness of the gadget, called multiple times on the same
+    // inputs
+    virtual void generateWitness(ProtoboardT &pb) = 0;
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    // Only the constraints and variables of the gadget itself, not those of
+    // its inputs
+    size_t numConstraints;
+    size_t numVariables;
+    double constraintGenerationMs;
+    unsigned int iterations;
+    double witnessGenerationMinUs;
+    double witnessGenerationMedianUs;
+    // The witness generation time of every iteration, in the order measured
+    std::vector<double> witnessGenerationSamplesUs;
+    // Whether all constraints on the protoboard are satisfied by the witness
+    bool satisfied;
+};
+
+static void to_json(json &j, const BenchmarkResult &result)
+{
+    j = json{
+      {"name", result.name},
+      {"constraints", result.numConstraints},
+      {"variables", result.numVariables},
+      {"constraintGenerationMs", result.constraintGenerationMs},
+      {"iterations", result.iterations},
+      {"witnessGenerationMinUs", result.witnessGenerationMinUs},
+      {"witnessGenerationMedianUs", result.witnessGenerationMedianUs},
+      {"witnessGenerationSamplesUs", result.witnessGenerationSamplesUs},
+      {"satisfied", result.satisfied}};
+}
+
+template <typename Duration> static double toMicroseconds(const Duration &duration)
+{
+    return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(duration).count();
+}
+
+static BenchmarkResult runBenchmark(const std::string &name, GadgetBenchmark &benchmark, unsigned int iterations)
+{
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = std::max(iterations, 1u);
+
+    ProtoboardT pb;
+    benchmark.allocateInputs(pb);
+    const size_t numConstraintsBefore = pb.num_constraints();
+    const size_t numVariablesBefore = pb.num_variables();
+
+    auto begin = std::chrono::steady_clock::now();
+    benchmark.generateConstraints(pb);
+    result.constraintGenerationMs = toMicroseconds(std::chrono::steady_clock::now() - begin) / 1000.0;
+    result.numConstraints = pb.num_constraints() - numConstraintsBefore;
+    result.numVariables = pb.num_variables() - numVariablesBefore;
+
+    benchmark.setInputs(pb);
+    std::vector<double> &samples = result.witnessGenerationSamplesUs;
+    samples.reserve(result.iterations);
+    for (unsigned int i = 0; i < result.iterations; i++)
+    {
+        begin = std::chrono::steady_clock::now();
+        benchmark.generateWitness(pb);
+        samples.push_back(toMicroseconds(std::chrono::steady_clock::now() - begin));
+    }
+    std::vector<double> times = samples;
+    std::sort(times.begin(), times.end());
+    result.witnessGenerationMinUs = times.front();
+    result.witnessGenerationMedianUs = times[times.size() / 2];
+
+    result.satisfied = pb.is_satisfied();
+    if (!result.satisfied)
+    {
+        LOG_WARNING(name << ": the constraints are not satisfied");
+    }
+    LOG_INFO(
+      name << ": " << result.numConstraints << " constraints, " << result.numVariables << " variables, witness "
+           << result.witnessGenerationMedianUs << "us");
+    return result;
+}
+
+} // namespace Loopring
+
+#endif
@@ -0,0 +1,914 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2017 Loopring Technology Limited.
+#include "Benchmark.h"
+#include "../Circuits/UniversalCircuit.h"
+#include "../Utils/BenchmarkResults.h"
+#include "../Utils/BlockBuilder.h"
+#include "../Utils/BlockGenerator.h"
+#include "../Utils/Data.h"
+#include "../Utils/Log.h"
+#include "../Utils/SparseMerkleTree.h"
+#include "../Utils/Utils.h"
+
+#include "ethsnarks.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace ethsnarks;
+using namespace Loopring;
+
+template <typename HashT> class PoseidonBenchmark : public GadgetBenchmark
+{
+  public:
+    PoseidonBenchmark(unsigned int _numInputs) : numInputs(_numInputs)
+    {
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        inputs = make_var_array(pb, numInputs, "inputs");
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        hash.reset(new HashT(pb, inputs, "hash"));
+        hash->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        std::mt19937_64 rng(numInputs);
+        for (unsigned int i = 0; i < numInputs; i++)
+        {
+            pb.val(inputs[i]) = FieldT(rng());
+        }
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        hash->generate_r1cs_witness();
+    }
+
+  private:
+    unsigned int numInputs;
+    VariableArrayT inputs;
+    std::unique_ptr<HashT> hash;
+};
+
+// Checks a proof of a random leaf in a tree with the given depth
+class MerklePathBenchmark : public GadgetBenchmark
+{
+  public:
+    MerklePathBenchmark(unsigned int _depth) : depth(_depth), tree(_depth, FieldT::zero())
+    {
+        std::mt19937_64 rng(depth);
+        address = rng() % tree.getNumLeaves();
+        leafValue = FieldT(rng());
+        tree.update(address, leafValue);
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        addressBits = make_var_array(pb, depth * 2, "address");
+        leaf = make_variable(pb, "leaf");
+        root = make_variable(pb, "root");
+        path = make_var_array(pb, depth * 3, "path");
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        merklePath.reset(new MerklePathCheckT(pb, depth, addressBits, leaf, root, path, "merklePath"));
+        merklePath->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        addressBits.fill_with_bits_of_field_element(pb, FieldT(address));
+        pb.val(leaf) = leafValue;
+        pb.val(root) = tree.getRoot();
+        path.fill_with_field_elements(pb, tree.createProof(address).data);
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        merklePath->generate_r1cs_witness();
+    }
+
+  private:
+    unsigned int depth;
+    SparseMerkleTree tree;
+    unsigned long address;
+    FieldT leafValue;
+
+    VariableArrayT addressBits;
+    VariableT leaf;
+    VariableT root;
+    VariableArrayT path;
+    std::unique_ptr<MerklePathCheckT> merklePath;
+};
+
+static AccountState allocateAccountState(ProtoboardT &pb, const std::string &prefix)
+{
+    AccountState state;
+    state.owner = make_variable(pb, FMT(prefix, ".owner"));
+    state.publicKeyX = make_variable(pb, FMT(prefix, ".publicKeyX"));
+    state.publicKeyY = make_variable(pb, FMT(prefix, ".publicKeyY"));
+    state.nonce = make_variable(pb, FMT(prefix, ".nonce"));
+    state.feeBipsAMM = make_variable(pb, FMT(prefix, ".feeBipsAMM"));
+    state.balancesRoot = make_variable(pb, FMT(prefix, ".balancesRoot"));
+    return state;
+}
+
+static void setAccountState(ProtoboardT &pb, const AccountState &state, const AccountLeaf &leaf)
+{
+    pb.val(state.owner) = leaf.owner;
+    pb.val(state.publicKeyX) = leaf.publicKey.x;
+    pb.val(state.publicKeyY) = leaf.publicKey.y;
+    pb.val(state.nonce) = leaf.nonce;
+    pb.val(state.feeBipsAMM) = leaf.feeBipsAMM;
+    pb.val(state.balancesRoot) = leaf.balancesRoot;
+}
+
+class UpdateAccountBenchmark : public GadgetBenchmark
+{
+  public:
+    UpdateAccountBenchmark(const AccountUpdate &_update) : update(_update)
+    {
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        root = make_variable(pb, "root");
+        address = make_var_array(pb, NUM_BITS_ACCOUNT, "address");
+        before = allocateAccountState(pb, "before");
+        after = allocateAccountState(pb, "after");
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        updateAccount.reset(new UpdateAccountGadget(pb, root, address, before, after, "updateAccount"));
+        updateAccount->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        pb.val(root) = update.rootBefore;
+        address.fill_with_bits_of_field_element(pb, update.accountID);
+        setAccountState(pb, before, update.before);
+        setAccountState(pb, after, update.after);
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        updateAccount->generate_r1cs_witness(update);
+    }
+
+  private:
+    AccountUpdate update;
+
+    VariableT root;
+    VariableArrayT address;
+    AccountState before;
+    AccountState after;
+    std::unique_ptr<UpdateAccountGadget> updateAccount;
+};
+
+class SignatureVerifierBenchmark : public GadgetBenchmark
+{
+  public:
+    SignatureVerifierBenchmark(const jubjub::Params &_params) : params(_params)
+    {
+        std::mt19937_64 rng(1);
+        keyPair = createKeyPair(rng, params);
+        messageValue = getRandomScalar(rng);
+        signature = signMessage(keyPair, messageValue, rng, params);
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        constants.reset(new Constants(pb, "constants"));
+        constants->generate_r1cs_constraints();
+        publicKey.reset(new jubjub::VariablePointT(pb, "publicKey"));
+        message = make_variable(pb, "message");
+        required = make_variable(pb, "required");
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        signatureVerifier.reset(
+          new SignatureVerifier(pb, params, *constants, *publicKey, message, required, "signatureVerifier"));
+        signatureVerifier->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        pb.val(publicKey->x) = keyPair.publicKey.x;
+        pb.val(publicKey->y) = keyPair.publicKey.y;
+        pb.val(message) = messageValue;
+        pb.val(required) = FieldT::one();
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        signatureVerifier->generate_r1cs_witness(signature);
+    }
+
+  private:
+    const jubjub::Params &params;
+    EdDSAKeyPair keyPair;
+    FieldT messageValue;
+    Signature signature;
+
+    std::unique_ptr<Constants> constants;
+    std::unique_ptr<jubjub::VariablePointT> publicKey;
+    VariableT message;
+    VariableT required;
+    std::unique_ptr<SignatureVerifier> signatureVerifier;
+};
+
+// The verifiers of the signatures that aren't needed in a block, which all get
+// the dummy signature with s == 0. With the memo only the first verifier
+// calculates B*s, the others copy it.
+class DummySignatureVerifierBenchmark : public GadgetBenchmark
+{
+  public:
+    DummySignatureVerifierBenchmark(const jubjub::Params &_params, unsigned int _numVerifiers, bool _useMemo)
+        : params(_params), numVerifiers(_numVerifiers), useMemo(_useMemo)
+    {
+        std::mt19937_64 rng(1);
+        keyPair = createKeyPair(rng, params);
+        messageValue = getRandomScalar(rng);
+        signature = dummySignature.get<Signature>();
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        constants.reset(new Constants(pb, "constants"));
+        constants->generate_r1cs_constraints();
+        publicKey.reset(new jubjub::VariablePointT(pb, "publicKey"));
+        message = make_variable(pb, "message");
+        required = make_variable(pb, "required");
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        for (unsigned int i = 0; i < numVerifiers; i++)
+        {
+            signatureVerifiers.emplace_back(new SignatureVerifier(
+              pb, params, *constants, *publicKey, message, required, FMT("signatureVerifier_", "%u", i)));
+            signatureVerifiers.back()->generate_r1cs_constraints();
+        }
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        pb.val(publicKey->x) = keyPair.publicKey.x;
+        pb.val(publicKey->y) = keyPair.publicKey.y;
+        pb.val(message) = messageValue;
+        pb.val(required) = FieldT::zero();
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        // The memo only lives for a single block
+        memo.clear();
+        for (const auto &signatureVerifier : signatureVerifiers)
+        {
+            signatureVerifier->generate_r1cs_witness(signature, useMemo ? &memo : nullptr);
+        }
+    }
+
+  private:
+    const jubjub::Params &params;
+    unsigned int numVerifiers;
+    bool useMemo;
+    EdDSAKeyPair keyPair;
+    FieldT messageValue;
+    Signature signature;
+    FixedBaseMulMemo memo;
+
+    std::unique_ptr<Constants> constants;
+    std::unique_ptr<jubjub::VariablePointT> publicKey;
+    VariableT message;
+    VariableT required;
+    std::vector<std::unique_ptr<SignatureVerifier>> signatureVerifiers;
+};
+
+// The protocol fee calculation: amount * protocolFeeBips / 100000
+class MulDivBenchmark : public GadgetBenchmark
+{
+  public:
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        constants.reset(new Constants(pb, "constants"));
+        constants->generate_r1cs_constraints();
+        value = make_variable(pb, "value");
+        numerator = make_variable(pb, "numerator");
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        mulDiv.reset(new MulDivGadget(
+          pb,
+          *constants,
+          value,
+          numerator,
+          constants->_100000,
+          NUM_BITS_AMOUNT,
+          NUM_BITS_PROTOCOL_FEE_BIPS,
+          17 /*=ceil(log2(100000))*/,
+          "mulDiv"));
+        mulDiv->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        pb.val(value) = FieldT("123456789012345678901234");
+        pb.val(numerator) = FieldT(25);
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        mulDiv->generate_r1cs_witness();
+    }
+
+  private:
+    std::unique_ptr<Constants> constants;
+    VariableT value;
+    VariableT numerator;
+    std::unique_ptr<MulDivGadget> mulDiv;
+};
+
+class FloatBenchmark : public GadgetBenchmark
+{
+  public:
+    FloatBenchmark(const FloatEncoding &_encoding) : encoding(_encoding)
+    {
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        constants.reset(new Constants(pb, "constants"));
+        constants->generate_r1cs_constraints();
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        floatGadget.reset(new FloatGadget(pb, *constants, encoding, "float"));
+        floatGadget->generate_r1cs_constraints();
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        floatGadget->generate_r1cs_witness(FieldT(toFloat(FieldT("123400000000000000"), encoding)));
+    }
+
+  private:
+    const FloatEncoding &encoding;
+    std::unique_ptr<Constants> constants;
+    std::unique_ptr<FloatGadget> floatGadget;
+};
+
+// Hashes the data-availability data of the given number of transactions
+class PublicDataBenchmark : public GadgetBenchmark
+{
+  public:
+    PublicDataBenchmark(unsigned int _numTransactions) : numTransactions(_numTransactions)
+    {
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        publicData.reset(new PublicDataGadget(pb, "publicData"));
+        data = make_var_array(pb, numTransactions * TX_DATA_AVAILABILITY_SIZE * 8, "data");
+        publicData->add(data);
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        publicData->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        std::mt19937_64 rng(numTransactions);
+        for (unsigned int i = 0; i < data.size(); i++)
+        {
+            pb.val(data[i]) = (rng() & 1) ? FieldT::one() : FieldT::zero();
+        }
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        publicData->generate_r1cs_witness();
+    }
+
+  private:
+    unsigned int numTransactions;
+    std::unique_ptr<PublicDataGadget> publicData;
+    VariableArrayT data;
+};
+
+// The block values and the state of a single transaction, the inputs of the
+// transaction circuits
+class TransactionInputs
+{
+  public:
+    std::unique_ptr<Constants> constants;
+    VariableT exchange;
+    VariableT timestamp;
+    VariableT protocolTakerFeeBips;
+    VariableT protocolMakerFeeBips;
+    VariableT type;
+    std::unique_ptr<TransactionState> state;
+
+    void allocate(ProtoboardT &pb, const jubjub::Params &params)
+    {
+        constants.reset(new Constants(pb, "constants"));
+        constants->generate_r1cs_constraints();
+        exchange = make_variable(pb, "exchange");
+        timestamp = make_variable(pb, "timestamp");
+        protocolTakerFeeBips = make_variable(pb, "protocolTakerFeeBips");
+        protocolMakerFeeBips = make_variable(pb, "protocolMakerFeeBips");
+        type = make_variable(pb, "type");
+        state.reset(new TransactionState(
+          pb,
+          params,
+          *constants,
+          exchange,
+          timestamp,
+          protocolTakerFeeBips,
+          protocolMakerFeeBips,
+          constants->_0,
+          type,
+          "state"));
+    }
+
+    void set(ProtoboardT &pb, const Block &block, const UniversalTransaction &uTx)
+    {
+        pb.val(exchange) = block.exchange;
+        pb.val(timestamp) = block.timestamp;
+        pb.val(protocolTakerFeeBips) = block.protocolTakerFeeBips;
+        pb.val(protocolMakerFeeBips) = block.protocolMakerFeeBips;
+        pb.val(type) = uTx.type;
+        state->generate_r1cs_witness(
+          uTx.witness.accountUpdate_A.before,
+          uTx.witness.balanceUpdateS_A.before,
+          uTx.witness.balanceUpdateB_A.before,
+          uTx.witness.storageUpdate_A.before,
+          uTx.witness.accountUpdate_B.before,
+          uTx.witness.balanceUpdateS_B.before,
+          uTx.witness.balanceUpdateB_B.before,
+          uTx.witness.storageUpdate_B.before,
+          uTx.witness.accountUpdate_O.before,
+          uTx.witness.balanceUpdateA_O.before,
+          uTx.witness.balanceUpdateB_O.before,
+          uTx.witness.balanceUpdateA_P.before,
+          uTx.witness.balanceUpdateB_P.before);
+    }
+};
+
+static void generateTransactionWitness(NoopCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness();
+}
+
+static void generateTransactionWitness(SpotTradeCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.spotTrade);
+}
+
+static void generateTransactionWitness(DepositCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.deposit);
+}
+
+static void generateTransactionWitness(WithdrawCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.withdraw);
+}
+
+static void generateTransactionWitness(AccountUpdateCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.accountUpdate);
+}
+
+static void generateTransactionWitness(TransferCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.transfer);
+}
+
+static void generateTransactionWitness(AmmUpdateCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.ammUpdate);
+}
+
+static void generateTransactionWitness(SignatureVerificationCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.signatureVerification);
+}
+
+static void generateTransactionWitness(NftMintCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.nftMint);
+}
+
+static void generateTransactionWitness(NftDataCircuit &circuit, const UniversalTransaction &uTx)
+{
+    circuit.generate_r1cs_witness(uTx.nftData);
+}
+
+// A single transaction circuit, without the selection of the outputs and the
+// Merkle tree updates
+template <typename CircuitT> class TransactionCircuitBenchmark : public GadgetBenchmark
+{
+  public:
+    TransactionCircuitBenchmark(const jubjub::Params &_params, const Block &_block) : params(_params), block(_block)
+    {
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        inputs.allocate(pb, params);
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        circuit.reset(new CircuitT(pb, *inputs.state, "circuit"));
+        circuit->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        inputs.set(pb, block, block.transactions[0]);
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        generateTransactionWitness(*circuit, block.transactions[0]);
+    }
+
+  private:
+    const jubjub::Params &params;
+    const Block &block;
+    TransactionInputs inputs;
+    std::unique_ptr<CircuitT> circuit;
+};
+
+// Selects the outputs of all transaction circuits
+class SelectTransactionBenchmark : public GadgetBenchmark
+{
+  public:
+    SelectTransactionBenchmark(const jubjub::Params &_params, const Block &_block) : params(_params), block(_block)
+    {
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        inputs.allocate(pb, params);
+        const TransactionState &state = *inputs.state;
+        selector.reset(
+          new SelectorGadget(pb, *inputs.constants, inputs.type, (unsigned int)TransactionType::COUNT, "selector"));
+        selector->generate_r1cs_constraints();
+
+        noop.reset(new NoopCircuit(pb, state, "noop"));
+        spotTrade.reset(new SpotTradeCircuit(pb, state, "spotTrade"));
+        deposit.reset(new DepositCircuit(pb, state, "deposit"));
+        withdraw.reset(new WithdrawCircuit(pb, state, "withdraw"));
+        accountUpdate.reset(new AccountUpdateCircuit(pb, state, "accountUpdate"));
+        transfer.reset(new TransferCircuit(pb, state, "transfer"));
+        ammUpdate.reset(new AmmUpdateCircuit(pb, state, "ammUpdate"));
+        signatureVerification.reset(new SignatureVerificationCircuit(pb, state, "signatureVerification"));
+        nftMint.reset(new NftMintCircuit(pb, state, "nftMint"));
+        nftData.reset(new NftDataCircuit(pb, state, "nftData"));
+        for (BaseTransactionCircuit *circuit : getCircuits())
+        {
+            circuit->generate_r1cs_constraints();
+        }
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        tx.reset(new SelectTransactionGadget(pb, *inputs.state, selector->result(), getCircuits(), "tx"));
+        tx->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        const UniversalTransaction &uTx = block.transactions[0];
+        inputs.set(pb, block, uTx);
+        selector->generate_r1cs_witness();
+        generateTransactionWitness(*noop, uTx);
+        generateTransactionWitness(*spotTrade, uTx);
+        generateTransactionWitness(*deposit, uTx);
+        generateTransactionWitness(*withdraw, uTx);
+        generateTransactionWitness(*accountUpdate, uTx);
+        generateTransactionWitness(*transfer, uTx);
+        generateTransactionWitness(*ammUpdate, uTx);
+        generateTransactionWitness(*signatureVerification, uTx);
+        generateTransactionWitness(*nftMint, uTx);
+        generateTransactionWitness(*nftData, uTx);
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        tx->generate_r1cs_witness();
+    }
+
+  private:
+    const jubjub::Params &params;
+    const Block &block;
+    TransactionInputs inputs;
+    std::unique_ptr<SelectorGadget> selector;
+    std::unique_ptr<NoopCircuit> noop;
+    std::unique_ptr<SpotTradeCircuit> spotTrade;
+    std::unique_ptr<DepositCircuit> deposit;
+    std::unique_ptr<WithdrawCircuit> withdraw;
+    std::unique_ptr<AccountUpdateCircuit> accountUpdate;
+    std::unique_ptr<TransferCircuit> transfer;
+    std::unique_ptr<AmmUpdateCircuit> ammUpdate;
+    std::unique_ptr<SignatureVerificationCircuit> signatureVerification;
+    std::unique_ptr<NftMintCircuit> nftMint;
+    std::unique_ptr<NftDataCircuit> nftData;
+    std::unique_ptr<SelectTransactionGadget> tx;
+
+    // In the same order as in TransactionGadget (the order of TransactionType)
+    std::vector<BaseTransactionCircuit *> getCircuits() const
+    {
+        return {
+          noop.get(),
+          deposit.get(),
+          withdraw.get(),
+          transfer.get(),
+          spotTrade.get(),
+          accountUpdate.get(),
+          ammUpdate.get(),
+          signatureVerification.get(),
+          nftMint.get(),
+          nftData.get()};
+    }
+};
+
+// A complete transaction of a block: all transaction circuits, the signature
+// checks and the Merkle tree updates
+class TransactionBenchmark : public GadgetBenchmark
+{
+  public:
+    TransactionBenchmark(const jubjub::Params &_params, const Block &_block) : params(_params), block(_block)
+    {
+    }
+
+    void allocateInputs(ProtoboardT &pb) override
+    {
+        constants.reset(new Constants(pb, "constants"));
+        constants->generate_r1cs_constraints();
+        exchange = make_variable(pb, "exchange");
+        accountsRoot = make_variable(pb, "accountsRoot");
+        timestamp = make_variable(pb, "timestamp");
+        protocolTakerFeeBips = make_variable(pb, "protocolTakerFeeBips");
+        protocolMakerFeeBips = make_variable(pb, "protocolMakerFeeBips");
+        operatorAccountID = make_var_array(pb, NUM_BITS_ACCOUNT, "operatorAccountID");
+        protocolBalancesRoot = make_variable(pb, "protocolBalancesRoot");
+    }
+
+    void generateConstraints(ProtoboardT &pb) override
+    {
+        transaction.reset(new TransactionGadget(
+          pb,
+          params,
+          *constants,
+          exchange,
+          accountsRoot,
+          timestamp,
+          protocolTakerFeeBips,
+          protocolMakerFeeBips,
+          operatorAccountID,
+          protocolBalancesRoot,
+          constants->_0,
+          false,
+          "tx"));
+        transaction->generate_r1cs_constraints();
+    }
+
+    void setInputs(ProtoboardT &pb) override
+    {
+        const UniversalTransaction &uTx = block.transactions[0];
+        pb.val(exchange) = block.exchange;
+        pb.val(accountsRoot) = uTx.witness.accountUpdate_A.rootBefore;
+        pb.val(timestamp) = block.timestamp;
+        pb.val(protocolTakerFeeBips) = block.protocolTakerFeeBips;
+        pb.val(protocolMakerFeeBips) = block.protocolMakerFeeBips;
+        operatorAccountID.fill_with_bits_of_field_element(pb, block.operatorAccountID);
+        pb.val(protocolBalancesRoot) = uTx.witness.balanceUpdateB_P.rootBefore;
+    }
+
+    void generateWitness(ProtoboardT &pb) override
+    {
+        transaction->generate_r1cs_witness(block.transactions[0]);
+    }
+
+  private:
+    const jubjub::Params &params;
+    const Block &block;
+
+    std::unique_ptr<Constants> constants;
+    VariableT exchange;
+    VariableT accountsRoot;
+    VariableT timestamp;
+    VariableT protocolTakerFeeBips;
+    VariableT protocolMakerFeeBips;
+    VariableArrayT operatorAccountID;
+    VariableT protocolBalancesRoot;
+    std::unique_ptr<TransactionGadget> transaction;
+};
+
+// A block with a single transaction of the given type on a new state. The
+// blocks of setupTxTypes are built first, e.g. to mint the NFT of an NftData
+// transaction.
+static bool generateTransactionBlock(
+  const std::string &txType,
+  Block &block,
+  const std::vector<std::string> &setupTxTypes = {})
+{
+    BlockGeneratorConfig config;
+    config.blockSize = 1;
+    config.seed = 1;
+    config.numAccounts = 2;
+    config.numTokens = 2;
+    BlockGenerator generator(config);
+    ExchangeState state;
+    generator.setupState(state);
+    json input;
+    for (const std::string &setupTxType : setupTxTypes)
+    {
+        generator.setTransactions({{setupTxType, 1}});
+        if (!generator.generateBlock(input) || !buildBlock(state, input, block))
+        {
+            return false;
+        }
+    }
+    generator.setTransactions({{txType, 1}});
+    return generator.generateBlock(input) && buildBlock(state, input, block);
+}
+
+int main(int argc, char **argv)
+{
+    ethsnarks::ppT::init_public_params();
+
+    const char *resultsFilename = nullptr;
+    unsigned int iterations = 10;
+    std::string filter;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            resultsFilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            iterations = std::max(atoi(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-o <results.json>] [-n <iterations>] [-f <filter>]" << std::endl;
+            std::cerr << "-o: Writes the results to the file instead of stdout" << std::endl;
+            std::cerr << "-n: The number of times the witness is generated (10 by default)" << std::endl;
+            std::cerr << "-f: Only runs the benchmarks with the filter in their name" << std::endl;
+            return 1;
+        }
+    }
+    // Keep stdout clean for the results
+    if (!resultsFilename)
+    {
+        Log::setLevel(LogLevel::Warning);
+    }
+
+    // The transactions used as inputs. The data of an NFT is set after it is
+    // minted.
+    const std::vector<std::string> txTypes = {
+      "Noop",
+      "Deposit",
+      "Withdraw",
+      "Transfer",
+      "SpotTrade",
+      "SpotTradeAMM",
+      "AccountUpdate",
+      "AmmUpdate",
+      "SignatureVerification",
+      "NftMint",
+      "NftData"};
+    const std::map<std::string, std::vector<std::string>> setupTxTypes = {{"NftData", {"NftMint"}}};
+    std::map<std::string, Block> blocks;
+    for (const std::string &txType : txTypes)
+    {
+        const auto setup = setupTxTypes.find(txType);
+        if (!generateTransactionBlock(
+              txType, blocks[txType], (setup != setupTxTypes.end()) ? setup->second : std::vector<std::string>()))
+        {
+            LOG_ERROR("Could not generate a " << txType << " transaction");
+            return 1;
+        }
+    }
+
+    jubjub::Params params;
+    std::vector<std::pair<std::string, std::unique_ptr<GadgetBenchmark>>> benchmarks;
+    auto add = [&benchmarks](const std::string &name, GadgetBenchmark *benchmark) {
+        benchmarks.emplace_back(name, std::unique_ptr<GadgetBenchmark>(benchmark));
+    };
+
+    add("Poseidon_2", new PoseidonBenchmark<Poseidon_2>(2));
+    add("Poseidon_3", new PoseidonBenchmark<Poseidon_3>(3));
+    add("Poseidon_4", new PoseidonBenchmark<Poseidon_4>(4));
+    add("Poseidon_5", new PoseidonBenchmark<Poseidon_5>(5));
+    add("Poseidon_6", new PoseidonBenchmark<Poseidon_6>(6));
+    add("Poseidon_8", new PoseidonBenchmark<Poseidon_8>(8));
+    add("Poseidon_9", new PoseidonBenchmark<Poseidon_9>(9));
+    add("Poseidon_10", new PoseidonBenchmark<Poseidon_10>(10));
+    add("Poseidon_11", new PoseidonBenchmark<Poseidon_11>(11));
+    add("Poseidon_12", new PoseidonBenchmark<Poseidon_12>(12));
+
+    add("merkle_path_authenticator_4/storage", new MerklePathBenchmark(TREE_DEPTH_STORAGE));
+    add("merkle_path_authenticator_4/tokens", new MerklePathBenchmark(TREE_DEPTH_TOKENS));
+    add("merkle_path_authenticator_4/accounts", new MerklePathBenchmark(TREE_DEPTH_ACCOUNTS));
+
+    add("UpdateAccountGadget", new UpdateAccountBenchmark(blocks["Transfer"].transactions[0].witness.accountUpdate_A));
+    add("SignatureVerifier", new SignatureVerifierBenchmark(params));
+    add("SignatureVerifier/dummy/16", new DummySignatureVerifierBenchmark(params, 16, false));
+    add("SignatureVerifier/dummy/16/memo", new DummySignatureVerifierBenchmark(params, 16, true));
+    add("MulDivGadget", new MulDivBenchmark());
+    add("FloatGadget/Float24", new FloatBenchmark(Float24Encoding));
+    add("FloatGadget/Float16", new FloatBenchmark(Float16Encoding));
+    add("PublicDataGadget/1", new PublicDataBenchmark(1));
+    add("PublicDataGadget/16", new PublicDataBenchmark(16));
+
+    add("NoopCircuit", new TransactionCircuitBenchmark<NoopCircuit>(params, blocks["Noop"]));
+    add("DepositCircuit", new TransactionCircuitBenchmark<DepositCircuit>(params, blocks["Deposit"]));
+    add("WithdrawCircuit", new TransactionCircuitBenchmark<WithdrawCircuit>(params, blocks["Withdraw"]));
+    add("TransferCircuit", new TransactionCircuitBenchmark<TransferCircuit>(params, blocks["Transfer"]));
+    add("SpotTradeCircuit", new TransactionCircuitBenchmark<SpotTradeCircuit>(params, blocks["SpotTrade"]));
+    add("SpotTradeCircuit/AMM", new TransactionCircuitBenchmark<SpotTradeCircuit>(params, blocks["SpotTradeAMM"]));
+    add(
+      "AccountUpdateCircuit",
+      new TransactionCircuitBenchmark<AccountUpdateCircuit>(params, blocks["AccountUpdate"]));
+    add("AmmUpdateCircuit", new TransactionCircuitBenchmark<AmmUpdateCircuit>(params, blocks["AmmUpdate"]));
+    add(
+      "SignatureVerificationCircuit",
+      new TransactionCircuitBenchmark<SignatureVerificationCircuit>(params, blocks["SignatureVerification"]));
+    add("NftMintCircuit", new TransactionCircuitBenchmark<NftMintCircuit>(params, blocks["NftMint"]));
+    add("NftDataCircuit", new TransactionCircuitBenchmark<NftDataCircuit>(params, blocks["NftData"]));
+    add("SelectTransactionGadget", new SelectTransactionBenchmark(params, blocks["Transfer"]));
+
+    for (const std::string &txType : txTypes)
+    {
+        add("TransactionGadget/" + txType, new TransactionBenchmark(params, blocks[txType]));
+    }
+
+    json results = json::array();
+    for (const auto &benchmark : benchmarks)
+    {
+        if (benchmark.first.find(filter) != std::string::npos)
+        {
+            results.push_back(runBenchmark(benchmark.first, *benchmark.second, iterations));
+        }
+    }
+
+    // Also records the peak memory usage of the benchmarks
+    json output = getSystemInfo();
+    output["iterations"] = iterations;
+#ifdef MULTICORE
+    output["multicore"] = true;
+#else
+    output["multicore"] = false;
+#endif
+    output["benchmarks"] = results;
+    if (resultsFilename)
+    {
+        std::ofstream file(resultsFilename);
+        if (!file.is_open())
+        {
+            LOG_ERROR("Cannot create file: " << resultsFilename);
+            return 1;
+        }
+        file << output.dump(4) << std::endl;
+        LOG_INFO("Results written to " << resultsFilename);
+    }
+    else
+    {
+        std::cout << output.dump(4) << std::endl;
+    }
+    return 0;
+}
@@ -2,7 +2,16 @@
 // Copyright 2017 Loopring Technology Limited.
 
 #include "ThirdParty/BigInt.hpp"
+#include "Utils/BenchmarkResults.h"
+#include "Utils/BlockBuilder.h"
+#include "Utils/BlockGenerator.h"
 #include "Utils/Data.h"
+#include "Utils/Log.h"
+#include "Utils/MemoryProfile.h"
+#include "Utils/ProverTimings.h"
+#include "Utils/StateStore.h"
+#include "Utils/Trace.h"
+#include "Utils/ConstraintChecker.h"
 #include "Circuits/UniversalCircuit.h"
 
 #include "ThirdParty/httplib.h"
@@ -13,80 +22,15 @@
 #include <fstream>
 #include <chrono>
 #include <mutex>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
 
 #ifdef MULTICORE
 #include <omp.h>
 #endif
 
-#define WITH_MEMORY_STATS 0
-
-#if WITH_MEMORY_STATS
-#include <unistd.h>
-#include <ios>
-#include <iostream>
-#include <fstream>
-#include <string>
-
-#include <malloc.h>
-
-//////////////////////////////////////////////////////////////////////////////
-//
-// process_mem_usage(double &, double &) - takes two doubles by reference,
-// attempts to read the system-dependent data for a process' virtual memory
-// size and resident set size, and return the results in KB.
-//
-// On failure, returns 0.0, 0.0
-
-void process_mem_usage(double &vm_usage, double &resident_set)
-{
-    using std::ifstream;
-    using std::ios_base;
-    using std::string;
-
-    vm_usage = 0.0;
-    resident_set = 0.0;
-
-    // 'file' stat seems to give the most reliable results
-    //
-    ifstream stat_stream("/proc/self/stat", ios_base::in);
-
-    // dummy vars for leading entries in stat that we don't care about
-    //
-    string pid, comm, state, ppid, pgrp, session, tty_nr;
-    string tpgid, flags, minflt, cminflt, majflt, cmajflt;
-    string utime, stime, cutime, cstime, priority, nice;
-    string O, itrealvalue, starttime;
-
-    // the two fields we want
-    //
-    unsigned long vsize;
-    long rss;
-
-    stat_stream >> pid >> comm >> state >> ppid >> pgrp >> session >> tty_nr >> tpgid >> flags >> minflt >> cminflt >>
-      majflt >> cmajflt >> utime >> stime >> cutime >> cstime >> priority >> nice >> O >> itrealvalue >> starttime >>
-      vsize >> rss; // don't care about the rest
-
-    stat_stream.close();
-
-    long page_size_kb = sysconf(_SC_PAGE_SIZE) / 1024; // in case x86-64 is configured to use 2MB pages
-    vm_usage = vsize / 1024.0;
-    resident_set = rss * page_size_kb;
-}
-
-void printMemoryUsage()
-{
-    malloc_trim(0);
-
-    double vm, rss;
-    process_mem_usage(vm, rss);
-    std::cout << "VM: " << unsigned(vm * 0.001) << "MB; RSS: " << unsigned(rss * 0.001) << "MB" << std::endl;
-}
-#else
-void printMemoryUsage()
-{
-}
-#endif
-
 using json = nlohmann::json;
 
 enum class Mode
@@ -97,7 +41,9 @@ enum class Mode
     ExportCircuit,
     ExportWitness,
     Server,
-    Benchmark
+    Benchmark,
+    Build,
+    Synth
 };
 
 namespace libsnark
@@ -141,11 +87,36 @@ static void from_json(const nlohmann::json &j, libsnark::Config &config)
         config.multi_exp_look_ahead = j.at("multi_exp_look_ahead").get<unsigned int>();
     }
 }
+
+static void to_json(nlohmann::json &j, const libsnark::Config &config)
+{
+    j = nlohmann::json{
+      {"num_threads", config.num_threads},
+      {"smt", config.smt},
+      {"fft", config.fft},
+      {"radixes", config.radixes},
+      {"swapAB", config.swapAB},
+      {"multi_exp_c", config.multi_exp_c},
+      {"multi_exp_prefetch_locality", config.multi_exp_prefetch_locality},
+      {"prefetch_stride", config.prefetch_stride},
+      {"multi_exp_look_ahead", config.multi_exp_look_ahead}};
+}
 } // namespace libsnark
 
 struct BenchmarkConfig
 {
     unsigned int num_iterations;
+    // "adaptive" (default) or "grid" (all combinations)
+    std::string search;
+    // The maximum number of passes over all dimensions of the adaptive search
+    unsigned int max_rounds;
+    // A config is stopped as soon as a single proof is this much slower than
+    // the fastest config found so far
+    double early_stop_ratio;
+    // The fastest config is written to this file
+    std::string output;
+    // All measurements are written to this file
+    std::string results;
     std::vector<unsigned int> num_threads;
     std::vector<bool> smt;
     std::vector<std::string> fft;
@@ -161,6 +132,11 @@ struct BenchmarkConfig
 static void from_json(const nlohmann::json &j, BenchmarkConfig &config)
 {
     config.num_iterations = j.at("num_iterations").get<unsigned int>();
+    config.search = j.contains("search") ? j.at("search").get<std::string>() : "adaptive";
+    config.max_rounds = j.contains("max_rounds") ? j.at("max_rounds").get<unsigned int>() : 3;
+    config.early_stop_ratio = j.contains("early_stop_ratio") ? j.at("early_stop_ratio").get<double>() : 1.25;
+    config.output = j.contains("output") ? j.at("output").get<std::string>() : "config.json";
+    config.results = j.contains("results") ? j.at("results").get<std::string>() : "benchmark_results.json";
     config.num_threads = j.at("num_threads").get<std::vector<unsigned int>>();
     config.smt = j.at("smt").get<std::vector<bool>>();
     config.fft = j.at("fft").get<std::vector<std::string>>();
@@ -186,7 +162,7 @@ template <typename T> unsigned int elapsed_time_ms(const T &t1)
 
 template <typename T> void print_time(const T &t1, const char *str)
 {
-    printf("%s (%dms)\n", str, elapsed_time_ms(t1));
+    LOG_INFO(str << " (" << elapsed_time_ms(t1) << "ms)");
 }
 
 bool fileExists(const std::string &fileName)
@@ -203,6 +179,47 @@ void initProverContextBuffers(ProverContextT &context)
     context.aH.resize(context.domain->m + 1, FieldT::one());
 }
 
+// Records the memory usage after a stage when memory profiling is enabled,
+// together with the sizes of the circuit and of the prover (when given)
+void recordMemoryUsage(
+  const std::string &stage,
+  const ethsnarks::ProtoboardT &pb,
+  const ProverContextT *context = nullptr)
+{
+    if (!Loopring::MemoryProfile::isEnabled())
+    {
+        return;
+    }
+    std::map<std::string, size_t> sizes;
+    sizes["pb.values"] = Loopring::getContainerBytes(pb.values);
+    size_t constraintBytes = Loopring::getContainerBytes(pb.constraint_system.constraints);
+    for (const auto &constraint : pb.constraint_system.constraints)
+    {
+        constraintBytes += sizeof(*constraint);
+        constraintBytes += Loopring::getContainerBytes(constraint->getA().getTerms());
+        constraintBytes += Loopring::getContainerBytes(constraint->getB().getTerms());
+        constraintBytes += Loopring::getContainerBytes(constraint->getC().getTerms());
+    }
+    sizes["pb.constraint_system"] = constraintBytes;
+    sizes["constant_storage"] =
+      Loopring::getContainerBytes(libsnark::ConstantStorage<FieldT>::getInstance().constants);
+    if (context)
+    {
+        const ethsnarks::ProvingKeyT &pk = context->provingKey;
+        size_t provingKeyBytes = Loopring::getContainerBytes(pk.A_query);
+        provingKeyBytes += Loopring::getContainerBytes(pk.B_query.values);
+        provingKeyBytes += Loopring::getContainerBytes(pk.B_query.indices);
+        provingKeyBytes += Loopring::getContainerBytes(pk.H_query);
+        provingKeyBytes += Loopring::getContainerBytes(pk.L_query);
+        sizes["proving_key"] = provingKeyBytes;
+        sizes["scratch_exponents"] = Loopring::getContainerBytes(context->scratch_exponents);
+        sizes["aA"] = Loopring::getContainerBytes(context->aA);
+        sizes["aB"] = Loopring::getContainerBytes(context->aB);
+        sizes["aH"] = Loopring::getContainerBytes(context->aH);
+    }
+    Loopring::MemoryProfile::record(stage, sizes);
+}
+
 bool generateKeyPair(ethsnarks::ProtoboardT &pb, std::string &baseFilename)
 {
     std::string provingKeyFilename = baseFilename + "_pk.raw";
@@ -220,11 +237,11 @@ bool generateKeyPair(ethsnarks::ProtoboardT &pb, std::string &baseFilename)
         return true;
     }
 #ifdef GPU_PROVE
-    std::cout << "Generating keys and params..." << std::endl;
+    LOG_INFO("Generating keys and params...");
     int result = stub_genkeys_params_from_pb(
       pb, provingKeyFilename.c_str(), verificationKeyFilename.c_str(), paramsFilename.c_str());
 #else
-    std::cout << "Generating keys..." << std::endl;
+    LOG_INFO("Generating keys...");
     int result = stub_genkeys_from_pb(pb, provingKeyFilename.c_str(), verificationKeyFilename.c_str());
 #endif
     return (result == 0);
@@ -232,11 +249,12 @@ bool generateKeyPair(ethsnarks::ProtoboardT &pb, std::string &baseFilename)
 
 json loadJSON(const std::string &filename)
 {
+    TRACE_SCOPE("loadJSON");
     // Read the JSON file
     std::ifstream file(filename.c_str());
     if (!file.is_open())
     {
-        std::cerr << "Cannot open json file: " << filename << std::endl;
+        LOG_ERROR("Cannot open json file: " << filename);
         return json();
     }
     json input;
@@ -245,14 +263,48 @@ json loadJSON(const std::string &filename)
     return input;
 }
 
-libsnark::Config loadConfig(const std::string &filename)
+libsnark::Config loadConfig(const std::string &filename, std::string &stateStoreFilename)
 {
-    return loadJSON(filename).get<libsnark::Config>();
+    json jConfig = loadJSON(filename);
+    // Optional verbosity of the prover: trace, debug, info, warning, error or none
+    if (jConfig.contains("log_level"))
+    {
+        Loopring::LogLevel level;
+        if (Loopring::Log::parseLevel(jConfig.at("log_level").get<std::string>(), level))
+        {
+            Loopring::Log::setLevel(level);
+            // The prover logs its progress through libff. Only the output is
+            // disabled, the profiling counters are still needed for the
+            // prover timings.
+            libff::inhibit_profiling_info = (level > Loopring::LogLevel::Info);
+        }
+        else
+        {
+            LOG_WARNING("Unknown log_level: " << jConfig.at("log_level").get<std::string>());
+        }
+    }
+    // Optional memory profile of the pipeline stages, written to this file on
+    // exit
+    if (jConfig.contains("memory_profile"))
+    {
+        Loopring::MemoryProfile::start(jConfig.at("memory_profile").get<std::string>());
+    }
+    // Optional Chrome trace of the pipeline, written to this file on exit (and
+    // by the server after every request)
+    if (jConfig.contains("trace"))
+    {
+        Loopring::Trace::start(jConfig.at("trace").get<std::string>());
+    }
+    // Optional state store, -build, -synth and the server build the blocks on
+    // the latest state in it and commit the state after the block once the
+    // block is valid
+    stateStoreFilename = jConfig.value("state_store", "");
+    return jConfig.get<libsnark::Config>();
 }
 
 void loadProvingKey(const std::string &pk_file, ethsnarks::ProvingKeyT &proving_key)
 {
-    std::cout << "Loading proving key " << pk_file << "..." << std::endl;
+    LOG_INFO("Loading proving key " << pk_file << "...");
     auto begin = now();
     auto pk = ethsnarks::load_proving_key(pk_file.c_str());
     proving_key.alpha_g1 = std::move(pk.alpha_g1);
@@ -269,73 +321,254 @@ void loadProvingKey(const std::string &pk_file, ethsnarks::ProvingKeyT &proving_
 
 VerificationKeyT loadVerificationKey(const std::string &vk_file)
 {
-    std::cout << "Loading verification key " << vk_file << "..." << std::endl;
+    LOG_INFO("Loading verification key " << vk_file << "...");
     return vk_from_json(loadJSON(vk_file));
 }
 
-std::string proveCircuit(ProverContextT &context, Loopring::Circuit *circuit)
+std::string proveCircuit(ProverContextT &context, Loopring::Circuit *circuit, Loopring::ProverTimings &timings)
 {
-    std::cout << "Generating proof..." << std::endl;
-    auto begin = now();
-    std::string jProof = ethsnarks::prove(context, circuit->getPb());
-    unsigned int elapsed_ms = elapsed_time_ms(begin);
-    elapsed_ms = elapsed_ms == 0 ? 1 : elapsed_ms;
-    std::cout << "Proof generated in " << float(elapsed_ms) / 1000.0f << " seconds ("
-              << (circuit->getPb().num_constraints() * 10) / (elapsed_ms / 100) << " constraints/second)" << std::endl;
+    LOG_INFO("Generating proof...");
+    Loopring::ProverTimer timer;
+    timer.start();
+    std::string jProof;
+    {
+        TRACE_SCOPE("prove");
+        jProof = ethsnarks::prove(context, circuit->getPb());
+    }
+    timer.stop(timings);
+    Loopring::traceProverBlocks(timings);
+    const double elapsed_ms = std::max(timings.total_ms, 1.0);
+    LOG_INFO(
+      "Proof generated in " << elapsed_ms / 1000.0 << " seconds ("
+                            << (unsigned int)(circuit->getPb().num_constraints() * 1000.0 / elapsed_ms)
+                            << " constraints/second, " << (unsigned int)(timings.thread_utilization * 100.0)
+                            << "% thread utilization)");
+    for (const auto &phase : timings.phases)
+    {
+        LOG_INFO("- " << phase.first << ": " << phase.second << "ms");
+    }
     return jProof;
 }
 
+std::string proveCircuit(ProverContextT &context, Loopring::Circuit *circuit)
+{
+    Loopring::ProverTimings timings;
+    return proveCircuit(context, circuit, timings);
+}
+
 bool writeProof(const std::string &jProof, const std::string &proofFilename)
 {
     std::ofstream fproof(proofFilename);
     if (!fproof.is_open())
     {
-        std::cerr << "Cannot create proof file: " << proofFilename << std::endl;
+        LOG_ERROR("Cannot create proof file: " << proofFilename);
         return false;
     }
     fproof << jProof;
     fproof.close();
-    std::cout << "Proof written to: " << proofFilename << std::endl;
+    LOG_INFO("Proof written to: " << proofFilename);
     return true;
 }
 
-Loopring::Circuit *newCircuit(unsigned int blockType, ethsnarks::ProtoboardT &outPb)
+// Blocks can optionally be proven with a limited number of signature verifiers
+// shared by all transactions
+unsigned int getNumSignatureVerifiers(const json &input)
+{
+    return input.contains("numSignatureVerifiers") ? input["numSignatureVerifiers"].get<unsigned int>() : 0;
+}
+
+Loopring::Circuit *newCircuit(
+  unsigned int blockType,
+  unsigned int numSignatureVerifiers,
+  ethsnarks::ProtoboardT &outPb)
 {
-    return new Loopring::UniversalCircuit(outPb, "circuit");
+    return new Loopring::UniversalCircuit(outPb, "circuit", numSignatureVerifiers);
 }
 
-Loopring::Circuit *createCircuit(unsigned int blockType, unsigned int blockSize, ethsnarks::ProtoboardT &outPb)
+Loopring::Circuit *createCircuit(
+  unsigned int blockType,
+  unsigned int blockSize,
+  unsigned int numSignatureVerifiers,
+  ethsnarks::ProtoboardT &outPb)
 {
-    std::cout << "Creating circuit... " << std::endl;
+    TRACE_SCOPE("createCircuit");
+    LOG_INFO("Creating circuit... ");
     auto begin = now();
-    Loopring::Circuit *circuit = newCircuit(blockType, outPb);
+    Loopring::Circuit *circuit = newCircuit(blockType, numSignatureVerifiers, outPb);
     circuit->generateConstraints(blockSize);
     circuit->printInfo();
     print_time(begin, "Circuit created");
     return circuit;
 }
 
-bool generateWitness(Loopring::Circuit *circuit, const json &input)
+bool generateWitness(Loopring::Circuit *circuit, const json &input, bool incremental = false)
 {
-    std::cout << "Generating witness... " << std::endl;
+    LOG_INFO("Generating witness... ");
     auto begin = now();
-    if (!circuit->generateWitness(input))
+    if (!(incremental ? circuit->generateWitnessIncremental(input) : circuit->generateWitness(input)))
     {
-        std::cerr << "Could not generate witness!" << std::endl;
+        LOG_ERROR("Could not generate witness!");
         return false;
     }
     print_time(begin, "Witness generated");
     return true;
 }
 
+// Stores the state after a built block in the state store (when used), only
+// called once the block is valid
+bool commitState(Loopring::PendingState &pendingState)
+{
+    if (!pendingState.hasStore())
+    {
+        return true;
+    }
+    if (!pendingState.commit())
+    {
+        LOG_ERROR("Could not commit the state after block " << pendingState.getBlockIdx() << "!");
+        return false;
+    }
+    LOG_INFO("State after block " << pendingState.getBlockIdx() << " committed");
+    return true;
+}
+
+// Builds the block from the block input (the input of create_block.py) on the
+// state after the previous block and generates the witness directly from it.
+// With a state store the block is built on its latest snapshot (only the
+// accounts used by the block are read). The state after the block is kept in
+// pendingState, it is committed with commitState once the block is valid.
+bool buildWitness(
+  Loopring::Circuit *circuit,
+  const json &input,
+  const char *stateFilename,
+  Loopring::PendingState &pendingState)
+{
+    LOG_INFO("Building block... ");
+    auto begin = now();
+    Loopring::ExchangeState &state = pendingState.getState();
+    if (pendingState.isFromSnapshot())
+    {
+        if (stateFilename != nullptr)
+        {
+            LOG_WARNING("The state is read from the state store, " << stateFilename << " is not used");
+        }
+    }
+    else if (stateFilename != nullptr)
+    {
+        json jState = loadJSON(stateFilename);
+        if (jState == json())
+        {
+            return false;
+        }
+        state.load(jState);
+    }
+    Loopring::Block block;
+    if (!Loopring::buildBlock(state, input, block))
+    {
+        LOG_ERROR("Could not build block!");
+        return false;
+    }
+    print_time(begin, "Block built");
+
+    LOG_INFO("Generating witness... ");
+    begin = now();
+    if (!circuit->generateWitness(block))
+    {
+        LOG_ERROR("Could not generate witness!");
+        return false;
+    }
+    print_time(begin, "Witness generated");
+    return true;
+}
+
+bool writeJSON(const json &data, const std::string &filename)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        LOG_ERROR("Cannot create json file: " << filename);
+        return false;
+    }
+    file << data.dump(4);
+    file.close();
+    return true;
+}
+
+// With a state store the generated state and the block are committed as the
+// first block (with commitState once the block is valid), the store needs to
+// be empty
+bool synthWitness(
+  Loopring::Circuit *circuit,
+  const json &jConfig,
+  const char *blockFilename,
+  const char *stateFilename,
+  Loopring::PendingState &pendingState)
+{
+    if (pendingState.isFromSnapshot())
+    {
+        LOG_ERROR("The state store already contains block " << (pendingState.getBlockIdx() - 1) << "!");
+        return false;
+    }
+    LOG_INFO("Generating block... ");
+    auto begin = now();
+    Loopring::BlockGenerator generator(jConfig.get<Loopring::BlockGeneratorConfig>());
+    Loopring::ExchangeState &state = pendingState.getState();
+    generator.setupState(state);
+    json input;
+    if (!generator.generateBlock(input))
+    {
+        LOG_ERROR("Could not generate block!");
+        return false;
+    }
+    const json jState = (blockFilename != nullptr) ? state.save() : json();
+    Loopring::Block block;
+    if (!Loopring::buildBlock(state, input, block))
+    {
+        LOG_ERROR("Could not build block!");
+        return false;
+    }
+    print_time(begin, "Block generated");
+
+    LOG_INFO("Generating witness... ");
+    begin = now();
+    // The operator signs the block once its message is known
+    const Loopring::BlockSigner signer = generator.getBlockSigner();
+    Loopring::Signature blockSignature;
+    circuit->setBlockSigner([&](const FieldT &message) {
+        blockSignature = signer(message);
+        return blockSignature;
+    });
+    const bool generated = circuit->generateWitness(block);
+    circuit->setBlockSigner(nullptr);
+    if (!generated)
+    {
+        LOG_ERROR("Could not generate witness!");
+        return false;
+    }
+    print_time(begin, "Witness generated");
+
+    // The signed block input and the state before the block can be built
+    // again with -build
+    input["signature"] = Loopring::toJSON(blockSignature);
+    if (blockFilename != nullptr && (!writeJSON(input, blockFilename) || !writeJSON(jState, stateFilename)))
+    {
+        return false;
+    }
+    return true;
+}
+
 bool validateCircuit(Loopring::Circuit *circuit)
 {
-    std::cout << "Validating block..." << std::endl;
+    TRACE_SCOPE("validateCircuit");
+    LOG_INFO("Validating block...");
     auto begin = now();
     // Check if the inputs are valid for the circuit
-    if (!circuit->getPb().is_satisfied())
+    Loopring::ConstraintFailure failure;
+    if (!Loopring::checkConstraints(circuit->getPb(), &failure))
     {
-        std::cerr << "Block is not valid!" << std::endl;
+        LOG_ERROR("Block is not valid!");
+        LOG_ERROR(
+          "Constraint " << failure.index << " failed (" << failure.annotation << "): " << failure.a << " * "
+                        << failure.b << " != " << failure.c);
         return false;
     }
     print_time(begin, "Block is valid");
@@ -360,6 +593,7 @@ void runServer(
   Loopring::Circuit *circuit,
   const std::string &provingKeyFilename,
   const libsnark::Config &config,
+  Loopring::StateStore *stateStore,
   unsigned int port)
 {
     using namespace httplib;
@@ -398,9 +632,16 @@ void runServer(
     context.config = config;
     context.domain = get_domain(circuit->getPb(), context.provingKey, config);
     initProverContextBuffers(context);
+    recordMemoryUsage("initProver", circuit->getPb(), &context);
 
     // Prover status info
     ProverStatus proverStatus;
+    // Timings of the proofs generated by the server, with a separate lock so
+    // they can be read while proving
+    std::mutex metricsMutex;
+    unsigned int numProofs = 0;
+    double totalProveTime_ms = 0.0;
+    json lastProofTimings;
     // Lock for the prover
     std::mutex mtx;
     // Setup the server
@@ -408,17 +649,35 @@ void runServer(
     // Called to prove blocks
     svr.Get("/prove", [&](const Request &req, Response &res) {
         const std::lock_guard<std::mutex> lock(mtx);
+        // The trace and the memory profile (when enabled) only keep the last
+        // request so they do not grow while the server is running
+        Loopring::TraceWriter traceWriter(true);
+        Loopring::MemoryProfileWriter memoryProfileWriter(true);
 
         // Parse the parameters
         std::string blockFilename = req.get_param_value("block_filename");
         std::string proofFilename = req.get_param_value("proof_filename");
+        // Blocks are validated unless explicitly disabled
         std::string strValidate = req.get_param_value("validate");
-        bool validate = (strValidate.compare("true") == 0) ? true : false;
+        bool validate = (strValidate.compare("false") == 0) ? false : true;
+        // Only regenerate the witness for what changed compared to the previous
+        // block when explicitly enabled
+        std::string strIncremental = req.get_param_value("incremental");
+        bool incremental = (strIncremental.compare("true") == 0) ? true : false;
+        // The block is a block input that is built on the latest state in the
+        // state store when enabled
+        std::string strBuild = req.get_param_value("build");
+        bool build = (strBuild.compare("true") == 0) ? true : false;
         if (blockFilename.length() == 0)
         {
             res.set_content("Error: block_filename missing!\n", "text/plain");
             return;
         }
+        if (build && stateStore == nullptr)
+        {
+            res.set_content("Error: No state_store in config.json!\n", "text/plain");
+            return;
+        }
 
         // Set the prover status for this session
         ProverStatusRAII statusRAII(proverStatus, blockFilename, proofFilename);
@@ -432,9 +691,11 @@ void runServer(
         }
 
         // Some checks to see if this block is compatible with the loaded circuit
-        int iBlockType = input["blockType"].get<int>();
-        unsigned int blockSize = input["blockSize"].get<int>();
-        if (/*iBlockType & circuit->getBlockType() != 1 || */ blockSize != circuit->getBlockSize())
+        int iBlockType = input.contains("blockType") ? input["blockType"].get<int>() : 0;
+        unsigned int blockSize =
+          input.contains("blockSize") ? input["blockSize"].get<int>() : input["transactions"].size();
+        if (/*iBlockType & circuit->getBlockType() != 1 || */ blockSize != circuit->getBlockSize() ||
+            getNumSignatureVerifiers(input) != circuit->getNumSignatureVerifiers())
         {
             res.set_content(
               "Error: Incompatible block requested! Use /info to check "
@@ -443,11 +704,22 @@ void runServer(
             return;
         }
 
-        if (!generateWitness(circuit, input))
+        // The state after a built block is only committed once it is proven
+        Loopring::PendingState pendingState(build ? stateStore : nullptr);
+        if (build)
+        {
+            if (!buildWitness(circuit, input, nullptr, pendingState))
+            {
+                res.set_content("Error: Failed to build block!\n", "text/plain");
+                return;
+            }
+        }
+        else if (!generateWitness(circuit, input, incremental))
         {
             res.set_content("Error: Failed to generate witness for block!\n", "text/plain");
             return;
         }
+        recordMemoryUsage("generateWitness", circuit->getPb(), &context);
         if (validate)
         {
             if (!validateCircuit(circuit))
@@ -456,12 +728,25 @@ void runServer(
                 return;
             }
         }
-        std::string jProof = proveCircuit(context, circuit);
+        Loopring::ProverTimings timings;
+        std::string jProof = proveCircuit(context, circuit, timings);
         if (jProof.length() == 0)
         {
             res.set_content("Error: Failed to prove block!\n", "text/plain");
             return;
         }
+        recordMemoryUsage("prove", circuit->getPb(), &context);
+        if (!commitState(pendingState))
+        {
+            res.set_content("Error: Failed to commit the state!\n", "text/plain");
+            return;
+        }
+        {
+            const std::lock_guard<std::mutex> metricsLock(metricsMutex);
+            numProofs++;
+            totalProveTime_ms += timings.total_ms;
+            lastProofTimings = timings;
+        }
         if (proofFilename.length() != 0)
         {
             if (!writeProof(jProof, proofFilename))
@@ -485,10 +770,21 @@ void runServer(
             res.set_content("Idle\n", "text/plain");
         }
     });
+    // Timings of the prover phases of the last proof
+    svr.Get("/metrics", [&](const Request &req, Response &res) {
+        const std::lock_guard<std::mutex> lock(metricsMutex);
+        json metrics;
+        metrics["num_proofs"] = numProofs;
+        metrics["average_prove_ms"] = (numProofs > 0) ? totalProveTime_ms / numProofs : 0.0;
+        metrics["last_proof"] = lastProofTimings;
+        res.set_content(metrics.dump(4) + "\n", "application/json");
+    });
     // Info of this prover server
     svr.Get("/info", [&](const Request &req, Response &res) {
         std::string info = std::string("BlockType: ") + std::to_string(int(circuit->getBlockType())) +
-                           std::string("; BlockSize: ") + std::to_string(circuit->getBlockSize()) + "\n";
+                           std::string("; BlockSize: ") + std::to_string(circuit->getBlockSize()) +
+                           std::string("; NumSignatureVerifiers: ") +
+                           std::to_string(circuit->getNumSignatureVerifiers()) + "\n";
         res.set_content(info, "text/plain");
     });
     // Stops the prover server
@@ -502,140 +798,432 @@ void runServer(
         content += "Prover server:\n";
         content += "- Prove a block: "
                    "/prove?block_filename=<block.json>&proof_filename=<proof.json>&"
-                   "validate=true (proof_filename and validate are optional)\n";
+                   "validate=false (proof_filename and validate are optional, blocks are validated by default)\n";
+        content += "  Add incremental=true to only regenerate the witness of the transactions that changed compared "
+                   "to the previously proven block\n";
+        content += "  Add build=true to build the block from a block input (block_info.json) on the latest state in "
+                   "the state_store of config.json and commit the state after the block once it is proven\n";
         content += "- Status of the server: /status (busy proving a block or not)\n";
         content += "- Info of the server: /info (which blocks can be proven)\n";
+        content += "- Prover metrics: /metrics (the time spent in each phase of the last proof)\n";
         content += "- Shut down the server: /stop (will first finish generating "
                    "the proof if busy)\n";
         res.set_content(content, "text/plain");
     });
 
-    std::cout << "Running server on 'localhost' on port " << port << std::endl;
+    LOG_INFO("Running server on 'localhost' on port " << port);
     svr.listen("127.0.0.1", port);
 }
 
-bool runBenchmark(Loopring::Circuit *circuit, const std::string &provingKeyFilename)
+// A dimension of the prover config search space
+struct ConfigDimension
 {
-    // Load the proving key a single time
-    ProverContextT context;
-    loadProvingKey(provingKeyFilename, context.provingKey);
-    context.constraint_system = &(circuit->getPb().constraint_system);
+    std::string name;
+    size_t numValues;
+    // Sets the value with the given index on the config
+    std::function<void(libsnark::Config &, size_t)> set;
+};
 
-    VerificationKeyT vk =
-      loadVerificationKey(provingKeyFilename.substr(0, provingKeyFilename.length() - 6) + "vk.json");
+template <typename T, typename M>
+static ConfigDimension getConfigDimension( //
+  const std::string &name,
+  const std::vector<T> &values,
+  M libsnark::Config::*member)
+{
+    return {name, values.size(), [&values, member](libsnark::Config &config, size_t i) { config.*member = values[i]; }};
+}
 
-    if (!validateCircuit(circuit))
+// Ordered by their expected impact on the proving time
+static std::vector<ConfigDimension> getConfigDimensions(const BenchmarkConfig &b)
+{
+    return {
+      getConfigDimension("num_threads", b.num_threads, &libsnark::Config::num_threads),
+      getConfigDimension("multi_exp_c", b.multi_exp_c, &libsnark::Config::multi_exp_c),
+      getConfigDimension("fft", b.fft, &libsnark::Config::fft),
+      getConfigDimension("radixes", b.radixes, &libsnark::Config::radixes),
+      getConfigDimension("swapAB", b.swapAB, &libsnark::Config::swapAB),
+      getConfigDimension("smt", b.smt, &libsnark::Config::smt),
+      getConfigDimension("prefetch_stride", b.prefetch_stride, &libsnark::Config::prefetch_stride),
+      getConfigDimension(
+        "multi_exp_prefetch_locality", b.multi_exp_prefetch_locality, &libsnark::Config::multi_exp_prefetch_locality),
+      getConfigDimension("multi_exp_look_ahead", b.multi_exp_look_ahead, &libsnark::Config::multi_exp_look_ahead)};
+}
+
+static libsnark::Config getConfig(const std::vector<ConfigDimension> &dimensions, const std::vector<size_t> &indices)
+{
+    libsnark::Config config;
+    for (size_t d = 0; d < dimensions.size(); d++)
     {
-        return false;
+        dimensions[d].set(config, indices[d]);
     }
+    return config;
+}
 
-    // Get all configs to benchmark from the benchmark config
-    BenchmarkConfig benchmarkConfig = loadJSON("benchmark.json").get<BenchmarkConfig>();
+struct IterationResult
+{
+    double witness_ms;
+    double prove_ms;
+    // The time spent in each profiling block of the prover (e.g. the FFTs and
+    // the multi-exponentiations)
+    std::map<std::string, double> stages;
+    // The same time grouped per phase of the prover
+    std::map<std::string, double> phases;
+    double thread_utilization;
+};
 
-    // Create all configs
-    std::vector<libsnark::Config> configs;
-    for (auto num_threads : benchmarkConfig.num_threads)
+static void to_json(json &j, const IterationResult &result)
+{
+    j = json{
+      {"witness_ms", result.witness_ms},
+      {"prove_ms", result.prove_ms},
+      {"stages", result.stages},
+      {"phases", result.phases},
+      {"thread_utilization", result.thread_utilization}};
+}
+
+struct ConfigResult
+{
+    libsnark::Config config;
+    // The average of the proofs that were done
+    unsigned int duration_ms;
+    unsigned int num_iterations;
+    // Stopped before all iterations were done because it was too slow
+    bool stopped;
+    std::vector<IterationResult> iterations;
+
+    static bool compareResult(const ConfigResult &a, const ConfigResult &b)
     {
-        for (auto smt : benchmarkConfig.smt)
+        return (a.duration_ms < b.duration_ms);
+    }
+};
+
+static double toMilliseconds(const std::chrono::high_resolution_clock::duration &duration)
+{
+    return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(duration).count();
+}
+
+// Generates the witness and proves the block num_iterations times with the
+// config. Stops as soon as a proof takes longer than maxDuration_ms (when not 0).
+bool measureConfig(
+  ProverContextT &context,
+  Loopring::Circuit *circuit,
+  const json &input,
+  const VerificationKeyT &vk,
+  const libsnark::Config &config,
+  unsigned int num_iterations,
+  unsigned int maxDuration_ms,
+  ConfigResult &result)
+{
+    LOG_INFO("*****************************");
+    LOG_INFO("Config: " << config);
+    LOG_INFO("*****************************");
+#ifdef MULTICORE
+    omp_set_num_threads(config.num_threads);
+#endif
+
+    context.config = config;
+    context.domain = get_domain(circuit->getPb(), context.provingKey, config);
+    initProverContextBuffers(context);
+    // The prover buffers depend on the config
+    std::stringstream configName;
+    configName << config;
+    recordMemoryUsage("initProver " + configName.str(), circuit->getPb(), &context);
+
+    result.config = config;
+    result.num_iterations = 0;
+    result.stopped = false;
+    result.iterations.clear();
+    unsigned int totalTime = 0;
+    for (unsigned int l = 0; l < num_iterations; l++)
+    {
+        IterationResult iteration;
+        auto begin = now();
+        if (!generateWitness(circuit, input))
+        {
+            return false;
+        }
+        iteration.witness_ms = toMilliseconds(now() - begin);
+
+        Loopring::ProverTimings timings;
+        std::string jProof = proveCircuit(context, circuit, timings);
+        if (jProof.length() == 0)
+        {
+            return false;
+        }
+        if (l == 0)
+        {
+            recordMemoryUsage("prove " + configName.str(), circuit->getPb(), &context);
+        }
+        iteration.prove_ms = timings.total_ms;
+        iteration.stages = timings.blocks;
+        iteration.phases = timings.phases;
+        iteration.thread_utilization = timings.thread_utilization;
+        const unsigned int duration_ms = timings.total_ms;
+
+        std::stringstream proof_stream;
+        proof_stream << jProof;
+        auto proof_pair = proof_from_json(proof_stream);
+
+        if (!libsnark::r1cs_gg_ppzksnark_zok_verifier_strong_IC<ppT>(vk, proof_pair.first, proof_pair.second))
+        {
+            LOG_ERROR("Invalid proof!");
+            return false;
+        }
+
+        totalTime += duration_ms;
+        result.num_iterations++;
+        result.iterations.push_back(iteration);
+        if (maxDuration_ms > 0 && duration_ms > maxDuration_ms)
+        {
+            LOG_INFO("Stopped: " << duration_ms << "ms, the limit is " << maxDuration_ms << "ms");
+            result.stopped = (result.num_iterations < num_iterations);
+            break;
+        }
+    }
+    result.duration_ms = totalTime / result.num_iterations;
+    return true;
+}
+
+// Coordinate descent: starting from the first value of every dimension, the
+// values of a single dimension are tried while the others are kept fixed. The
+// fastest value is kept before moving on to the next dimension. Stops when a
+// round over all dimensions did not find a faster config.
+bool searchConfigAdaptive(
+  ProverContextT &context,
+  Loopring::Circuit *circuit,
+  const json &input,
+  const VerificationKeyT &vk,
+  const BenchmarkConfig &benchmarkConfig,
+  std::vector<ConfigResult> &results)
+{
+    const std::vector<ConfigDimension> dimensions = getConfigDimensions(benchmarkConfig);
+
+    std::vector<size_t> best(dimensions.size(), 0);
+    ConfigResult bestResult;
+    if (!measureConfig(
+          context, circuit, input, vk, getConfig(dimensions, best), benchmarkConfig.num_iterations, 0, bestResult))
+    {
+        return false;
+    }
+    results.push_back(bestResult);
+
+    std::set<std::vector<size_t>> measured = {best};
+    for (unsigned int round = 0; round < benchmarkConfig.max_rounds; round++)
+    {
+        bool improved = false;
+        for (size_t d = 0; d < dimensions.size(); d++)
         {
-            for (auto prefetch_stride : benchmarkConfig.prefetch_stride)
+            for (size_t i = 0; i < dimensions[d].numValues; i++)
             {
-                for (auto swapAB : benchmarkConfig.swapAB)
+                std::vector<size_t> candidate = best;
+                candidate[d] = i;
+                if (!measured.insert(candidate).second)
+                {
+                    continue;
+                }
+
+                ConfigResult result;
+                const unsigned int maxDuration_ms = bestResult.duration_ms * benchmarkConfig.early_stop_ratio;
+                if (!measureConfig(
+                      context,
+                      circuit,
+                      input,
+                      vk,
+                      getConfig(dimensions, candidate),
+                      benchmarkConfig.num_iterations,
+                      maxDuration_ms,
+                      result))
+                {
+                    return false;
+                }
+                results.push_back(result);
+
+                if (!result.stopped && result.duration_ms < bestResult.duration_ms)
                 {
-                    for (auto fft : benchmarkConfig.fft)
-                    {
-                        for (auto radixes : benchmarkConfig.radixes)
-                        {
-                            for (auto multi_exp_c : benchmarkConfig.multi_exp_c)
-                            {
-                                for (auto multi_exp_prefetch_locality : benchmarkConfig.multi_exp_prefetch_locality)
-                                {
-                                    for (auto multi_exp_look_ahead : benchmarkConfig.multi_exp_look_ahead)
-                                    {
-                                        libsnark::Config config;
-                                        config.num_threads = num_threads;
-                                        config.smt = smt;
-                                        config.prefetch_stride = prefetch_stride;
-                                        config.swapAB = swapAB;
-                                        config.fft = fft;
-                                        config.radixes = radixes;
-                                        config.multi_exp_c = multi_exp_c;
-                                        config.multi_exp_prefetch_locality = multi_exp_prefetch_locality;
-                                        config.multi_exp_look_ahead = multi_exp_look_ahead;
-                                        configs.push_back(config);
-                                    }
-                                }
-                            }
-                        }
-                    }
+                    LOG_INFO("Faster " << dimensions[d].name << " (" << result.duration_ms << "ms)");
+                    best = candidate;
+                    bestResult = result;
+                    improved = true;
                 }
             }
         }
+        if (!improved)
+        {
+            break;
+        }
     }
+    return true;
+}
 
-    unsigned int num_iterations = benchmarkConfig.num_iterations;
+// Tries all combinations, configs that are clearly slower than the fastest
+// config so far are still stopped early
+bool searchConfigGrid(
+  ProverContextT &context,
+  Loopring::Circuit *circuit,
+  const json &input,
+  const VerificationKeyT &vk,
+  const BenchmarkConfig &benchmarkConfig,
+  std::vector<ConfigResult> &results)
+{
+    const std::vector<ConfigDimension> dimensions = getConfigDimensions(benchmarkConfig);
 
-    struct Result
+    unsigned int best_ms = 0;
+    std::vector<size_t> indices(dimensions.size(), 0);
+    while (true)
     {
-        libsnark::Config config;
-        unsigned int duration_ms;
+        ConfigResult result;
+        const unsigned int maxDuration_ms = best_ms * benchmarkConfig.early_stop_ratio;
+        if (!measureConfig(
+              context,
+              circuit,
+              input,
+              vk,
+              getConfig(dimensions, indices),
+              benchmarkConfig.num_iterations,
+              maxDuration_ms,
+              result))
+        {
+            return false;
+        }
+        results.push_back(result);
+        if (!result.stopped && (best_ms == 0 || result.duration_ms < best_ms))
+        {
+            best_ms = result.duration_ms;
+        }
 
-        static bool compareResult(Result a, Result b)
+        // Next combination
+        size_t d = 0;
+        while (d < dimensions.size() && ++indices[d] == dimensions[d].numValues)
         {
-            return (a.duration_ms < b.duration_ms);
+            indices[d++] = 0;
         }
-    };
-    std::vector<Result> results;
-    for (auto config : configs)
+        if (d == dimensions.size())
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+// Writes the prover config, other settings of an existing file (e.g.
+// log_level) are kept
+bool writeConfig(const libsnark::Config &config, const std::string &filename)
+{
+    json jConfig = fileExists(filename) ? loadJSON(filename) : json::object();
+    if (!jConfig.is_object())
     {
-        std::cout << "*****************************" << std::endl;
-        std::cout << "Config: " << config << std::endl;
-        std::cout << "*****************************" << std::endl;
-#ifdef MULTICORE
-        omp_set_num_threads(config.num_threads);
-#endif
+        jConfig = json::object();
+    }
+    jConfig.update(json(config));
+    return writeJSON(jConfig, filename);
+}
 
-        context.config = config;
-        context.domain = get_domain(circuit->getPb(), context.provingKey, config);
-        initProverContextBuffers(context);
+// Writes all measurements together with the system they were measured on, the
+// results can be compared with -compare
+bool writeBenchmarkResults(
+  Loopring::Circuit *circuit,
+  const BenchmarkConfig &benchmarkConfig,
+  const std::vector<ConfigResult> &results)
+{
+    json jResults = json::array();
+    for (const ConfigResult &result : results)
+    {
+        const double prove_ms = std::max(result.duration_ms, 1u);
+        jResults.push_back(
+          {{"config", result.config},
+           {"stopped", result.stopped},
+           {"prove_ms", result.duration_ms},
+           {"constraints_per_second", circuit->getPb().num_constraints() * 1000.0 / prove_ms},
+           {"iterations", result.iterations}});
+    }
 
-        unsigned int totalTime = 0;
-        for (unsigned int l = 0; l < num_iterations; l++)
-        {
-            auto begin = now();
-            std::string jProof = proveCircuit(context, circuit);
-            totalTime += elapsed_time_ms(begin);
-            if (jProof.length() == 0)
-            {
-                return false;
-            }
+    json output = getSystemInfo();
+    output["constraints"] = circuit->getPb().num_constraints();
+    output["variables"] = circuit->getPb().num_variables();
+    output["search"] = benchmarkConfig.search;
+    output["results"] = jResults;
+    return writeJSON(output, benchmarkConfig.results);
+}
 
-            std::stringstream proof_stream;
-            proof_stream << jProof;
-            auto proof_pair = proof_from_json(proof_stream);
+bool runBenchmark(Loopring::Circuit *circuit, const std::string &provingKeyFilename, const json &input)
+{
+    // Load the proving key a single time
+    ProverContextT context;
+    loadProvingKey(provingKeyFilename, context.provingKey);
+    context.constraint_system = &(circuit->getPb().constraint_system);
+    recordMemoryUsage("loadProvingKey", circuit->getPb(), &context);
 
-            if (!libsnark::r1cs_gg_ppzksnark_zok_verifier_strong_IC<ppT>(vk, proof_pair.first, proof_pair.second))
-            {
-                std::cerr << "Invalid proof!" << std::endl;
-                return false;
-            }
+    VerificationKeyT vk =
+      loadVerificationKey(provingKeyFilename.substr(0, provingKeyFilename.length() - 6) + "vk.json");
+
+    if (!validateCircuit(circuit))
+    {
+        return false;
+    }
+
+    // Get all configs to benchmark from the benchmark config
+    BenchmarkConfig benchmarkConfig = loadJSON("benchmark.json").get<BenchmarkConfig>();
+    for (const ConfigDimension &dimension : getConfigDimensions(benchmarkConfig))
+    {
+        if (dimension.numValues == 0)
+        {
+            LOG_ERROR("No values to benchmark for " << dimension.name);
+            return false;
         }
+    }
+    if (benchmarkConfig.num_iterations == 0)
+    {
+        LOG_ERROR("num_iterations needs to be at least 1");
+        return false;
+    }
 
-        Result result;
-        result.config = config;
-        result.duration_ms = totalTime / num_iterations;
-        results.push_back(result);
+    std::vector<ConfigResult> results;
+    if (benchmarkConfig.search == "grid")
+    {
+        if (!searchConfigGrid(context, circuit, input, vk, benchmarkConfig, results))
+        {
+            return false;
+        }
+    }
+    else if (benchmarkConfig.search == "adaptive")
+    {
+        if (!searchConfigAdaptive(context, circuit, input, vk, benchmarkConfig, results))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        LOG_ERROR("Unknown search: " << benchmarkConfig.search);
+        return false;
     }
 
-    std::sort(results.begin(), results.end(), Result::compareResult);
+    std::sort(results.begin(), results.end(), ConfigResult::compareResult);
+    // Configs that were stopped early are slower than all completed configs
+    std::stable_partition(results.begin(), results.end(), [](const ConfigResult &result) {
+        return !result.stopped;
+    });
 
-    std::cout << "Benchmark results:" << std::endl;
+    LOG_INFO("Benchmark results:");
     for (unsigned int i = 0; i < results.size(); i++)
     {
         const libsnark::Config &config = results[i].config;
-        std::cout << i << ". " << config << " (" << results[i].duration_ms << "ms)" << std::endl;
+        LOG_INFO(
+          i << ". " << config << " (" << results[i].duration_ms << "ms"
+            << (results[i].stopped ? ", stopped early" : "") << ")");
     }
 
+    if (!writeConfig(results[0].config, benchmarkConfig.output))
+    {
+        return false;
+    }
+    LOG_INFO("Fastest config written to " << benchmarkConfig.output);
+
+    if (!writeBenchmarkResults(circuit, benchmarkConfig, results))
+    {
+        return false;
+    }
+    LOG_INFO("Results written to " << benchmarkConfig.results);
     return true;
 }
 
@@ -643,16 +1231,22 @@ int main(int argc, char **argv)
 {
     ethsnarks::ppT::init_public_params();
 
+    // Writes the trace and the memory profile on exit when enabled in the
+    // config
+    Loopring::TraceWriter traceWriter;
+    Loopring::MemoryProfileWriter memoryProfileWriter;
+
     // Load in the config
-    libsnark::Config config = loadConfig("config.json");
-    std::cout << "Config: " << config << std::endl;
+    std::string stateStoreFilename;
+    libsnark::Config config = loadConfig("config.json", stateStoreFilename);
+    LOG_INFO("Config: " << config);
 
 #ifdef MULTICORE
     // omp_set_nested is needed for gcc for some reason
     omp_set_nested(1);
     omp_set_max_active_levels(5);
-    std::cout << "Num threads available: " << omp_get_max_threads() << std::endl;
-    std::cout << "Num processors available: " << omp_get_num_procs() << std::endl;
+    LOG_INFO("Num threads available: " << omp_get_max_threads());
+    LOG_INFO("Num processors available: " << omp_get_num_procs());
 #endif
 
     if (argc < 3)
@@ -662,6 +1256,9 @@ int main(int argc, char **argv)
         std::cerr << "-prove <block.json> <out_proof.json>: Proves a block" << std::endl;
         std::cerr << "-createkeys <protoBlock.json>: Creates prover/verifier keys" << std::endl;
         std::cerr << "-verify <vk.json> <proof.json>: Verify a proof" << std::endl;
+        std::cerr << "-compare <baseline.json> <results.json> [max_slowdown_percent]: Compares the results of "
+                     "-benchmark or dex_circuit_bench with a baseline (fails on a significant slowdown, 3% by default)"
+                  << std::endl;
         std::cerr << "-exportcircuit <block.json> <circuit.json>: Exports the rc1s "
                      "circuit to json (circom - not all fields)"
                   << std::endl;
@@ -681,7 +1278,16 @@ int main(int argc, char **argv)
                      "HTTP server to prove blocks on demand"
                   << std::endl;
         std::cerr << "-benchmark <block.json>: Try out multiple prover options to "
-                     "find the fastest configuration on the system"
+                     "find the fastest configuration on the system (written to config.json by default)"
+                  << std::endl;
+        std::cerr << "-build <block_info.json> [state.json]: Builds a block from the "
+                     "transactions on the state (the empty state by default) and validates it"
+                  << std::endl;
+        std::cerr << "-synth <synth.json> [block_info.json state.json]: Generates a block with random "
+                     "transactions and validates it, the block and the state can be saved for -build"
+                  << std::endl;
+        std::cerr << "With a state_store in config.json -build, -synth and the server build the blocks on the "
+                     "latest state in the store and commit the state after each block once it is valid"
                   << std::endl;
         return 1;
     }
@@ -692,134 +1298,184 @@ int main(int argc, char **argv)
     if (strcmp(argv[1], "-validate") == 0)
     {
         mode = Mode::Validate;
-        std::cout << "Validating " << argv[2] << "..." << std::endl;
+        LOG_INFO("Validating " << argv[2] << "...");
     }
     else if (strcmp(argv[1], "-prove") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
         mode = Mode::Prove;
         proofFilename = argv[3];
-        std::cout << "Proving " << argv[2] << "..." << std::endl;
+        LOG_INFO("Proving " << argv[2] << "...");
     }
     else if (strcmp(argv[1], "-createkeys") == 0)
     {
         if (argc != 3)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
         mode = Mode::CreateKeys;
-        std::cout << "Creating keys for " << argv[2] << "..." << std::endl;
+        LOG_INFO("Creating keys for " << argv[2] << "...");
     }
     else if (strcmp(argv[1], "-verify") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
-        std::cout << "Verify for " << argv[3] << " ..." << std::endl;
+        LOG_INFO("Verify for " << argv[3] << " ...");
         if (stub_main_verify(argv[0], argc - 1, (const char **)(argv + 1)))
         {
             return 1;
         }
-        std::cout << "Proof is valid" << std::endl;
+        LOG_INFO("Proof is valid");
+        return 0;
+    }
+    else if (strcmp(argv[1], "-compare") == 0)
+    {
+        if (argc != 4 && argc != 5)
+        {
+            LOG_ERROR("Invalid number of arguments!");
+            return 1;
+        }
+        const double maxSlowdown = (argc == 5 ? std::stod(argv[4]) : 3.0) / 100.0;
+        std::vector<Loopring::BenchmarkComparison> comparisons;
+        if (!Loopring::compareBenchmarkResults(loadJSON(argv[2]), loadJSON(argv[3]), maxSlowdown, comparisons))
+        {
+            return 1;
+        }
+        unsigned int numRegressions = 0;
+        for (const Loopring::BenchmarkComparison &comparison : comparisons)
+        {
+            LOG_INFO(
+              comparison.name << ": " << comparison.baselineMean << " -> " << comparison.mean << " ("
+                              << (comparison.change >= 0.0 ? "+" : "") << comparison.change * 100.0 << "%, p="
+                              << comparison.pValue << ")" << (comparison.regression ? " REGRESSION" : ""));
+            numRegressions += comparison.regression ? 1 : 0;
+        }
+        if (numRegressions > 0)
+        {
+            LOG_ERROR(numRegressions << " of " << comparisons.size() << " measurements are significantly slower");
+            return 1;
+        }
+        LOG_INFO("No significant regressions in " << comparisons.size() << " measurements");
         return 0;
     }
     else if (strcmp(argv[1], "-exportcircuit") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
         mode = Mode::ExportCircuit;
-        std::cout << "Exporting circuit for " << argv[2] << "..." << std::endl;
+        LOG_INFO("Exporting circuit for " << argv[2] << "...");
     }
     else if (strcmp(argv[1], "-exportwitness") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
         mode = Mode::ExportWitness;
-        std::cout << "Exporting witness for " << argv[2] << "..." << std::endl;
+        LOG_INFO("Exporting witness for " << argv[2] << "...");
     }
     else if (strcmp(argv[1], "-createpk") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
-        std::cout << "Converting pk from " << argv[2] << " to " << argv[3] << " ..." << std::endl;
+        LOG_INFO("Converting pk from " << argv[2] << " to " << argv[3] << " ...");
         if (!pk_bellman2ethsnarks(argv[2], argv[3]))
         {
             return 1;
         }
-        std::cout << "Successfully created pk " << argv[3] << "." << std::endl;
+        LOG_INFO("Successfully created pk " << argv[3] << ".");
         return 0;
     }
     else if (strcmp(argv[1], "-pk_alt2mcl") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
-        std::cout << "Converting pk from " << argv[2] << " to " << argv[3] << " ..." << std::endl;
+        LOG_INFO("Converting pk from " << argv[2] << " to " << argv[3] << " ...");
         if (!pk_alt2mcl(argv[2], argv[3]))
         {
-            std::cout << "Could not convert pk." << std::endl;
+            LOG_ERROR("Could not convert pk.");
             return 1;
         }
-        std::cout << "Successfully created pk " << argv[3] << "." << std::endl;
+        LOG_INFO("Successfully created pk " << argv[3] << ".");
         return 0;
     }
     else if (strcmp(argv[1], "-pk_mcl2nozk") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
-        std::cout << "Converting pk from " << argv[2] << " to " << argv[3] << " ..." << std::endl;
+        LOG_INFO("Converting pk from " << argv[2] << " to " << argv[3] << " ...");
         if (!pk_mcl2nozk(argv[2], argv[3]))
         {
-            std::cout << "Failed to convert!" << std::endl;
+            LOG_ERROR("Failed to convert!");
             return 1;
         }
-        std::cout << "Successfully created pk " << argv[3] << "." << std::endl;
+        LOG_INFO("Successfully created pk " << argv[3] << ".");
         return 0;
     }
     else if (strcmp(argv[1], "-server") == 0)
     {
         if (argc != 4)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
         mode = Mode::Server;
-        std::cout << "Starting proving server for " << argv[2] << " on port " << argv[3] << "..." << std::endl;
+        LOG_INFO("Starting proving server for " << argv[2] << " on port " << argv[3] << "...");
     }
     else if (strcmp(argv[1], "-benchmark") == 0)
     {
         if (argc != 3)
         {
-            std::cout << "Invalid number of arguments!" << std::endl;
+            LOG_ERROR("Invalid number of arguments!");
             return 1;
         }
         mode = Mode::Benchmark;
-        std::cout << "Benchmarking " << argv[2] << "..." << std::endl;
+        LOG_INFO("Benchmarking " << argv[2] << "...");
+    }
+    else if (strcmp(argv[1], "-build") == 0)
+    {
+        if (argc != 3 && argc != 4)
+        {
+            LOG_ERROR("Invalid number of arguments!");
+            return 1;
+        }
+        mode = Mode::Build;
+        LOG_INFO("Building " << argv[2] << "...");
+    }
+    else if (strcmp(argv[1], "-synth") == 0)
+    {
+        if (argc != 3 && argc != 5)
+        {
+            LOG_ERROR("Invalid number of arguments!");
+            return 1;
+        }
+        mode = Mode::Synth;
+        LOG_INFO("Generating a block for " << argv[2] << "...");
     }
     else
     {
-        std::cerr << "Unknown option: " << argv[1] << std::endl;
+        LOG_ERROR("Unknown option: " << argv[1]);
         return 1;
     }
 
@@ -830,14 +1486,31 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // Read meta data
-    int iBlockType = input["blockType"].get<int>();
-    unsigned int blockSize = input["blockSize"].get<int>();
+    // The state of the blocks that are built is kept in the state store
+    Loopring::StateStore stateStore;
+    const bool useStateStore =
+      !stateStoreFilename.empty() && (mode == Mode::Build || mode == Mode::Synth || mode == Mode::Server);
+    if (useStateStore && !stateStore.open(stateStoreFilename))
+    {
+        return 1;
+    }
+    // The state -build and -synth build the block on
+    Loopring::PendingState pendingState((useStateStore && mode != Mode::Server) ? &stateStore : nullptr);
+
+    // Read meta data (the block input only contains the transactions)
+    int iBlockType = input.contains("blockType") ? input["blockType"].get<int>() : 0;
+    unsigned int blockSize =
+      input.contains("blockSize") ? input["blockSize"].get<int>() : input["transactions"].size();
+    unsigned int numSignatureVerifiers = getNumSignatureVerifiers(input);
     std::string postFix = "_" + std::to_string(blockSize);
+    if (numSignatureVerifiers > 0)
+    {
+        postFix += "_sig" + std::to_string(numSignatureVerifiers);
+    }
 
     /*if (iBlockType >= int(Loopring::BlockType::COUNT))
     {
-        std::cerr << "Invalid block type: " << iBlockType << std::endl;
+        LOG_ERROR("Invalid block type: " << iBlockType);
         return 1;
     }*/
     unsigned int blockType = iBlockType;
@@ -848,13 +1521,13 @@ int main(int argc, char **argv)
     {
         if (!fileExists(provingKeyFilename))
         {
-            std::cerr << "Failed to find pk!" << std::endl;
+            LOG_ERROR("Failed to find pk!");
             return 1;
         }
     }
 
     ethsnarks::ProtoboardT pb;
-    Loopring::Circuit *circuit = createCircuit(blockType, blockSize, pb);
+    Loopring::Circuit *circuit = createCircuit(blockType, blockSize, numSignatureVerifiers, pb);
     if (config.swapAB)
     {
         // pb.constraint_system.swap_AB_if_beneficial();
@@ -863,7 +1536,7 @@ int main(int argc, char **argv)
     pb.values.shrink_to_fit();
     libsnark::ConstantStorage<FieldT>::getInstance().constants.shrink_to_fit();
 
-    printMemoryUsage();
+    recordMemoryUsage("createCircuit", pb);
 
 #if 0
     unsigned int totalCoeffs = 0;
@@ -873,8 +1546,8 @@ int main(int argc, char **argv)
         totalCoeffs += pb.constraint_system.constraints[i]->getB().getTerms().size();
         totalCoeffs += pb.constraint_system.constraints[i]->getC().getTerms().size();
     }
-    std::cout << "num coefficients: " << totalCoeffs << std::endl;
-    std::cout << "num unique coefficients: " << libsnark::ConstantStorage<FieldT>::getInstance().constants.size() << std::endl;
+    LOG_INFO("num coefficients: " << totalCoeffs);
+    LOG_INFO("num unique coefficients: " << libsnark::ConstantStorage<FieldT>::getInstance().constants.size());
 #endif
 
     if (mode == Mode::Benchmark)
@@ -883,17 +1556,21 @@ int main(int argc, char **argv)
         {
             return 1;
         }
-        runBenchmark(circuit, provingKeyFilename);
+        recordMemoryUsage("generateWitness", pb);
+        if (!runBenchmark(circuit, provingKeyFilename, input))
+        {
+            return 1;
+        }
     }
 
 #ifdef MULTICORE
     omp_set_num_threads(config.num_threads);
-    std::cout << "Num threads used: " << omp_get_max_threads() << std::endl;
+    LOG_INFO("Num threads used: " << omp_get_max_threads());
 #endif
 
     if (mode == Mode::Server)
     {
-        runServer(circuit, provingKeyFilename, config, std::stoi(argv[3]));
+        runServer(circuit, provingKeyFilename, config, useStateStore ? &stateStore : nullptr, std::stoi(argv[3]));
     }
 
     if (mode == Mode::Validate || mode == Mode::Prove)
@@ -904,19 +1581,47 @@ int main(int argc, char **argv)
         }
     }
 
-    if (mode == Mode::Validate || mode == Mode::Prove)
+    if (mode == Mode::Build)
+    {
+        if (!buildWitness(circuit, input, (argc == 4) ? argv[3] : nullptr, pendingState))
+        {
+            return 1;
+        }
+    }
+
+    if (mode == Mode::Synth)
     {
+        if (!synthWitness(
+              circuit,
+              input,
+              (argc == 5) ? argv[3] : nullptr,
+              (argc == 5) ? argv[4] : nullptr,
+              pendingState))
+        {
+            return 1;
+        }
+    }
+
+    if (mode == Mode::Validate || mode == Mode::Prove || mode == Mode::Build || mode == Mode::Synth)
+    {
+        recordMemoryUsage("generateWitness", pb);
         if (!validateCircuit(circuit))
         {
             return 1;
         }
     }
 
+    // The state after a built block is only stored once the block is valid
+    if ((mode == Mode::Build || mode == Mode::Synth) && !commitState(pendingState))
+    {
+        return 1;
+    }
+
     if (mode == Mode::CreateKeys)
     {
         if (!generateKeyPair(pb, baseFilename))
         {
-            std::cerr << "Failed to generate keys!" << std::endl;
+            LOG_ERROR("Failed to generate keys!");
             return 1;
         }
     }
@@ -924,7 +1629,7 @@ int main(int argc, char **argv)
     if (mode == Mode::Prove)
     {
 #ifdef GPU_PROVE
-        std::cout << "GPU Prove: Generate inputsFile." << std::endl;
+        LOG_INFO("GPU Prove: Generate inputsFile.");
         std::string inputsFilename = baseFilename + "_inputs.raw";
         auto begin = now();
         stub_write_input_from_pb(pb, provingKeyFilename.c_str(), inputsFilename.c_str());
@@ -936,12 +1641,13 @@ int main(int argc, char **argv)
         context.config = config;
         context.domain = get_domain(pb, context.provingKey, config);
         initProverContextBuffers(context);
-        printMemoryUsage();
+        recordMemoryUsage("initProver", pb, &context);
         std::string jProof = proveCircuit(context, circuit);
         if (jProof.length() == 0)
         {
             return 1;
         }
+        recordMemoryUsage("prove", pb, &context);
         if (!writeProof(jProof, proofFilename))
         {
             return 1;
@@ -953,7 +1659,7 @@ int main(int argc, char **argv)
     {
         if (!r1cs2json(pb, argv[3]))
         {
-            std::cerr << "Failed to export circuit!" << std::endl;
+            LOG_ERROR("Failed to export circuit!");
             return 1;
         }
     }
@@ -962,7 +1668,7 @@ int main(int argc, char **argv)
     {
         if (!witness2json(pb, argv[3]))
         {
-            std::cerr << "Failed to export witness!" << std::endl;
+            LOG_ERROR("Failed to export witness!");
             return 1;
         }
     }
@@ -0,0 +1,186 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/BlockBuilder.h"
+
+static json getBlockInput(const json &transactions)
+{
+    json input;
+    input["exchange"] = "0";
+    input["timestamp"] = 1000000;
+    input["protocolTakerFeeBips"] = 25;
+    input["protocolMakerFeeBips"] = 10;
+    input["operatorAccountID"] = 1;
+    input["transactions"] = transactions;
+    return input;
+}
+
+static json getDeposit(
+  unsigned int accountID,
+  const std::string &owner,
+  unsigned int tokenID,
+  const std::string &amount)
+{
+    json deposit;
+    deposit["txType"] = "Deposit";
+    deposit["owner"] = owner;
+    deposit["accountID"] = accountID;
+    deposit["tokenID"] = tokenID;
+    deposit["amount"] = amount;
+    return deposit;
+}
+
+static json getOrder(
+  unsigned int accountID,
+  unsigned int tokenS,
+  unsigned int tokenB,
+  const std::string &amountS,
+  const std::string &amountB)
+{
+    json order;
+    order["storageID"] = "0";
+    order["accountID"] = accountID;
+    order["tokenIdS"] = tokenS;
+    order["tokenIdB"] = tokenB;
+    order["amountS"] = amountS;
+    order["amountB"] = amountB;
+    order["validUntil"] = 0xFFFFFFFF;
+    order["fillAmountBorS"] = false;
+    order["taker"] = "0";
+    order["maxFeeBips"] = 20;
+    order["feeBips"] = 10;
+    order["amm"] = false;
+    order["nftDataB"] = "0";
+    return order;
+}
+
+TEST_CASE("BlockBuilder", "[BlockBuilder]")
+{
+    const FieldT emptyMerkleRoot =
+      FieldT("14018711192124647312737824211448712071328538129221205702934141004517937071768");
+
+    json transactions = json::array();
+    transactions.push_back(getDeposit(2, "1234", 0, "1000000"));
+    transactions.push_back(getDeposit(3, "5678", 1, "1000000"));
+
+    json transfer;
+    transfer["txType"] = "Transfer";
+    transfer["fromAccountID"] = 2;
+    transfer["toAccountID"] = 3;
+    transfer["tokenID"] = 0;
+    transfer["amount"] = "100000";
+    transfer["feeTokenID"] = 0;
+    transfer["fee"] = "1000";
+    transfer["maxFee"] = "1000";
+    transfer["validUntil"] = 0xFFFFFFFF;
+    transfer["type"] = 0;
+    transfer["storageID"] = "1";
+    transfer["from"] = "1234";
+    transfer["to"] = "5678";
+    transfer["dualAuthorX"] = "0";
+    transfer["dualAuthorY"] = "0";
+    transfer["payerToAccountID"] = 3;
+    transfer["payerTo"] = "5678";
+    transfer["payeeToAccountID"] = 3;
+    transfer["putAddressesInDA"] = false;
+    transfer["toTokenID"] = 0;
+    transactions.push_back(transfer);
+
+    json spotTrade;
+    spotTrade["txType"] = "SpotTrade";
+    spotTrade["orderA"] = getOrder(2, 0, 1, "200000", "100000");
+    spotTrade["orderB"] = getOrder(3, 1, 0, "100000", "200000");
+    transactions.push_back(spotTrade);
+
+    json withdrawal;
+    withdrawal["txType"] = "Withdraw";
+    withdrawal["owner"] = "5678";
+    withdrawal["accountID"] = 3;
+    withdrawal["tokenID"] = 1;
+    withdrawal["amount"] = "50000";
+    withdrawal["feeTokenID"] = 1;
+    withdrawal["fee"] = "0";
+    withdrawal["maxFee"] = "0";
+    withdrawal["storageID"] = "5";
+    withdrawal["onchainDataHash"] = "0";
+    withdrawal["validUntil"] = 0xFFFFFFFF;
+    withdrawal["type"] = 1;
+    transactions.push_back(withdrawal);
+
+    json noop;
+    noop["txType"] = "Noop";
+    transactions.push_back(noop);
+
+    ExchangeState state;
+    Block block;
+    REQUIRE(buildBlock(state, getBlockInput(transactions), block));
+
+    SECTION("Valid block")
+    {
+        REQUIRE(block.transactions.size() == transactions.size());
+        REQUIRE(block.merkleRootBefore == emptyMerkleRoot);
+        REQUIRE(block.merkleRootAfter == state.getRoot());
+        REQUIRE(block.transactions.back().witness.numConditionalTransactionsAfter == FieldT(3));
+        REQUIRE(checkMerkleProofs(block));
+        REQUIRE(validateBlock(block));
+
+        // The spot trade is filled completely, the fee is paid in tokenB
+        REQUIRE(state.findBalance(state.getAccount(2), 0).balance == FieldT(1000000 - 100000 - 1000 - 200000));
+        REQUIRE(state.findBalance(state.getAccount(2), 1).balance == FieldT(100000 - 100));
+        // The protocol fees
+        REQUIRE(state.findBalance(state.getAccount(0), 1).balance == FieldT(100000 * 25 / 100000));
+        REQUIRE(state.findBalance(state.getAccount(0), 0).balance == FieldT(200000 * 10 / 100000));
+    }
+
+    SECTION("Next block")
+    {
+        json nextTransactions = json::array();
+        nextTransactions.push_back(getDeposit(2, "1234", 1, "1000"));
+        Block nextBlock;
+        REQUIRE(buildBlock(state, getBlockInput(nextTransactions), nextBlock));
+        REQUIRE(nextBlock.merkleRootBefore == block.merkleRootAfter);
+        REQUIRE(checkMerkleProofs(nextBlock));
+    }
+
+    SECTION("Load state")
+    {
+        // The state after a single deposit in the format of operator/state.py
+        ExchangeState depositState;
+        Block depositBlock;
+        json depositTransactions = json::array();
+        depositTransactions.push_back(getDeposit(2, "1234", 0, "1000000"));
+        REQUIRE(buildBlock(depositState, getBlockInput(depositTransactions), depositBlock));
+
+        const json jState = R"({
+            "exchangeID": 0,
+            "accounts_values": {
+                "1": {
+                    "owner": "0", "publicKeyX": "0", "publicKeyY": "0", "nonce": 1, "feeBipsAMM": 0,
+                    "_balancesLeafs": {}
+                },
+                "2": {
+                    "owner": "1234", "publicKeyX": "0", "publicKeyY": "0", "nonce": 0, "feeBipsAMM": 0,
+                    "_balancesLeafs": {
+                        "0": {
+                            "balance": "1000000", "weightAMM": "0",
+                            "_storageLeafs": {"0": {"data": "0", "storageID": "0"}}
+                        }
+                    }
+                }
+            }
+        })"_json;
+        ExchangeState loadedState;
+        loadedState.load(jState);
+        REQUIRE(loadedState.getRoot() == depositState.getRoot());
+    }
+
+    SECTION("Unknown transaction type")
+    {
+        json invalidTransactions = json::array();
+        json invalid;
+        invalid["txType"] = "Invalid";
+        invalidTransactions.push_back(invalid);
+        Block invalidBlock;
+        REQUIRE_FALSE(buildBlock(state, getBlockInput(invalidTransactions), invalidBlock));
+    }
+}
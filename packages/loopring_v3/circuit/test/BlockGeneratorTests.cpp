@@ -0,0 +1,118 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/BlockBuilder.h"
+#include "../Utils/BlockGenerator.h"
+#include "../Circuits/UniversalCircuit.h"
+
+TEST_CASE("BlockGenerator", "[BlockGenerator]")
+{
+    jubjub::Params params;
+
+    BlockGeneratorConfig config;
+    config.blockSize = 32;
+    config.seed = 7;
+    config.numAccounts = 8;
+    config.numTokens = 3;
+    config.transactions = {
+      {"Noop", 1},
+      {"Deposit", 1},
+      {"Withdraw", 1},
+      {"Transfer", 2},
+      {"SpotTrade", 4},
+      {"SpotTradeAMM", 2},
+      {"AccountUpdate", 1},
+      {"AmmUpdate", 1},
+      {"SignatureVerification", 1},
+      {"NftMint", 2},
+      {"NftData", 1}};
+
+    SECTION("Signatures")
+    {
+        std::mt19937_64 rng(1);
+        const EdDSAKeyPair keyPair = createKeyPair(rng, params);
+        REQUIRE(isOnCurve(keyPair.publicKey, params));
+
+        SignatureCheck check;
+        check.publicKey = keyPair.publicKey;
+        check.message = getRandomFieldElement(NUM_BITS_FIELD_CAPACITY);
+        check.signature = signMessage(keyPair, check.message, rng, params);
+        check.required = true;
+        REQUIRE(verifySignature(check, hashSignature(check), params));
+        REQUIRE(checkSignatures({check}, params));
+
+        check.message += FieldT::one();
+        REQUIRE_FALSE(verifySignature(check, hashSignature(check), params));
+    }
+
+    SECTION("Valid blocks")
+    {
+        BlockGenerator generator(config);
+        ExchangeState state;
+        generator.setupState(state);
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            json input;
+            REQUIRE(generator.generateBlock(input));
+            Block block;
+            REQUIRE(buildBlock(state, input, block));
+            REQUIRE(block.transactions.size() == config.blockSize);
+            REQUIRE(checkMerkleProofs(block));
+            REQUIRE(validateBlock(block));
+        }
+    }
+
+    SECTION("Circuit")
+    {
+        BlockGenerator generator(config);
+        ExchangeState state;
+        generator.setupState(state);
+        json input;
+        REQUIRE(generator.generateBlock(input));
+        Block block;
+        REQUIRE(buildBlock(state, input, block));
+
+        protoboard<FieldT> pb;
+        UniversalCircuit circuit(pb, "circuit");
+        circuit.generateConstraints(config.blockSize);
+        circuit.setBlockSigner(generator.getBlockSigner());
+        REQUIRE(circuit.generateWitness(block));
+        REQUIRE(pb.is_satisfied());
+    }
+
+    SECTION("Same seed")
+    {
+        BlockGenerator generatorA(config);
+        BlockGenerator generatorB(config);
+        ExchangeState stateA;
+        ExchangeState stateB;
+        generatorA.setupState(stateA);
+        generatorB.setupState(stateB);
+        REQUIRE(stateA.getRoot() == stateB.getRoot());
+        json inputA;
+        json inputB;
+        REQUIRE(generatorA.generateBlock(inputA));
+        REQUIRE(generatorB.generateBlock(inputB));
+        REQUIRE(inputA == inputB);
+    }
+
+    SECTION("Saved state")
+    {
+        BlockGenerator generator(config);
+        ExchangeState state;
+        generator.setupState(state);
+        ExchangeState loadedState;
+        loadedState.load(state.save());
+        REQUIRE(loadedState.getRoot() == state.getRoot());
+    }
+
+    SECTION("Unknown transaction type")
+    {
+        config.transactions = {{"Invalid", 1}};
+        BlockGenerator generator(config);
+        ExchangeState state;
+        generator.setupState(state);
+        json input;
+        REQUIRE_FALSE(generator.generateBlock(input));
+    }
+}
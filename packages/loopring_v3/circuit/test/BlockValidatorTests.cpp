@@ -0,0 +1,172 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/BlockValidator.h"
+#include "../Gadgets/MatchingGadgets.h"
+
+TEST_CASE("BlockValidator fill rate", "[BlockValidator]")
+{
+    auto checkFillRateNative = [](
+                                 const BigInt &_amountS,
+                                 const BigInt &_amountB,
+                                 const BigInt &_fillAmountS,
+                                 const BigInt &_fillAmountB) {
+        protoboard<FieldT> pb;
+
+        VariableT amountS = make_variable(pb, toFieldElement(_amountS), "amountS");
+        VariableT amountB = make_variable(pb, toFieldElement(_amountB), "amountB");
+        VariableT fillAmountS = make_variable(pb, toFieldElement(_fillAmountS), "fillAmountS");
+        VariableT fillAmountB = make_variable(pb, toFieldElement(_fillAmountB), "fillAmountB");
+
+        Constants constants(pb, "constants");
+        RequireFillRateGadget requireFillRateGadget(
+          pb, constants, amountS, amountB, fillAmountS, fillAmountB, NUM_BITS_AMOUNT, "requireFillRateGadget");
+        requireFillRateGadget.generate_r1cs_constraints();
+        requireFillRateGadget.generate_r1cs_witness();
+
+        REQUIRE(checkFillRate(_amountS, _amountB, _fillAmountS, _fillAmountB) == pb.is_satisfied());
+    };
+
+    BigInt max = getMaxFieldElementAsBigInt(NUM_BITS_AMOUNT);
+
+    SECTION("Edge cases")
+    {
+        checkFillRateNative(1, 1, 1, 1);
+        checkFillRateNative(1, 1, 0, 0);
+        checkFillRateNative(1, 1, 1, 0);
+        checkFillRateNative(1, 1, 0, 1);
+        checkFillRateNative(max, max, max, max);
+        checkFillRateNative(max, 1, max, 1);
+        checkFillRateNative(20000, 2000, 10000, 1000);
+        checkFillRateNative(20000, 2000, 10000, 999);
+    }
+
+    SECTION("Random")
+    {
+        for (unsigned int i = 0; i < 128; i++)
+        {
+            BigInt amountS = getRandomFieldElementAsBigInt(NUM_BITS_AMOUNT);
+            BigInt amountB = getRandomFieldElementAsBigInt(NUM_BITS_AMOUNT);
+            BigInt fillAmountS = amountS / ((rand() % 16) + 1);
+            BigInt fillAmountB = (amountB * ((rand() % 2048) + 1)) / 2048;
+            checkFillRateNative(amountS, amountB, fillAmountS, fillAmountB);
+        }
+    }
+}
+
+TEST_CASE("BlockValidator AMM fills", "[BlockValidator]")
+{
+    auto checkAMMFillsNative = [](
+                                 const BigInt &_balanceIn,
+                                 const BigInt &_balanceOut,
+                                 unsigned int _feeBips,
+                                 const BigInt &__amountIn,
+                                 const BigInt &__amountOut) {
+        BigInt _amountIn = __amountIn;
+        BigInt _amountOut = __amountOut;
+        if (_balanceIn + _amountIn > getMaxFieldElementAsBigInt(NUM_BITS_AMOUNT))
+        {
+            _amountIn = getMaxFieldElementAsBigInt(NUM_BITS_AMOUNT) - _balanceIn;
+        }
+        if (_balanceOut - _amountOut < 0)
+        {
+            _amountOut = _balanceOut;
+        }
+
+        protoboard<FieldT> pb;
+        VariableT amm = make_variable(pb, 1, "amm");
+        VariableT orderFeeBips = make_variable(pb, 0, "orderFeeBips");
+        VariableT balanceInBefore = make_variable(pb, toFieldElement(_balanceIn), "balanceInBefore");
+        VariableT balanceOutBefore = make_variable(pb, toFieldElement(_balanceOut), "balanceOutBefore");
+        VariableT feeBips = make_variable(pb, FieldT(_feeBips), "feeBips");
+        VariableT amountIn = make_variable(pb, toFieldElement(_amountIn), "amountIn");
+        VariableT amountOut = make_variable(pb, toFieldElement(_amountOut), "amountOut");
+        VariableT balanceInAfter = make_variable(pb, toFieldElement(_balanceIn + _amountIn), "balanceInAfter");
+        VariableT balanceOutAfter = make_variable(pb, toFieldElement(_balanceOut - _amountOut), "balanceOutAfter");
+
+        Constants constants(pb, "constants");
+        RequireAMMFillsGadget requireAMMFills(
+          pb,
+          constants,
+          amm,
+          {amm,
+           orderFeeBips,
+           amountOut,
+           balanceOutBefore,
+           balanceInBefore,
+           balanceOutAfter,
+           balanceInAfter,
+           feeBips},
+          amountIn,
+          "requireAMMFills");
+        requireAMMFills.generate_r1cs_constraints();
+        requireAMMFills.generate_r1cs_witness();
+
+        std::string error;
+        bool valid = checkAMMFills(0, _amountOut, _amountIn, _balanceOut, _balanceIn, _feeBips, error);
+        REQUIRE(valid == pb.is_satisfied());
+    };
+
+    BigInt BASE(FIXED_BASE);
+    BigInt max = getMaxFieldElementAsBigInt(NUM_BITS_AMOUNT);
+
+    SECTION("Edge cases")
+    {
+        checkAMMFillsNative(1000, 1000, 10, 1, 1);
+        checkAMMFillsNative(1000, 1000, 10, 2, 1);
+        checkAMMFillsNative(1000, 1000, 10, 0, 1);
+        checkAMMFillsNative(1, 1, 10, 0, 0);
+        checkAMMFillsNative(1000, 0, 10, 0, 0);
+        checkAMMFillsNative(0, 1000, 10, 0, 0);
+        checkAMMFillsNative(max, max, 10, 0, 0);
+    }
+
+    SECTION("Fill limit")
+    {
+        BigInt balance = BASE * 1000;
+        BigInt amountIn = BASE * 1;
+        for (unsigned int p = 90; p < 110; p++)
+        {
+            checkAMMFillsNative(balance, balance, 30, amountIn, (amountIn * p) / 100);
+        }
+    }
+
+    SECTION("Random")
+    {
+        for (unsigned int i = 0; i < 128; i++)
+        {
+            BigInt balanceIn = getRandomFieldElementAsBigInt(NUM_BITS_AMOUNT);
+            BigInt balanceOut = getRandomFieldElementAsBigInt(NUM_BITS_AMOUNT);
+            unsigned int feeBips = rand() % 256;
+            BigInt amountIn = getRandomFieldElementAsBigInt(NUM_BITS_AMOUNT);
+            BigInt amountOut = getRandomFieldElementAsBigInt(NUM_BITS_AMOUNT);
+            checkAMMFillsNative(balanceIn, balanceOut, feeBips, amountIn, amountOut);
+        }
+    }
+}
+
+TEST_CASE("BlockValidator float accuracy", "[BlockValidator]")
+{
+    SECTION("Exact values")
+    {
+        REQUIRE(checkFloatAccuracy(0, Float16Encoding, Float16Accuracy));
+        REQUIRE(checkFloatAccuracy(2047, Float16Encoding, Float16Accuracy));
+        REQUIRE(checkFloatAccuracy(BigInt(2047) * 1000, Float16Encoding, Float16Accuracy));
+        REQUIRE(checkFloatAccuracy(524287, Float24Encoding, Float24Accuracy));
+    }
+
+    SECTION("Rounding")
+    {
+        // The accuracy is chosen so that any amount that fits in NUM_BITS_AMOUNT
+        // bits can be represented
+        REQUIRE(checkFloatAccuracy(20499, Float16Encoding, Float16Accuracy));
+        REQUIRE(checkFloatAccuracy(5242879, Float24Encoding, Float24Accuracy));
+        REQUIRE(checkFloatAccuracy(getMaxFieldElementAsBigInt(NUM_BITS_AMOUNT), Float16Encoding, Float16Accuracy));
+        REQUIRE(checkFloatAccuracy(getMaxFieldElementAsBigInt(NUM_BITS_AMOUNT), Float24Encoding, Float24Accuracy));
+    }
+
+    SECTION("Out of range")
+    {
+        REQUIRE(!checkFloatAccuracy(getMaxFieldElementAsBigInt(NUM_BITS_AMOUNT) + 1, Float16Encoding, Float16Accuracy));
+    }
+}
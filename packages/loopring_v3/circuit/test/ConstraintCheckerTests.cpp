@@ -0,0 +1,52 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/ConstraintChecker.h"
+#include "../Gadgets/MathGadgets.h"
+
+TEST_CASE("ConstraintChecker", "[checkConstraints]")
+{
+    protoboard<FieldT> pb;
+
+    Constants constants(pb, "constants");
+    std::vector<AddGadget> adders;
+    adders.reserve(64);
+    VariableT sum = make_variable(pb, 1, ".initial");
+    for (unsigned int i = 0; i < 64; i++)
+    {
+        adders.emplace_back(pb, sum, constants._1, NUM_BITS_AMOUNT, FMT("adder", "[%u]", i));
+        sum = adders.back().result();
+    }
+    constants.generate_r1cs_constraints();
+    for (auto &adder : adders)
+    {
+        adder.generate_r1cs_constraints();
+    }
+    constants.generate_r1cs_witness();
+    for (auto &adder : adders)
+    {
+        adder.generate_r1cs_witness();
+    }
+
+    SECTION("Satisfied")
+    {
+        REQUIRE(pb.is_satisfied());
+        REQUIRE(checkConstraints(pb, nullptr, 7));
+    }
+
+    SECTION("First failing constraint is reported")
+    {
+        pb.val(adders[40].result()) += FieldT::one();
+        pb.val(adders[20].result()) += FieldT::one();
+        REQUIRE(!pb.is_satisfied());
+
+        ConstraintFailure failure;
+        REQUIRE(!checkConstraints(pb, &failure, 7));
+        REQUIRE(failure.a * failure.b != failure.c);
+
+        // Must be the same constraint as found when checking in a single chunk
+        ConstraintFailure serialFailure;
+        REQUIRE(!checkConstraints(pb, &serialFailure, pb.num_constraints()));
+        REQUIRE(failure.index == serialFailure.index);
+    }
+}
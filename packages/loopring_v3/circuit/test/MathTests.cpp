@@ -408,6 +408,43 @@ TEST_CASE("RequireNotZero", "[RequireNotZeroGadget]")
             REQUIRE(pb.is_satisfied());
         }
     }
+
+    SECTION("Deferred inversions")
+    {
+        std::vector<pb_variable<FieldT>> values;
+        std::vector<RequireNotZeroGadget> gadgets;
+        gadgets.reserve(numIterations);
+        for (unsigned int i = 0; i < numIterations; i++)
+        {
+            values.push_back(make_variable(pb, FMT("values", "[%u]", i)));
+            gadgets.emplace_back(pb, values.back(), FMT("gadgets", "[%u]", i));
+            gadgets.back().generate_r1cs_constraints();
+        }
+        pb.val(a) = 1;
+
+        {
+            DeferredInversions inversions(pb);
+            for (unsigned int i = 0; i < numIterations; i++)
+            {
+                pb.val(values[i]) = getRandomFieldElement();
+                gadgets[i].generate_r1cs_witness();
+            }
+            requireNotZeroGadget.generate_r1cs_witness();
+        }
+        REQUIRE(pb.is_satisfied());
+
+        {
+            DeferredInversions inversions(pb);
+            pb.val(values[numIterations / 2]) = 0;
+            for (unsigned int i = 0; i < numIterations; i++)
+            {
+                gadgets[i].generate_r1cs_witness();
+            }
+        }
+        REQUIRE(!pb.is_satisfied());
+        REQUIRE(pb.val(gadgets[numIterations / 2].A_inv) == FieldT::zero());
+        REQUIRE(pb.val(values[0]) * pb.val(gadgets[0].A_inv) == FieldT::one());
+    }
 }
 
 TEST_CASE("IsNonZero", "[IsNonZero]")
@@ -1831,3 +1868,39 @@ TEST_CASE("TokenTradeData", "[TokenTradeDataGadget]")
         tokenTradeDataChecked(NFT_TOKEN_ID_START+12, 123, NFT_TOKEN_ID_START+1233, 124, 0, 1, 123, false);
     }
 }
+
+TEST_CASE("PublicData", "[PublicDataGadget]")
+{
+    SECTION("Native SHA-256")
+    {
+        const std::vector<uint8_t> data = {'a', 'b', 'c'};
+        const SHA256Digest expected = {0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40,
+                                       0xde, 0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17,
+                                       0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad};
+        REQUIRE(sha256(data) == expected);
+    }
+
+    SECTION("Native public input matches the hasher")
+    {
+        // Multiple blocks, with the length not a multiple of the block size
+        for (unsigned int numBytes : {0, 1, 55, 56, 64, 300})
+        {
+            protoboard<FieldT> pb;
+            PublicDataGadget publicData(pb, "publicData");
+            VariableArrayT bits = make_var_array(pb, numBytes * 8, "bits");
+            for (unsigned int i = 0; i < bits.size(); i++)
+            {
+                pb.val(bits[i]) = rand() % 2;
+            }
+            publicData.add(bits);
+            publicData.generate_r1cs_constraints();
+
+            publicData.generate_r1cs_witness_publicInput();
+            const FieldT publicInput = pb.val(publicData.publicInput);
+            publicData.generate_r1cs_witness_hash();
+
+            REQUIRE(pb.is_satisfied());
+            REQUIRE(publicInput == pb.val(publicData.calculatedHash->packed));
+        }
+    }
+}
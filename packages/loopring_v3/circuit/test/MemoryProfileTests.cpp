@@ -0,0 +1,50 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/MemoryProfile.h"
+
+TEST_CASE("MemoryProfile", "[MemoryProfile]")
+{
+    SECTION("Container bytes")
+    {
+        REQUIRE(getContainerBytes(std::vector<uint64_t>(1000)) == 8000);
+        REQUIRE(getContainerBytes(std::vector<FieldT>(10)) == 10 * sizeof(FieldT));
+        REQUIRE(getContainerBytes(std::vector<uint8_t>()) == 0);
+    }
+
+    SECTION("Memory usage")
+    {
+        const MemoryUsage usage = getMemoryUsage();
+        REQUIRE(usage.rss_mb > 0.0);
+        REQUIRE(usage.vm_mb >= usage.rss_mb);
+        REQUIRE(usage.peak_rss_mb >= usage.rss_mb);
+    }
+
+    SECTION("Stages")
+    {
+        MemoryProfile::start("");
+        std::vector<uint64_t> values(1 << 20, 1);
+        MemoryProfile::record("allocate", {{"values", getContainerBytes(values)}});
+        MemoryProfile::stop();
+        MemoryProfile::record("ignored", {});
+
+        const json profile = MemoryProfile::toJSON();
+        REQUIRE(profile["stages"].size() == 1);
+        const json &stage = profile["stages"][0];
+        REQUIRE(stage["stage"] == "allocate");
+        REQUIRE(stage["bytes"]["values"].get<size_t>() == 8 * (1 << 20));
+        REQUIRE(stage["rss_mb"].get<double>() >= 8.0);
+    }
+
+    SECTION("Clear after writing")
+    {
+        MemoryProfile::start("");
+        {
+            MemoryProfileWriter memoryProfileWriter(true);
+            MemoryProfile::record("request", {});
+            REQUIRE(MemoryProfile::toJSON()["stages"].size() == 1);
+        }
+        REQUIRE(MemoryProfile::toJSON()["stages"].empty());
+        MemoryProfile::stop();
+    }
+}
@@ -0,0 +1,72 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/MerkleChecker.h"
+
+TEST_CASE("PoseidonNative", "[PoseidonNative]")
+{
+    protoboard<FieldT> pb;
+
+    std::array<FieldT, 4> values;
+    VariableArrayT inputs;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        values[i] = toFieldElement(getRandomFieldElementAsBigInt(254));
+        inputs.emplace_back(make_variable(pb, values[i], FMT("input", "[%u]", i)));
+    }
+
+    HashMerkleTree hash(pb, inputs, "hash");
+    hash.generate_r1cs_constraints();
+    hash.generate_r1cs_witness();
+
+    REQUIRE(pb.is_satisfied());
+    REQUIRE(PoseidonNative<HashMerkleTree>::hash(values) == pb.val(hash.result()));
+}
+
+TEST_CASE("MerkleChecker", "[checkMerkleProofs]")
+{
+    Block block = getBlock();
+
+    SECTION("Valid block")
+    {
+        MerkleFailure failure;
+        REQUIRE(checkMerkleProofs(block, &failure));
+    }
+
+    SECTION("Account update")
+    {
+        const UniversalTransaction tx = getSpotTrade(block);
+        const AccountUpdate &accountUpdate = tx.witness.accountUpdate_B;
+        std::string error;
+        REQUIRE(checkAccountUpdate(accountUpdate, error));
+
+        AccountUpdate modified = accountUpdate;
+        modified.after.nonce += FieldT::one();
+        REQUIRE(!checkAccountUpdate(modified, error));
+
+        modified = accountUpdate;
+        modified.proof.data[5] += FieldT::one();
+        REQUIRE(!checkAccountUpdate(modified, error));
+    }
+
+    SECTION("Invalid proof is reported for the correct transaction and tree")
+    {
+        // The spot trade is transaction 2 in the test block
+        block.transactions[2].witness.balanceUpdateS_B.after.balance += FieldT::one();
+
+        MerkleFailure failure;
+        REQUIRE(!checkMerkleProofs(block, &failure));
+        REQUIRE(failure.txIndex == 2);
+        REQUIRE(failure.tree == "balanceS_B");
+    }
+
+    SECTION("Roots need to chain")
+    {
+        block.merkleRootBefore += FieldT::one();
+
+        MerkleFailure failure;
+        REQUIRE(!checkMerkleProofs(block, &failure));
+        REQUIRE(failure.txIndex == 0);
+        REQUIRE(failure.tree == "account_A");
+    }
+}
@@ -94,6 +94,30 @@ TEST_CASE("UpdateAccount", "[UpdateAccountGadget]")
         modifiedAccountUpdate.proof.data[randomIndex] += 1;
         updateAccountChecked(modifiedAccountUpdate, false);
     }
+
+    SECTION("Memoized path hashes")
+    {
+        protoboard<FieldT> pb;
+
+        pb_variable<FieldT> rootBefore = make_variable(pb, accountUpdate.rootBefore, "rootBefore");
+        VariableArrayT address = make_var_array(pb, NUM_BITS_ACCOUNT, ".address");
+        AccountState stateBefore = createAccountState(pb, accountUpdate.before);
+        AccountState stateAfter = createAccountState(pb, accountUpdate.after);
+        address.fill_with_bits_of_field_element(pb, accountUpdate.accountID);
+
+        // The same update twice, the second one only copies the path hashes
+        UpdateAccountGadget updateA(pb, rootBefore, address, stateBefore, stateAfter, "updateA");
+        UpdateAccountGadget updateB(pb, rootBefore, address, stateBefore, stateAfter, "updateB");
+        updateA.generate_r1cs_constraints();
+        updateB.generate_r1cs_constraints();
+
+        MerkleHashMemo memo;
+        updateA.generate_r1cs_witness(accountUpdate, &memo);
+        updateB.generate_r1cs_witness(accountUpdate, &memo);
+
+        REQUIRE(pb.is_satisfied());
+        REQUIRE(pb.val(updateB.result()) == accountUpdate.rootAfter);
+    }
 }
 
 TEST_CASE("UpdateBalance", "[UpdateBalanceGadget]")
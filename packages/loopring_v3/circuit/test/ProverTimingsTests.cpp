@@ -0,0 +1,35 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/ProverTimings.h"
+
+TEST_CASE("ProverPhase", "[ProverTimings]")
+{
+    REQUIRE(getProverPhase("Compute the polynomial H") == std::string(PROVER_PHASE_FFT));
+    REQUIRE(getProverPhase("Compute evaluation to A-query") == std::string(PROVER_PHASE_MSM_A));
+    REQUIRE(getProverPhase("Compute evaluation to B-query") == std::string(PROVER_PHASE_MSM_B_G2));
+    REQUIRE(getProverPhase("Compute evaluation to B1-query") == std::string(PROVER_PHASE_MSM_B_G1));
+    REQUIRE(getProverPhase("Compute evaluation to H-query") == std::string(PROVER_PHASE_MSM_H));
+    REQUIRE(getProverPhase("Compute evaluation to L-query") == std::string(PROVER_PHASE_MSM_L));
+    REQUIRE(getProverPhase("Call to r1cs_gg_ppzksnark_prover") == nullptr);
+}
+
+TEST_CASE("ProverTimer", "[ProverTimings]")
+{
+    ProverTimings timings;
+    ProverTimer timer;
+    timer.start();
+    libff::enter_block("Compute evaluation to A-query", false);
+    libff::leave_block("Compute evaluation to A-query", false);
+    libff::enter_block("Compute evaluation to H-query", false);
+    libff::leave_block("Compute evaluation to H-query", false);
+    timer.stop(timings);
+
+    REQUIRE(timings.total_ms >= 0.0);
+    REQUIRE(timings.num_threads >= 1);
+    REQUIRE(timings.blocks.size() <= 2);
+    for (const auto &phase : timings.phases)
+    {
+        REQUIRE((phase.first == PROVER_PHASE_MSM_A || phase.first == PROVER_PHASE_MSM_H));
+    }
+}
@@ -3,6 +3,7 @@
 
 #include "../Gadgets/MathGadgets.h"
 #include "../Gadgets/SignatureGadgets.h"
+#include "../Utils/SignatureChecker.h"
 
 TEST_CASE("SignatureVerifier", "[SignatureVerifier]")
 {
@@ -132,6 +133,87 @@ TEST_CASE("SignatureVerifier", "[SignatureVerifier]")
         signatureVerifierChecked(
           pubKeyX, pubKeyY, msg, Loopring::Signature(EdwardsPoint(pubKeyX, pubKeyY), 0), false, true);
     }
+
+    SECTION("Memoized B*s")
+    {
+        protoboard<FieldT> pb;
+
+        Constants constants(pb, "constants");
+        jubjub::Params params;
+        jubjub::VariablePointT publicKey(pb, "publicKey");
+        pb.val(publicKey.x) = pubKeyX;
+        pb.val(publicKey.y) = pubKeyY;
+        pb_variable<FieldT> message = make_variable(pb, msg, "message");
+        pb_variable<FieldT> requireValid = make_variable(pb, 1, "requireValid");
+
+        // The second verifier only copies B*s
+        SignatureVerifier verifierA(pb, params, constants, publicKey, message, requireValid, "verifierA");
+        SignatureVerifier verifierB(pb, params, constants, publicKey, message, requireValid, "verifierB");
+        verifierA.generate_r1cs_constraints();
+        verifierB.generate_r1cs_constraints();
+
+        FixedBaseMulMemo memo;
+        verifierA.generate_r1cs_witness(Loopring::Signature(EdwardsPoint(Rx, Ry), s), &memo);
+        verifierB.generate_r1cs_witness(Loopring::Signature(EdwardsPoint(Rx, Ry), s), &memo);
+
+        REQUIRE(pb.is_satisfied());
+        REQUIRE(pb.val(verifierB.result()) == FieldT::one());
+    }
+}
+
+TEST_CASE("FixedBaseMulGadget", "[FixedBaseMulGadget]")
+{
+    jubjub::Params params;
+    const EdwardsPoint base(params.Gx, params.Gy);
+
+    auto fixedBaseMulChecked = [&](const libff::bit_vector &bits) {
+        protoboard<FieldT> pb;
+        VariableArrayT scalar = make_var_array(pb, bits.size(), "scalar");
+        FixedBaseMulGadget fixedBaseMul(pb, params, base, scalar, "fixedBaseMul");
+        fixedBaseMul.generate_r1cs_constraints();
+        scalar.fill_with_bits(pb, bits);
+        fixedBaseMul.generate_r1cs_witness();
+
+        const EdwardsPoint expected = scalarMul(ExtendedPoint(base), bits, params).toAffine();
+
+        REQUIRE(pb.is_satisfied());
+        REQUIRE((pb.val(fixedBaseMul.result_x()) == expected.x));
+        REQUIRE((pb.val(fixedBaseMul.result_y()) == expected.y));
+    };
+
+    const unsigned int numBits = FieldT::size_in_bits();
+
+    SECTION("Zero")
+    {
+        fixedBaseMulChecked(toBits(FieldT::zero(), numBits));
+    }
+
+    SECTION("One")
+    {
+        fixedBaseMulChecked(toBits(FieldT::one(), numBits));
+    }
+
+    SECTION("Random")
+    {
+        for (unsigned int i = 0; i < 8; i++)
+        {
+            fixedBaseMulChecked(toBits(getRandomFieldElement(numBits), numBits));
+        }
+    }
+
+    SECTION("All bits set")
+    {
+        fixedBaseMulChecked(libff::bit_vector(numBits, true));
+    }
+
+    SECTION("Shared window tables")
+    {
+        protoboard<FieldT> pb;
+        VariableArrayT scalar = make_var_array(pb, numBits, "scalar");
+        FixedBaseMulGadget fixedBaseMulA(pb, params, base, scalar, "fixedBaseMulA");
+        FixedBaseMulGadget fixedBaseMulB(pb, params, base, scalar, "fixedBaseMulB");
+        REQUIRE(fixedBaseMulA.windows == fixedBaseMulB.windows);
+    }
 }
 
 TEST_CASE("CompressPublicKey", "[CompressPublicKey]")
@@ -179,4 +261,234 @@ TEST_CASE("CompressPublicKey", "[CompressPublicKey]")
         compressPublicKeyChecked(pubKeyX_1, pubKeyY_2, false);
         compressPublicKeyChecked(pubKeyX_2, pubKeyY_1, false);
     }
+
+    SECTION("Prefetched keys")
+    {
+        jubjub::Params params;
+        std::vector<FieldT> ys = {pubKeyY_1, FieldT::zero(), FieldT::random_element(), pubKeyY_2, pubKeyY_1};
+        PublicKeyDecompressionCache::getInstance().prefetch(params, ys);
+        for (const FieldT &y : ys)
+        {
+            const PublicKeyDecompression decompression = PublicKeyDecompressionCache::getInstance().get(params, y);
+            const FieldT irhs = (params.d * y.squared() - params.a).inverse();
+            REQUIRE(decompression.irhs == irhs);
+            REQUIRE(decompression.rootX == ((y.squared() - FieldT::one()) * irhs).sqrt());
+        }
+
+        compressPublicKeyChecked(pubKeyX_1, pubKeyY_1, true);
+        compressPublicKeyChecked(pubKeyX_2, pubKeyY_2, true);
+        compressPublicKeyChecked(pubKeyX_1, pubKeyY_2, false);
+    }
+}
+
+TEST_CASE("SignatureChecker", "[checkSignatures]")
+{
+    jubjub::Params params;
+
+    FieldT pubKeyX = FieldT("2160707495314124361842542725069553746463608881737352"
+                            "8162920186615872448542319");
+    FieldT pubKeyY = FieldT("3328786100751313619819855397819808730287075038642729"
+                            "822829479432223775713775");
+    FieldT msg = FieldT("18996832849579325290301086811580112302791300834635590497"
+                        "072390271656077158490");
+    FieldT Rx = FieldT("204018103970062372933877863820949243494898542050868530366"
+                       "38326738826249727385");
+    FieldT Ry = FieldT("333917834328931139442748086857847909176691960114200991192"
+                       "2211138735585687725");
+    FieldT s = FieldT("2195931900156604636542164798652536526533339522512506769964"
+                      "82368461290160677");
+
+    const SignatureCheck valid = {
+      EdwardsPoint(pubKeyX, pubKeyY), msg, Loopring::Signature(EdwardsPoint(Rx, Ry), s), true};
+    std::vector<SignatureCheck> checks(33, valid);
+
+    SECTION("Single signature")
+    {
+        REQUIRE(verifySignature(valid, hashSignature(valid), params));
+        SignatureCheck invalid = valid;
+        invalid.message += 1;
+        REQUIRE(!verifySignature(invalid, hashSignature(invalid), params));
+    }
+
+    SECTION("All valid")
+    {
+        REQUIRE(checkSignatures(checks, params));
+    }
+
+    SECTION("Invalid signature is found")
+    {
+        checks[17].signature.s += 1;
+        checks[29].message += 1;
+        size_t invalidIndex;
+        REQUIRE(!checkSignatures(checks, params, &invalidIndex));
+        REQUIRE(invalidIndex == 17);
+    }
+
+    SECTION("Invalid signature that is not required")
+    {
+        checks[5].signature.s += 1;
+        checks[5].required = false;
+        REQUIRE(checkSignatures(checks, params));
+    }
+
+    SECTION("R not on the curve")
+    {
+        checks[9].signature.R.x += 1;
+        checks[9].required = false;
+        size_t invalidIndex;
+        REQUIRE(!checkSignatures(checks, params, &invalidIndex));
+        REQUIRE(invalidIndex == 9);
+    }
+}
+
+TEST_CASE("SharedSignatureVerifiers", "[SharedSignatureVerifiers]")
+{
+    FieldT pubKeyX = FieldT("2160707495314124361842542725069553746463608881737352"
+                            "8162920186615872448542319");
+    FieldT pubKeyY = FieldT("3328786100751313619819855397819808730287075038642729"
+                            "822829479432223775713775");
+    FieldT msg = FieldT("18996832849579325290301086811580112302791300834635590497"
+                        "072390271656077158490");
+    FieldT Rx = FieldT("204018103970062372933877863820949243494898542050868530366"
+                       "38326738826249727385");
+    FieldT Ry = FieldT("333917834328931139442748086857847909176691960114200991192"
+                       "2211138735585687725");
+    FieldT s = FieldT("2195931900156604636542164798652536526533339522512506769964"
+                      "82368461290160677");
+    const Loopring::Signature valid(EdwardsPoint(Rx, Ry), s);
+
+    // required: which of the requests require a signature
+    auto createRequests = [&](ProtoboardT &pb, const std::vector<unsigned int> &required) {
+        std::vector<SignatureRequest> requests;
+        for (unsigned int j = 0; j < required.size(); j++)
+        {
+            jubjub::VariablePointT publicKey(pb, FMT("publicKey", "[%u]", j));
+            pb.val(publicKey.x) = pubKeyX;
+            pb.val(publicKey.y) = pubKeyY;
+            requests.push_back(
+              {publicKey,
+               make_variable(pb, msg, FMT("message", "[%u]", j)),
+               make_variable(pb, required[j], FMT("required", "[%u]", j))});
+        }
+        return requests;
+    };
+
+    auto sharedSignatureVerifiersChecked = [&](
+                                             const std::vector<unsigned int> &required,
+                                             const std::vector<Loopring::Signature> &signatures,
+                                             unsigned int numVerifiers,
+                                             bool expectedWitness,
+                                             bool expectedSatisfied = true) {
+        protoboard<FieldT> pb;
+
+        Constants constants(pb, "constants");
+        jubjub::Params params;
+        const std::vector<SignatureRequest> requests = createRequests(pb, required);
+
+        SharedSignatureVerifiers verifiers(pb, params, constants, requests, numVerifiers, "verifiers");
+        verifiers.generate_r1cs_constraints();
+        REQUIRE(verifiers.generate_r1cs_witness(signatures) == expectedWitness);
+        if (expectedWitness)
+        {
+            REQUIRE(pb.is_satisfied() == expectedSatisfied);
+        }
+    };
+
+    const Loopring::Signature invalid(EdwardsPoint(Rx, Ry), s + 1);
+
+    SECTION("Enough verifiers")
+    {
+        sharedSignatureVerifiersChecked({0, 1, 0, 1}, {invalid, valid, invalid, valid}, 2, true);
+        sharedSignatureVerifiersChecked({0, 1, 0, 0}, {invalid, valid, invalid, valid}, 3, true);
+        sharedSignatureVerifiersChecked({0, 0, 0, 0}, {invalid, invalid, invalid, invalid}, 1, true);
+    }
+
+    SECTION("Too many signatures required")
+    {
+        sharedSignatureVerifiersChecked({1, 1, 0, 1}, {valid, valid, valid, valid}, 2, false);
+    }
+
+    SECTION("Invalid required signature")
+    {
+        sharedSignatureVerifiersChecked({0, 1, 0, 1}, {valid, valid, valid, invalid}, 2, true, false);
+    }
+
+    SECTION("More requests")
+    {
+        std::vector<unsigned int> required(11, 0);
+        std::vector<Loopring::Signature> signatures(11, invalid);
+        for (unsigned int j : {1, 4, 5, 10})
+        {
+            required[j] = 1;
+            signatures[j] = valid;
+        }
+        sharedSignatureVerifiersChecked(required, signatures, 4, true);
+        sharedSignatureVerifiersChecked(required, signatures, 3, false);
+    }
+
+    SECTION("Routing")
+    {
+        protoboard<FieldT> pb;
+
+        Constants constants(pb, "constants");
+        jubjub::Params params;
+        const std::vector<SignatureRequest> requests = createRequests(pb, {1, 0, 0, 1});
+        const std::vector<Loopring::Signature> signatures = {valid, invalid, invalid, valid};
+
+        SharedSignatureVerifiers verifiers(pb, params, constants, requests, 2, "verifiers");
+        verifiers.generate_r1cs_constraints();
+
+        // Any permutation that routes the required requests to the verifiers
+        libsnark::integer_permutation destinations(requests.size());
+        destinations.set(0, 1);
+        destinations.set(1, 3);
+        destinations.set(2, 2);
+        destinations.set(3, 0);
+        verifiers.generate_r1cs_witness(signatures, destinations);
+        REQUIRE(pb.is_satisfied());
+
+        // A required request that is not routed to a verifier
+        destinations.set(0, 2);
+        destinations.set(2, 1);
+        verifiers.generate_r1cs_witness(signatures, destinations);
+        REQUIRE_FALSE(pb.is_satisfied());
+    }
+
+    SECTION("Modified witness")
+    {
+        protoboard<FieldT> pb;
+
+        Constants constants(pb, "constants");
+        jubjub::Params params;
+        const std::vector<SignatureRequest> requests = createRequests(pb, {0, 1, 0, 1});
+        const std::vector<Loopring::Signature> signatures = {invalid, valid, invalid, valid};
+
+        SharedSignatureVerifiers verifiers(pb, params, constants, requests, 2, "verifiers");
+        verifiers.generate_r1cs_constraints();
+        REQUIRE(verifiers.generate_r1cs_witness(signatures));
+        REQUIRE(pb.is_satisfied());
+        const VariableArrayT &verified = verifiers.packets.back()[0];
+
+        SECTION("Request not required by its verifier")
+        {
+            // The verifier would then accept the invalid signature
+            pb.val(verified[SIGNATURE_PACKET_REQUIRED]) = FieldT::zero();
+            verifiers.verifiers[0]->generate_r1cs_witness(invalid);
+            REQUIRE_FALSE(pb.is_satisfied());
+        }
+
+        SECTION("Verifier with the inputs of another request")
+        {
+            pb.val(requests[1].message) = msg + FieldT::one();
+            REQUIRE_FALSE(pb.is_satisfied());
+        }
+
+        SECTION("Switch without routing the packets")
+        {
+            REQUIRE_FALSE(verifiers.switches[0].empty());
+            const VariableT &crossed = verifiers.switches[0].begin()->second;
+            pb.val(crossed) = FieldT::one() - pb.val(crossed);
+            REQUIRE_FALSE(pb.is_satisfied());
+        }
+    }
 }
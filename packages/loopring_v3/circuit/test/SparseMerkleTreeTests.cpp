@@ -0,0 +1,55 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/SparseMerkleTree.h"
+
+TEST_CASE("SparseMerkleTree", "[SparseMerkleTree]")
+{
+    SECTION("Empty state")
+    {
+        // The Merkle root of the empty exchange as used by the operator
+        const FieldT emptyStorageRoot = newStorageTree().getRoot();
+        const FieldT emptyBalancesRoot = newBalancesTree(emptyStorageRoot).getRoot();
+        const FieldT emptyAccountsRoot = newAccountsTree(emptyBalancesRoot).getRoot();
+        REQUIRE(
+          emptyAccountsRoot ==
+          FieldT("14018711192124647312737824211448712071328538129221205702934141004517937071768"));
+    }
+
+    SECTION("Updates")
+    {
+        SparseMerkleTree tree(TREE_DEPTH_TOKENS, FieldT::zero());
+        SparseMerkleTree batchTree(TREE_DEPTH_TOKENS, FieldT::zero());
+        SparseMerkleTree::Leaves leaves;
+        for (unsigned int i = 0; i < 64; i++)
+        {
+            // Some leaves share parents, some addresses are updated twice
+            const unsigned long address = (i % 3 == 0) ? i : (getRandomFieldElement(16).as_ulong() % (1UL << 16));
+            const FieldT leaf = getRandomFieldElement();
+            const FieldT rootBefore = tree.getRoot();
+
+            const Proof proof = tree.createProof(address);
+            REQUIRE(proof.data.size() == TREE_DEPTH_TOKENS * 3);
+            REQUIRE(tree.verifyProof(proof, address, tree.get(address)));
+            tree.update(address, leaf);
+            REQUIRE(tree.get(address) == leaf);
+            REQUIRE(tree.verifyProof(proof, address, leaf));
+            REQUIRE(tree.getRoot() != rootBefore);
+            REQUIRE(
+              computeMerkleRoot<HashMerkleTree>(TREE_DEPTH_TOKENS, FieldT(address), leaf, proof.data) ==
+              tree.getRoot());
+
+            leaves.emplace_back(address, leaf);
+        }
+        batchTree.update(leaves);
+        REQUIRE(batchTree.getRoot() == tree.getRoot());
+
+        // Setting all leaves back to the default leaf gives the empty tree again
+        for (auto &leaf : leaves)
+        {
+            leaf.second = FieldT::zero();
+        }
+        batchTree.update(leaves);
+        REQUIRE(batchTree.getRoot() == SparseMerkleTree(TREE_DEPTH_TOKENS, FieldT::zero()).getRoot());
+    }
+}
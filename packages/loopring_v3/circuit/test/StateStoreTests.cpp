@@ -0,0 +1,186 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/BlockBuilder.h"
+#include "../Utils/StateStore.h"
+
+#include <cstdio>
+
+static json getDepositBlockInput(unsigned int accountID, unsigned int tokenID, const std::string &amount)
+{
+    json deposit;
+    deposit["txType"] = "Deposit";
+    deposit["owner"] = std::to_string(1000 + accountID);
+    deposit["accountID"] = accountID;
+    deposit["tokenID"] = tokenID;
+    deposit["amount"] = amount;
+
+    json input;
+    input["exchange"] = "0";
+    input["timestamp"] = 1000000;
+    input["protocolTakerFeeBips"] = 25;
+    input["protocolMakerFeeBips"] = 10;
+    input["operatorAccountID"] = 1;
+    input["transactions"] = json::array({deposit});
+    return input;
+}
+
+TEST_CASE("StateStore", "[StateStore]")
+{
+    const std::string filename = "state_store_test.bin";
+    std::remove(filename.c_str());
+
+    ExchangeState state;
+    std::vector<Block> blocks(3);
+    {
+        StateStore store;
+        REQUIRE(store.open(filename));
+        StateSnapshot snapshot;
+        REQUIRE_FALSE(store.getLatestSnapshot(snapshot));
+
+        REQUIRE(buildBlock(state, getDepositBlockInput(2, 0, "1000"), blocks[0]));
+        REQUIRE(store.commit(1, state));
+        REQUIRE(buildBlock(state, getDepositBlockInput(3, 1, "2000"), blocks[1]));
+        REQUIRE(store.commit(2, state));
+        REQUIRE(buildBlock(state, getDepositBlockInput(2, 0, "500"), blocks[2]));
+        REQUIRE(store.commit(3, state));
+        REQUIRE(state.getChangedAccounts().empty());
+
+        for (unsigned int i = 0; i < blocks.size(); i++)
+        {
+            REQUIRE(store.getSnapshot(i + 1, snapshot));
+            REQUIRE(snapshot.getBlockIdx() == i + 1);
+            REQUIRE(snapshot.getRoot() == blocks[i].merkleRootAfter);
+        }
+        REQUIRE_FALSE(store.getSnapshot(4, snapshot));
+
+        // Older snapshots are not changed by later commits
+        REQUIRE(store.getSnapshot(1, snapshot));
+        REQUIRE(snapshot.getBalanceLeaf(2, 0).balance == FieldT(1000));
+        REQUIRE(snapshot.getAccountLeaf(3).owner == FieldT::zero());
+        REQUIRE(store.getLatestSnapshot(snapshot));
+        REQUIRE(snapshot.getBlockIdx() == 3);
+        REQUIRE(snapshot.getBalanceLeaf(2, 0).balance == FieldT(1500));
+        REQUIRE(snapshot.getAccountLeaf(3).owner == FieldT(1003));
+        REQUIRE(snapshot.getStorageLeaf(2, 0, 0).data == FieldT::zero());
+
+        // The proofs are the same as the proofs of the in-memory state
+        REQUIRE(snapshot.createAccountProof(2).data == state.getAccountsTree().createProof(2).data);
+        REQUIRE(snapshot.createAccountProof(100).data == state.getAccountsTree().createProof(100).data);
+        REQUIRE(snapshot.createBalanceProof(3, 1).data == state.getAccount(3).balancesTree.createProof(1).data);
+    }
+
+    SECTION("Reopen")
+    {
+        StateStore store;
+        REQUIRE(store.open(filename));
+        StateSnapshot snapshot;
+        REQUIRE(store.getLatestSnapshot(snapshot));
+        REQUIRE(snapshot.getRoot() == state.getRoot());
+
+        ExchangeState loadedState;
+        snapshot.load(loadedState);
+        REQUIRE(loadedState.getRoot() == state.getRoot());
+
+        // The loaded state can be used to build the next block
+        Block block;
+        Block loadedBlock;
+        REQUIRE(buildBlock(state, getDepositBlockInput(4, 2, "100"), block));
+        REQUIRE(buildBlock(loadedState, getDepositBlockInput(4, 2, "100"), loadedBlock));
+        REQUIRE(loadedBlock.merkleRootAfter == block.merkleRootAfter);
+        REQUIRE(store.commit(4, loadedState));
+        REQUIRE(store.getLatestSnapshot(snapshot));
+        REQUIRE(snapshot.getRoot() == block.merkleRootAfter);
+    }
+
+    SECTION("Build on a snapshot")
+    {
+        StateStore store;
+        REQUIRE(store.open(filename));
+        StateSnapshot snapshot;
+        REQUIRE(store.getLatestSnapshot(snapshot));
+
+        // Only the accounts used by the block are read from the snapshot
+        ExchangeState lazyState;
+        lazyState.setSource(&snapshot);
+        REQUIRE(lazyState.getRoot() == state.getRoot());
+
+        Block block;
+        Block lazyBlock;
+        REQUIRE(buildBlock(state, getDepositBlockInput(2, 0, "100"), block));
+        REQUIRE(buildBlock(lazyState, getDepositBlockInput(2, 0, "100"), lazyBlock));
+        REQUIRE(lazyBlock.merkleRootAfter == block.merkleRootAfter);
+        REQUIRE(lazyState.findBalance(lazyState.getAccount(2), 0).balance == FieldT(1600));
+        REQUIRE(lazyState.save()["accounts_values"].size() < state.save()["accounts_values"].size());
+
+        // The next block uses an account in the same subtree as account 2
+        REQUIRE(buildBlock(state, getDepositBlockInput(3, 1, "100"), block));
+        REQUIRE(buildBlock(lazyState, getDepositBlockInput(3, 1, "100"), lazyBlock));
+        REQUIRE(lazyBlock.merkleRootAfter == block.merkleRootAfter);
+
+        REQUIRE(store.commit(4, lazyState));
+        REQUIRE(store.getLatestSnapshot(snapshot));
+        REQUIRE(snapshot.getRoot() == block.merkleRootAfter);
+        REQUIRE(snapshot.getBalanceLeaf(3, 1).balance == FieldT(2100));
+        REQUIRE(snapshot.getAccountLeaf(2).owner == FieldT(1002));
+    }
+
+    SECTION("A failing block is not stored")
+    {
+        StateStore store;
+        REQUIRE(store.open(filename));
+        {
+            // The block is built, but it fails afterwards (e.g. its witness
+            // is invalid) so the state after it is never committed
+            PendingState pendingState(&store);
+            REQUIRE(pendingState.isFromSnapshot());
+            REQUIRE(pendingState.getBlockIdx() == 4);
+            Block block;
+            REQUIRE(buildBlock(pendingState.getState(), getDepositBlockInput(2, 0, "100"), block));
+            REQUIRE(block.merkleRootAfter != state.getRoot());
+        }
+        {
+            // A block that cannot be built after its first transaction
+            // already updated the state
+            PendingState pendingState(&store);
+            json input = getDepositBlockInput(2, 0, "100");
+            json unknown = input["transactions"][0];
+            unknown["txType"] = "Unknown";
+            input["transactions"].push_back(unknown);
+            Block block;
+            REQUIRE_FALSE(buildBlock(pendingState.getState(), input, block));
+        }
+        StateSnapshot snapshot;
+        REQUIRE(store.getLatestSnapshot(snapshot));
+        REQUIRE(snapshot.getBlockIdx() == 3);
+        REQUIRE(snapshot.getRoot() == state.getRoot());
+
+        // The next block is built on the same snapshot again
+        PendingState pendingState(&store);
+        REQUIRE(pendingState.getBlockIdx() == 4);
+        Block block;
+        Block expectedBlock;
+        REQUIRE(buildBlock(pendingState.getState(), getDepositBlockInput(3, 1, "100"), block));
+        REQUIRE(buildBlock(state, getDepositBlockInput(3, 1, "100"), expectedBlock));
+        REQUIRE(block.merkleRootAfter == expectedBlock.merkleRootAfter);
+        REQUIRE(pendingState.commit());
+        REQUIRE(store.getLatestSnapshot(snapshot));
+        REQUIRE(snapshot.getBlockIdx() == 4);
+        REQUIRE(snapshot.getRoot() == expectedBlock.merkleRootAfter);
+    }
+
+    SECTION("Load an older snapshot")
+    {
+        StateStore store;
+        REQUIRE(store.open(filename));
+        StateSnapshot snapshot;
+        REQUIRE(store.getSnapshot(1, snapshot));
+
+        ExchangeState loadedState;
+        snapshot.load(loadedState);
+        REQUIRE(loadedState.getRoot() == blocks[0].merkleRootAfter);
+        REQUIRE(loadedState.findBalance(loadedState.getAccount(2), 0).balance == FieldT(1000));
+    }
+
+    std::remove(filename.c_str());
+}
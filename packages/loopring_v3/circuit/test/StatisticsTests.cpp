@@ -0,0 +1,109 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/BenchmarkResults.h"
+#include "../Utils/Statistics.h"
+
+static json getGadgetResults(unsigned int numConstraints, const std::vector<double> &samples)
+{
+    json benchmark;
+    benchmark["name"] = "Gadget";
+    benchmark["constraints"] = numConstraints;
+    benchmark["variables"] = numConstraints;
+    benchmark["witnessGenerationSamplesUs"] = samples;
+
+    json results;
+    results["benchmarks"] = json::array({benchmark});
+    return results;
+}
+
+TEST_CASE("TwoSidedPValue", "[Statistics]")
+{
+    REQUIRE(getTwoSidedPValue(0.0, 5.0) == Approx(1.0));
+    REQUIRE(getTwoSidedPValue(1.0, 1.0) == Approx(0.5));
+    REQUIRE(getTwoSidedPValue(2.0, 2.0) == Approx(0.18350341907));
+    REQUIRE(getTwoSidedPValue(2.0, 10.0) == Approx(0.07338803477));
+    REQUIRE(getTwoSidedPValue(-2.0, 10.0) == Approx(0.07338803477));
+}
+
+TEST_CASE("WelchTTest", "[Statistics]")
+{
+    TTestResult result;
+
+    SECTION("Different variances")
+    {
+        REQUIRE(welchTTest({1, 2, 3, 4, 5}, {2, 4, 6, 8, 10}, result));
+        REQUIRE(result.t == Approx(1.8973665961));
+        REQUIRE(result.degreesOfFreedom == Approx(5.882352941));
+        REQUIRE(result.pValue == Approx(0.10753119493));
+    }
+
+    SECTION("Significant difference")
+    {
+        REQUIRE(welchTTest({100, 101, 99, 100.5, 99.5}, {105, 106, 104, 105.5, 104.5}, result));
+        REQUIRE(result.t == Approx(10.0));
+        REQUIRE(result.degreesOfFreedom == Approx(8.0));
+        REQUIRE(result.pValue == Approx(8.488e-6).epsilon(0.01));
+    }
+
+    SECTION("No variance")
+    {
+        REQUIRE(welchTTest({3, 3}, {3, 3, 3}, result));
+        REQUIRE(result.pValue == Approx(1.0));
+        REQUIRE(welchTTest({3, 3}, {4, 4}, result));
+        REQUIRE(result.pValue == Approx(0.0));
+    }
+
+    SECTION("Not enough samples")
+    {
+        REQUIRE(!welchTTest({1}, {1, 2, 3}, result));
+        REQUIRE(!welchTTest({1, 2, 3}, {}, result));
+    }
+}
+
+TEST_CASE("CompareBenchmarkResults", "[Statistics]")
+{
+    const json baseline = getGadgetResults(1000, {100, 101, 99, 100.5, 99.5});
+    std::vector<BenchmarkComparison> comparisons;
+
+    SECTION("No change")
+    {
+        REQUIRE(compareBenchmarkResults(baseline, baseline, 0.03, comparisons));
+        REQUIRE(comparisons.size() == 3);
+        for (const BenchmarkComparison &comparison : comparisons)
+        {
+            REQUIRE(!comparison.regression);
+        }
+    }
+
+    SECTION("Slower witness generation")
+    {
+        const json results = getGadgetResults(1000, {105, 106, 104, 105.5, 104.5});
+        REQUIRE(compareBenchmarkResults(baseline, results, 0.03, comparisons));
+        REQUIRE(comparisons.size() == 3);
+        REQUIRE(!comparisons[0].regression);
+        REQUIRE(!comparisons[1].regression);
+        REQUIRE(comparisons[2].significant);
+        REQUIRE(comparisons[2].change == Approx(0.05));
+        REQUIRE(comparisons[2].regression);
+        // Accepted when the allowed slowdown is larger
+        comparisons.clear();
+        REQUIRE(compareBenchmarkResults(baseline, results, 0.10, comparisons));
+        REQUIRE(!comparisons[2].regression);
+    }
+
+    SECTION("More constraints")
+    {
+        const json results = getGadgetResults(1100, {100, 101, 99, 100.5, 99.5});
+        REQUIRE(compareBenchmarkResults(baseline, results, 0.03, comparisons));
+        REQUIRE(comparisons[0].regression);
+        REQUIRE(!comparisons[2].regression);
+    }
+
+    SECTION("Different kinds of results")
+    {
+        json results;
+        results["results"] = json::array();
+        REQUIRE(!compareBenchmarkResults(baseline, results, 0.03, comparisons));
+    }
+}
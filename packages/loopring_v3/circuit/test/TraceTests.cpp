@@ -0,0 +1,83 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Utils/Trace.h"
+
+#include <set>
+#include <thread>
+
+static void traceTransaction(unsigned int index)
+{
+    TRACE_SCOPE_INDEX("transaction", index);
+}
+
+TEST_CASE("Trace", "[Trace]")
+{
+    SECTION("Disabled")
+    {
+        {
+            TRACE_SCOPE("ignored");
+        }
+        const json trace = Trace::toJSON();
+        for (const json &event : trace["traceEvents"])
+        {
+            REQUIRE(event["name"] != "ignored");
+        }
+    }
+
+    SECTION("Spans")
+    {
+        Trace::start("");
+        {
+            TRACE_SCOPE("block");
+            traceTransaction(0);
+            std::thread thread(traceTransaction, 1);
+            thread.join();
+        }
+        Trace::stop();
+        {
+            TRACE_SCOPE("ignored");
+        }
+
+        const json trace = Trace::toJSON();
+        unsigned int numSpans = 0;
+        std::set<unsigned int> threads;
+        for (const json &event : trace["traceEvents"])
+        {
+            if (event["ph"] == "X")
+            {
+                numSpans++;
+                threads.insert(event["tid"].get<unsigned int>());
+                REQUIRE(event["name"] != "ignored");
+                REQUIRE(event["dur"].get<double>() >= 0.0);
+                if (event["name"] == "transaction")
+                {
+                    REQUIRE(event["args"]["index"].get<int>() < 2);
+                }
+            }
+        }
+        REQUIRE(numSpans == 3);
+        // The transaction on the other thread is in its own lane
+        REQUIRE(threads.size() == 2);
+    }
+
+    SECTION("Maximum number of events")
+    {
+        Trace::start("");
+        for (size_t i = 0; i < TRACE_MAX_EVENTS + 10; i++)
+        {
+            Trace::addEvent("event", -1, 0, 0);
+        }
+        REQUIRE(Trace::getNumEvents() == TRACE_MAX_EVENTS);
+
+        // Clearing makes room for new events
+        Trace::clear();
+        REQUIRE(Trace::getNumEvents() == 0);
+        {
+            TraceWriter traceWriter(true);
+            TRACE_SCOPE("request");
+        }
+        REQUIRE(Trace::getNumEvents() == 0);
+        Trace::stop();
+    }
+}
@@ -0,0 +1,97 @@
+#include "../ThirdParty/catch.hpp"
+#include "TestUtils.h"
+
+#include "../Circuits/UniversalCircuit.h"
+
+#include <fstream>
+
+static json loadBlockInput()
+{
+    std::ifstream file(std::string(TEST_DATA_PATH) + "block.json");
+    REQUIRE(file.is_open());
+    json input;
+    file >> input;
+    return input;
+}
+
+TEST_CASE("UniversalCircuit", "[UniversalCircuit]")
+{
+    const json input = loadBlockInput();
+    const unsigned int blockSize = input["blockSize"].get<unsigned int>();
+
+    // Flipping putAddressesInDA of the transfer at the end of the block only
+    // changes the data-availability data of that transaction
+    const unsigned int changedIndex = blockSize - 1;
+    json changedInput = input;
+    json &transfer = changedInput["transactions"][changedIndex]["transfer"];
+    REQUIRE(transfer.is_object());
+    transfer["putAddressesInDA"] = !transfer["putAddressesInDA"].get<bool>();
+
+    SECTION("Changed transactions")
+    {
+        const std::vector<bool> changed = getChangedTransactions(
+          input.get<Block>(), input["transactions"], changedInput.get<Block>(), changedInput["transactions"]);
+        REQUIRE(changed.size() == blockSize);
+        for (unsigned int i = 0; i < blockSize; i++)
+        {
+            REQUIRE(changed[i] == (i == changedIndex));
+        }
+    }
+
+    SECTION("Block is only kept for incremental witness generation")
+    {
+        protoboard<FieldT> pb;
+        UniversalCircuit circuit(pb, "circuit");
+        circuit.generateConstraints(blockSize);
+
+        REQUIRE(circuit.generateWitness(input));
+        REQUIRE(pb.is_satisfied());
+        REQUIRE_FALSE(circuit.lastBlock);
+
+        REQUIRE(circuit.generateWitnessIncremental(input));
+        REQUIRE(pb.is_satisfied());
+        REQUIRE(circuit.lastBlock);
+
+        REQUIRE(circuit.generateWitness(input));
+        REQUIRE_FALSE(circuit.lastBlock);
+    }
+
+    SECTION("Invalid operator signature")
+    {
+        json invalidInput = input;
+        invalidInput["signature"]["s"] = "1";
+        protoboard<FieldT> pb;
+        UniversalCircuit circuit(pb, "circuit");
+        circuit.generateConstraints(blockSize);
+        REQUIRE_FALSE(circuit.generateWitness(invalidInput));
+    }
+
+    SECTION("Incremental witness")
+    {
+        protoboard<FieldT> pb;
+        UniversalCircuit circuit(pb, "circuit");
+        circuit.generateConstraints(blockSize);
+        REQUIRE(circuit.generateWitnessIncremental(input));
+        REQUIRE(pb.is_satisfied());
+        REQUIRE(circuit.generateWitnessIncremental(changedInput));
+        REQUIRE(pb.is_satisfied());
+
+        // The same circuit with the witness of the changed block generated
+        // from scratch
+        protoboard<FieldT> expectedPb;
+        UniversalCircuit expectedCircuit(expectedPb, "circuit");
+        expectedCircuit.generateConstraints(blockSize);
+        REQUIRE(expectedCircuit.generateWitness(changedInput));
+        REQUIRE(expectedPb.is_satisfied());
+
+        REQUIRE(pb.num_variables() == expectedPb.num_variables());
+        REQUIRE(pb.primary_input() == expectedPb.primary_input());
+        const r1cs_variable_assignment<FieldT> values = pb.full_variable_assignment();
+        const r1cs_variable_assignment<FieldT> expectedValues = expectedPb.full_variable_assignment();
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            INFO("Variable " << (i + 1));
+            REQUIRE(values[i] == expectedValues[i]);
+        }
+    }
+}